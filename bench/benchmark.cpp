@@ -0,0 +1,529 @@
+/**
+ * @file benchmark.cpp
+ * @brief Times our hot paths over molecule shaped graphs and emits JSON or CSV.
+ *
+ *	Build (no build system yet, everything is header only):
+ *		g++ -std=c++17 -O2 -pthread bench/benchmark.cpp -o grabBench
+ *
+ *	Usage:
+ *		grabBench [--format=json|csv] [--out=<file>] [--repeat=<n>] [--filter=<substring>]
+ *			[--counters=<file>] [--trace=<file>]
+ *
+ *	--counters dumps our operation counters/latency histograms as JSON, which needs
+ *	the build to turn them on with -DGRAB_INSTRUMENT=true. --trace writes the per
+ *	thread timeline of phases and operations for chrome://tracing or Perfetto,
+ *	built with -DGRAB_TRACE=true.
+ *
+ *	Every case is run --repeat times on a freshly built graph, setup and teardown
+ *	are not part of the timing. Results go to stdout unless --out is given.
+ *
+ *	Built with -fsanitize=address,undefined and --repeat=1 the cases double as our
+ *	regression run, some (batchStrip) exist for the edge cases they walk into.
+ */
+
+//all of our debug output would both drown the results and dominate the timings
+#define GRAB_NODE_DEBUG false
+#define GRAB_EDGE_DEBUG false
+#define GRAB_GRAPH_DEBUG false
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "../inc/structure/node.h"
+#include "../inc/structure/edge.h"
+#include "../inc/structure/graph.h"
+#include "../inc/structure/snapshot.h"
+#include "../inc/structure/batch.h"
+#include "../inc/structure/builder.h"
+#include "../inc/structure/view.h"
+#include "../inc/structure/store.h"
+#include "../inc/algo/bfs.h"
+#include "../inc/algo/commonNeighbors.h"
+#include "../inc/algo/components.h"
+#include "../inc/algo/descriptors.h"
+#include "../inc/algo/match.h"
+#include "../inc/algo/order.h"
+#include "../inc/algo/symmetry.h"
+#include "../inc/algo/rings.h"
+#include "generators.h"
+
+//tag type, our templates do not store anything with it (yet)
+struct Molecule
+{
+};
+
+//element number and formal charge per atom
+template<>
+struct NodePayload<Molecule>
+{
+	typedef ColumnStore<unsigned char, signed char> columns;
+};
+
+//bonds have no direction
+template<>
+struct EdgeDirection<Molecule>
+{
+	typedef Undirected policy;
+};
+
+typedef Node<Molecule> Atom;
+typedef Graph<Molecule, Molecule> MolGraph;
+typedef Snapshot<Molecule, Molecule> MolSnapshot;
+
+//keeps the optimizer from throwing away work we only time
+volatile size_t benchSink = 0;
+
+/************************************************
+ *  FIXTURES
+ ***********************************************/
+
+struct Fixture
+{
+	const Topology *topo = nullptr;
+	std::unique_ptr<MolGraph> graph;
+	//graph drops nodes that only it holds on a refresh, so we keep our own handles
+	std::vector<std::shared_ptr<Atom>> atoms;
+	std::unique_ptr<MolSnapshot> snapshot; //only for cases that run on one
+};
+
+void buildFixture(Fixture &fix)
+{
+	const Topology &topo = *fix.topo;
+	fix.graph = std::make_unique<MolGraph>(topo.name);
+	fix.atoms.reserve(topo.nodeCount);
+	for (unsigned int i = 0; i < topo.nodeCount; i++)
+	{
+		std::shared_ptr<Atom> atom = std::make_shared<Atom>(
+				topo.labels[i] + std::to_string(i));
+		atom->addLabel(topo.labels[i]);
+		fix.graph->addNode(atom);
+		fix.atoms.push_back(atom);
+		unsigned char element = (topo.labels[i] == "C") ? 6 :
+								(topo.labels[i] == "N") ? 7 : 8;
+		fix.graph->getNodePayload().setRow(fix.graph->getNodeId(atom.get()),
+				element, 0);
+	}
+	for (size_t e = 0; e < topo.edges.size(); e++)
+		fix.atoms[topo.edges[e].first]->addChild("b" + std::to_string(e),
+				fix.atoms[topo.edges[e].second]);
+}
+
+//same graph, staged by threads slices at a time and linked in one commit
+void buildFixtureParallel(Fixture &fix, unsigned int threads)
+{
+	const Topology &topo = *fix.topo;
+	fix.graph = std::make_unique<MolGraph>(topo.name);
+	fix.atoms.resize(topo.nodeCount);
+	Builder<Molecule, Molecule> builder(*fix.graph, threads);
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads; t++)
+		workers.emplace_back([&, t]()
+		{
+			for (unsigned int i = t; i < topo.nodeCount; i += threads)
+			{
+				fix.atoms[i] = std::make_shared<Atom>(topo.labels[i] + std::to_string(i));
+				fix.atoms[i]->addLabel(topo.labels[i]);
+				builder.addNode(t, fix.atoms[i]);
+			}
+		});
+	for (std::thread &worker : workers)
+		worker.join();
+	workers.clear();
+	for (unsigned int t = 0; t < threads; t++)
+		workers.emplace_back([&, t]()
+		{
+			for (size_t e = t; e < topo.edges.size(); e += threads)
+				builder.addEdge(t, "b" + std::to_string(e),
+						fix.atoms[topo.edges[e].first], fix.atoms[topo.edges[e].second]);
+		});
+	for (std::thread &worker : workers)
+		worker.join();
+	builder.commit(threads);
+	for (unsigned int i = 0; i < topo.nodeCount; i++)
+	{
+		unsigned char element = (topo.labels[i] == "C") ? 6 :
+								(topo.labels[i] == "N") ? 7 : 8;
+		fix.graph->getNodePayload().setRow(fix.graph->getNodeId(fix.atoms[i].get()),
+				element, 0);
+	}
+}
+
+//edges keep both of their nodes alive, so they have to go before the handles do
+void teardownFixture(Fixture &fix)
+{
+	for (std::shared_ptr<Atom> &atom : fix.atoms)
+		atom->deleteEdges();
+	fix.snapshot.reset();
+	fix.atoms.clear();
+	fix.graph.reset();
+}
+
+/************************************************
+ *  CASES
+ ***********************************************/
+
+struct BenchCase
+{
+	std::string name;
+	bool prebuilt; //false when the case builds the graph itself
+	bool snapshot; //algorithms get a Snapshot of the graph built outside the timing
+	std::function<void(Fixture&)> run;
+};
+
+std::vector<BenchCase> benchCases()
+{
+	std::vector<BenchCase> cases;
+	cases.push_back( { "construct", false, false, [](Fixture &fix)
+	{
+		buildFixture(fix);
+	} });
+	cases.push_back( { "constructParallel", false, false, [](Fixture &fix)
+	{
+		buildFixtureParallel(fix, 4);
+	} });
+	cases.push_back( { "neighbors", true, false, [](Fixture &fix)
+	{
+		for (std::shared_ptr<Atom> &atom : fix.atoms)
+		{
+			for (std::weak_ptr<Atom> &neigh : atom->getNeighbors())
+				benchSink += neigh.lock()->getName().size();
+		}
+	} });
+	cases.push_back( { "deleteEdges", true, false, [](Fixture &fix)
+	{
+		for (std::shared_ptr<Atom> &atom : fix.atoms)
+			atom->deleteEdges();
+	} });
+	//same work as deleteEdges, one commit
+	cases.push_back( { "batchDelete", true, false, [](Fixture &fix)
+	{
+		Batch<Molecule, Molecule> batch(*fix.graph);
+		for (std::shared_ptr<Atom> &atom : fix.atoms)
+			batch.deleteEdges(atom);
+		batch.commit();
+	} });
+	//hydrogens only their bond holds, the commit drops the last handle on each of them
+	cases.push_back( { "batchStrip", true, false, [](Fixture &fix)
+	{
+		for (std::shared_ptr<Atom> &atom : fix.atoms)
+			atom->addChild("H", std::make_shared<Atom>("H"));
+		Batch<Molecule, Molecule> batch(*fix.graph);
+		for (std::shared_ptr<Atom> &atom : fix.atoms)
+			batch.deleteEdges(atom);
+		benchSink += batch.commit();
+	} });
+	//drop every handle and let the graph tear the rings down itself
+	cases.push_back( { "destroy", true, false, [](Fixture &fix)
+	{
+		fix.atoms.clear();
+		fix.graph.reset();
+	} });
+	cases.push_back( { "selectNodes", true, false, [](Fixture &fix)
+	{
+		const std::vector<unsigned char> &element =
+				fix.graph->getNodePayload().column<0>();
+		const std::vector<signed char> &charge =
+				fix.graph->getNodePayload().column<1>();
+		benchSink += fix.graph->selectNodes([&](size_t row)
+				{	return element[row] == 6 && charge[row] == 0;}).size();
+	} });
+	cases.push_back( { "findByName", true, false, [](Fixture &fix)
+	{
+		for (std::shared_ptr<Atom> &atom : fix.atoms)
+			benchSink += (fix.graph->getNodeByName(atom->getName()) == atom);
+	} });
+	//copy and teardown, compare with construct + destroy
+	cases.push_back( { "clone", true, false, [](Fixture &fix)
+	{
+		benchSink += fix.graph->clone("copy")->getNodeIdBound();
+	} });
+	cases.push_back( { "shareClone", true, false, [](Fixture &fix)
+	{
+		std::unique_ptr<MolGraph> copy = fix.graph->shareClone("copy");
+		benchSink += copy->ownNode(fix.atoms[0])->getName().size();
+	} });
+	cases.push_back( { "removeNode", true, false, [](Fixture &fix)
+	{
+		for (std::shared_ptr<Atom> &atom : fix.atoms)
+			fix.graph->removeNode(atom);
+	} });
+	cases.push_back( { "snapshot", true, false, [](Fixture &fix)
+	{
+		MolSnapshot snapshot(*fix.graph);
+		benchSink += snapshot.getEdgeCount();
+	} });
+	//publish, attach the way a worker does, walk it
+	cases.push_back( { "storeAttach", true, false, [](Fixture &fix)
+	{
+		StoreWriter writer;
+		writer.addGraph(*fix.graph);
+		writer.writeShared("/grab_bench");
+		GraphStore store;
+		store.attachShared("/grab_bench");
+		benchSink += bfsDistances(store.getGraph<Molecule>(0), 0).back();
+		GraphStore::removeShared("/grab_bench");
+	} });
+	cases.push_back( { "triangles", true, true, [](Fixture &fix)
+	{
+		benchSink += countTriangles(*fix.snapshot);
+	} });
+	cases.push_back( { "commonNeighbors", true, true, [](Fixture &fix)
+	{
+		const MolSnapshot &snap = *fix.snapshot;
+		PhaseTimer timer("commonNeighbors");
+		for (unsigned int u = 0; u < snap.getNodeCount(); u++)
+			for (const unsigned int *v = snap.neighborsBegin(u);
+					v != snap.neighborsEnd(u); v++)
+				benchSink += countCommonNeighbors(snap, u, *v);
+	} });
+	cases.push_back( { "bfs", true, true, [](Fixture &fix)
+	{
+		benchSink += bfsDistances(*fix.snapshot, 0).back();
+	} });
+	cases.push_back( { "components", true, true, [](Fixture &fix)
+	{
+		benchSink += connectedComponents(*fix.snapshot).getCount();
+	} });
+	//snapshot, order and renumbering, what a caller pays before the faster sweeps
+	cases.push_back( { "reorder", true, false, [](Fixture &fix)
+	{
+		benchSink += reorderNodes(*fix.graph);
+	} });
+	//carbon skeleton only, no second graph or snapshot
+	cases.push_back( { "labelView", true, true, [](Fixture &fix)
+	{
+		View<MolSnapshot> carbons = labelView(*fix.snapshot, *fix.graph, "C");
+		for (unsigned int v = 0; v < carbons.getNodeCount(); v++)
+			if (carbons.isLive(v))
+			{
+				benchSink += bfsDistances(carbons, v).back();
+				break;
+			}
+	} });
+	cases.push_back( { "descriptors", true, true, [](Fixture &fix)
+	{
+		DescriptorEngine engine;
+		std::vector<double> row(engine.getColumnCount());
+		engine.computeRow(*fix.snapshot, row.data(), 1);
+		benchSink += (size_t) row[0];
+	} });
+	cases.push_back( { "allPairs", true, true, [](Fixture &fix)
+	{
+		//n^2 / 2 bytes, keep it to molecule sizes
+		if (fix.snapshot->getNodeCount() <= 8192)
+			benchSink += allPairsDistances(*fix.snapshot).getBytes();
+	} });
+	cases.push_back( { "blocks", true, true, [](Fixture &fix)
+	{
+		benchSink += blockCutTree(*fix.snapshot).getBlockCount();
+	} });
+	//same rings as the tracker but straight off the snapshot, one block at a time
+	cases.push_back( { "blockRings", true, true, [](Fixture &fix)
+	{
+		benchSink += smallestRingsPerBlock(*fix.snapshot).size();
+	} });
+	//rare atom first, the carbons only get looked at next to a nitrogen
+	cases.push_back( { "match", true, true, [](Fixture &fix)
+	{
+		Pattern<Molecule, Molecule> pattern("CC(C)N");
+		benchSink += findMatches(pattern, *fix.graph, *fix.snapshot).size();
+	} });
+	//C60 comes out at 120 automorphisms and one orbit
+	cases.push_back( { "symmetry", true, true, [](Fixture &fix)
+	{
+		benchSink += graphAutomorphisms(*fix.graph, *fix.snapshot).getCount();
+	} });
+	cases.push_back( { "matchDistinct", true, true, [](Fixture &fix)
+	{
+		Pattern<Molecule, Molecule> pattern("C1CCCCC1");
+		benchSink += findMatches(pattern, *fix.graph, *fix.snapshot, 0, true).size();
+	} });
+	cases.push_back( { "rings", true, false, [](Fixture &fix)
+	{
+		RingTracker<Molecule, Molecule> tracker(*fix.graph);
+		benchSink += tracker.getRingCount();
+	} });
+	//break and remake a few bonds, rings have to follow each time
+	cases.push_back( { "ringEdits", true, false, [](Fixture &fix)
+	{
+		RingTracker<Molecule, Molecule> tracker(*fix.graph);
+		const Topology &topo = *fix.topo;
+		for (size_t e = 0; e < topo.edges.size() && e < 32; e++)
+		{
+			std::shared_ptr<Atom> &from = fix.atoms[topo.edges[e].first];
+			std::shared_ptr<Atom> &to = fix.atoms[topo.edges[e].second];
+			tracker.deleteEdges(from, to);
+			tracker.addEdge("b" + std::to_string(e), from, to);
+		}
+		benchSink += tracker.getRingCount();
+	} });
+	return cases;
+}
+
+/************************************************
+ *  RESULTS
+ ***********************************************/
+
+struct BenchResult
+{
+	std::string graph;
+	std::string caseName;
+	unsigned int nodes;
+	size_t edges;
+	size_t bytes; //Graph::getFootprint() of the built graph
+	unsigned int repeats;
+	double minNs;
+	double medianNs;
+	double meanNs;
+};
+
+size_t graphBytes(const Topology &topo)
+{
+	Fixture fix;
+	fix.topo = &topo;
+	buildFixture(fix);
+	size_t bytes = fix.graph->getFootprint().total();
+	teardownFixture(fix);
+	return bytes;
+}
+
+BenchResult timeCase(const Topology &topo, const BenchCase &benchCase,
+		unsigned int repeats, size_t bytes)
+{
+	std::vector<double> samples;
+	for (unsigned int r = 0; r < repeats; r++)
+	{
+		Fixture fix;
+		fix.topo = &topo;
+		if (benchCase.prebuilt)
+			buildFixture(fix);
+		if (benchCase.snapshot)
+			fix.snapshot = std::make_unique<MolSnapshot>(*fix.graph);
+		auto start = std::chrono::steady_clock::now();
+		benchCase.run(fix);
+		auto stop = std::chrono::steady_clock::now();
+		samples.push_back(
+				std::chrono::duration<double, std::nano>(stop - start).count());
+		teardownFixture(fix);
+	}
+	std::sort(samples.begin(), samples.end());
+	double total = 0;
+	for (double sample : samples)
+		total += sample;
+	return
+	{	topo.name, benchCase.name, topo.nodeCount, topo.edges.size(), bytes, repeats,
+		samples.front(), samples[samples.size() / 2], total / samples.size()};
+}
+
+std::string resultsAsJson(const std::vector<BenchResult> &results)
+{
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(0);
+	out << "{\n  \"results\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult &res = results[i];
+		out << (i ? ",\n" : "\n") << "    {\"graph\": \"" << res.graph
+				<< "\", \"case\": \"" << res.caseName << "\", \"nodes\": "
+				<< res.nodes << ", \"edges\": " << res.edges << ", \"bytes\": "
+				<< res.bytes << ", \"repeats\": "
+				<< res.repeats << ", \"min_ns\": " << res.minNs
+				<< ", \"median_ns\": " << res.medianNs << ", \"mean_ns\": "
+				<< res.meanNs << "}";
+	}
+	out << "\n  ]\n}\n";
+	return out.str();
+}
+
+std::string resultsAsCsv(const std::vector<BenchResult> &results)
+{
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(0);
+	out << "graph,case,nodes,edges,bytes,repeats,min_ns,median_ns,mean_ns\n";
+	for (const BenchResult &res : results)
+		out << res.graph << "," << res.caseName << "," << res.nodes << ","
+				<< res.edges << "," << res.bytes << "," << res.repeats << ","
+				<< res.minNs << "," << res.medianNs << "," << res.meanNs << "\n";
+	return out.str();
+}
+
+/************************************************
+ *  DRIVER
+ ***********************************************/
+
+int main(int argc, char *argv[])
+{
+	std::string format = "json";
+	std::string outPath = "";
+	std::string filter = "";
+	std::string countersPath = "";
+	std::string tracePath = "";
+	unsigned int repeats = 5;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.rfind("--format=", 0) == 0)
+			format = arg.substr(9);
+		else if (arg.rfind("--out=", 0) == 0)
+			outPath = arg.substr(6);
+		else if (arg.rfind("--repeat=", 0) == 0)
+			repeats = std::max(1, std::stoi(arg.substr(9)));
+		else if (arg.rfind("--filter=", 0) == 0)
+			filter = arg.substr(9);
+		else if (arg.rfind("--counters=", 0) == 0)
+			countersPath = arg.substr(11);
+		else if (arg.rfind("--trace=", 0) == 0)
+			tracePath = arg.substr(8);
+		else
+		{
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			return 1;
+		}
+	}
+	if (format != "json" && format != "csv")
+	{
+		std::cerr << "Unknown format: " << format << std::endl;
+		return 1;
+	}
+
+	std::vector<Topology> suite = standardSuite();
+	std::vector<BenchCase> cases = benchCases();
+	std::vector<BenchResult> results;
+	for (const Topology &topo : suite)
+	{
+		size_t bytes = graphBytes(topo);
+		for (const BenchCase &benchCase : cases)
+		{
+			std::string fullName = topo.name + "/" + benchCase.name;
+			if (!filter.empty() && fullName.find(filter) == std::string::npos)
+				continue;
+			results.push_back(timeCase(topo, benchCase, repeats, bytes));
+		}
+	}
+
+	std::string report =
+			(format == "json") ? resultsAsJson(results) : resultsAsCsv(results);
+	if (outPath.empty())
+		std::cout << report;
+	else
+		std::ofstream(outPath) << report;
+	if (!countersPath.empty())
+	{
+		if (!instrumentOn)
+			std::cerr << "Counters requested but built without GRAB_INSTRUMENT"
+					<< std::endl;
+		std::ofstream(countersPath) << Instrumentation::get().asJson();
+	}
+	if (!tracePath.empty())
+	{
+		if (!traceOn)
+			std::cerr << "Trace requested but built without GRAB_TRACE" << std::endl;
+		TraceRecorder::get().writeChromeTrace(tracePath);
+	}
+	return 0;
+}
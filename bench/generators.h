@@ -0,0 +1,242 @@
+/**
+ * @file generators.h
+ * @brief Molecule shaped topologies used to exercise our structure.
+ *
+ *	Generators only produce plain topologies (node count, labels and an edge list)
+ *	so that building the actual Graph/Node/Edge structure can be timed on its own.
+ */
+
+#ifndef BENCH_GENERATORS_H_
+#define BENCH_GENERATORS_H_
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Topology
+{
+	std::string name;
+	unsigned int nodeCount = 0;
+	std::vector<std::string> labels; //one element label per node
+	std::vector<std::pair<unsigned int, unsigned int>> edges; //source, sink
+};
+
+/************************************************
+ *  GENERATORS
+ ***********************************************/
+
+//plain carbon chain C-C-C-...
+inline Topology linearChain(unsigned int length)
+{
+	Topology topo;
+	topo.name = "chain_" + std::to_string(length);
+	topo.nodeCount = length;
+	topo.labels.assign(length, "C");
+	for (unsigned int i = 1; i < length; i++)
+		topo.edges.push_back( { i - 1, i });
+	return topo;
+}
+
+/* Pyranose residues (C1..C5 + ring O5, exocyclic C6) linked C1 -> O -> C4 of the
+ * parent. Every branchEvery'th residue also carries a second child on its C6
+ * which is what gives us the branched glycan shape.
+ */
+inline Topology glycanTree(unsigned int residues, unsigned int branchEvery)
+{
+	Topology topo;
+	topo.name = "glycan_" + std::to_string(residues);
+	auto addAtom = [&topo](std::string label)
+	{
+		topo.labels.push_back(label);
+		return topo.nodeCount++;
+	};
+	//ring atoms of each residue, index 0..4 are C1..C5, 5 is O5, 6 is C6
+	std::vector<std::array<unsigned int, 7>> residueAtoms;
+	std::vector<unsigned int> openSites; //C4/C6 atoms waiting for a child
+	for (unsigned int r = 0; r < residues; r++)
+	{
+		std::array<unsigned int, 7> atoms;
+		for (unsigned int a = 0; a < 5; a++)
+			atoms[a] = addAtom("C");
+		atoms[5] = addAtom("O");
+		atoms[6] = addAtom("C");
+		for (unsigned int a = 0; a < 5; a++)
+			topo.edges.push_back( { atoms[a], atoms[a + 1] });
+		topo.edges.push_back( { atoms[5], atoms[0] });
+		topo.edges.push_back( { atoms[4], atoms[6] });
+		if (r > 0)
+		{
+			//glycosidic oxygen between parent site and our anomeric carbon
+			unsigned int site = openSites.front();
+			openSites.erase(openSites.begin());
+			unsigned int linkO = addAtom("O");
+			topo.edges.push_back( { site, linkO });
+			topo.edges.push_back( { linkO, atoms[0] });
+		}
+		openSites.push_back(atoms[3]);
+		if (branchEvery > 0 && r % branchEvery == 0)
+			openSites.push_back(atoms[6]);
+	}
+	return topo;
+}
+
+//linearly fused hexagons (acene like ladder), 4 * rings + 2 atoms
+inline Topology ringLadder(unsigned int rings)
+{
+	Topology topo;
+	topo.name = "ladder_" + std::to_string(rings);
+	topo.nodeCount = 2 * (rings + 1) + 2 * rings;
+	topo.labels.assign(topo.nodeCount, "C");
+	//rungs are shared bonds (top[i], bottom[i]), each ring adds a top and bottom apex
+	auto top = [](unsigned int i)
+	{	return 4 * i;};
+	auto bottom = [](unsigned int i)
+	{	return 4 * i + 1;};
+	for (unsigned int i = 0; i <= rings; i++)
+		topo.edges.push_back( { top(i), bottom(i) });
+	for (unsigned int i = 0; i < rings; i++)
+	{
+		unsigned int topApex = 4 * i + 2;
+		unsigned int bottomApex = 4 * i + 3;
+		topo.edges.push_back( { top(i), topApex });
+		topo.edges.push_back( { topApex, top(i + 1) });
+		topo.edges.push_back( { bottom(i), bottomApex });
+		topo.edges.push_back( { bottomApex, bottom(i + 1) });
+	}
+	return topo;
+}
+
+/* Icosahedral fullerenes C(60 * frequency^2): C60, C240, C540, ...
+ *
+ * We subdivide every icosahedron face into frequency^2 triangles (geodesic sphere)
+ * then truncate that triangulation. Truncating puts a new atom on every directed
+ * edge (u, v), which gives pentagons around the 12 original corners and hexagons
+ * everywhere else. Only combinatorics, no coordinates needed.
+ */
+inline Topology fullerene(unsigned int frequency)
+{
+	const unsigned int icosahedron[20][3] =
+	{
+	{ 0, 1, 2 },
+	{ 0, 2, 3 },
+	{ 0, 3, 4 },
+	{ 0, 4, 5 },
+	{ 0, 5, 1 },
+	{ 1, 2, 6 },
+	{ 2, 3, 7 },
+	{ 3, 4, 8 },
+	{ 4, 5, 9 },
+	{ 5, 1, 10 },
+	{ 6, 2, 7 },
+	{ 7, 3, 8 },
+	{ 8, 4, 9 },
+	{ 9, 5, 10 },
+	{ 10, 1, 6 },
+	{ 11, 6, 7 },
+	{ 11, 7, 8 },
+	{ 11, 8, 9 },
+	{ 11, 9, 10 },
+	{ 11, 10, 6 } };
+	const unsigned int h = frequency;
+
+	//geodesic points are keyed by their (corner, weight) pairs so shared face edges merge
+	std::map<std::vector<std::pair<unsigned int, unsigned int>>, unsigned int> pointIds;
+	std::vector<std::array<unsigned int, 3>> triangles;
+	for (const auto &face : icosahedron)
+	{
+		auto point = [&](unsigned int i, unsigned int j)
+		{
+			const unsigned int weights[3] =
+			{ h - i - j, i, j };
+			std::vector<std::pair<unsigned int, unsigned int>> key;
+			for (unsigned int k = 0; k < 3; k++)
+				if (weights[k] > 0)
+					key.push_back( { face[k], weights[k] });
+			std::sort(key.begin(), key.end());
+			auto found = pointIds.emplace(key, (unsigned int) pointIds.size());
+			return found.first->second;
+		};
+		for (unsigned int i = 0; i < h; i++)
+		{
+			for (unsigned int j = 0; i + j < h; j++)
+			{
+				triangles.push_back( { point(i, j), point(i + 1, j), point(i, j + 1) });
+				if (i + j + 1 < h)
+					triangles.push_back( { point(i + 1, j), point(i + 1, j + 1), point(
+							i, j + 1) });
+			}
+		}
+	}
+
+	Topology topo;
+	topo.name = "fullerene_C" + std::to_string(60 * h * h);
+	std::map<std::pair<unsigned int, unsigned int>, unsigned int> arcIds;
+	auto arc = [&](unsigned int u, unsigned int v)
+	{
+		auto found = arcIds.emplace(std::make_pair(u, v), topo.nodeCount);
+		if (found.second)
+			topo.nodeCount++;
+		return found.first->second;
+	};
+	for (const auto &tri : triangles)
+	{
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			unsigned int x = tri[k], y = tri[(k + 1) % 3], z = tri[(k + 2) % 3];
+			topo.edges.push_back( { arc(x, y), arc(x, z) });
+		}
+	}
+	for (const auto &entry : arcIds)
+	{
+		if (entry.first.first < entry.first.second)
+			topo.edges.push_back( { entry.second, arc(entry.first.second,
+					entry.first.first) });
+	}
+	topo.labels.assign(topo.nodeCount, "C");
+	return topo;
+}
+
+//connected random graph, random spanning tree plus extra edges up to averageDegree
+inline Topology randomSparse(unsigned int nodeCount, double averageDegree,
+		unsigned int seed)
+{
+	Topology topo;
+	topo.name = "random_" + std::to_string(nodeCount);
+	topo.nodeCount = nodeCount;
+	topo.labels.resize(nodeCount);
+	const char *elements[] =
+	{ "C", "C", "C", "N", "O" };
+	std::mt19937 rng(seed);
+	std::set<std::pair<unsigned int, unsigned int>> seen;
+	auto connect = [&](unsigned int u, unsigned int v)
+	{
+		if (u == v || !seen.insert(std::minmax(u, v)).second)
+			return;
+		topo.edges.push_back( { u, v });
+	};
+	for (unsigned int i = 0; i < nodeCount; i++)
+	{
+		topo.labels[i] = elements[rng() % 5];
+		if (i > 0)
+			connect(rng() % i, i);
+	}
+	size_t wanted = (size_t) (averageDegree * nodeCount / 2.0);
+	while (nodeCount > 1 && topo.edges.size() < wanted)
+		connect(rng() % nodeCount, rng() % nodeCount);
+	return topo;
+}
+
+//default set of graphs the benchmark runs over
+inline std::vector<Topology> standardSuite()
+{
+	return
+	{	linearChain(2000), glycanTree(150, 3), ringLadder(400), fullerene(1),
+		fullerene(2), fullerene(3), randomSparse(4000, 2.4, 7)};
+}
+
+#endif /* BENCH_GENERATORS_H_ */
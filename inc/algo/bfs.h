@@ -0,0 +1,336 @@
+/**
+ * @file bfs.h
+ * @brief Breadth first search and all pairs topological distances.
+ *
+ *	Works on anything traversable (see snapshot.h): getNodeCount(), isLive(),
+ *	getDegree() and forEachNeighbor(). Ids are dense node ids.
+ *
+ *	Single source BFS keeps its frontier and visited set as bitmaps and switches
+ *	between pushing from the frontier (top-down) and having unvisited nodes look
+ *	for a frontier parent (bottom-up) once the frontier gets heavy, which only
+ *	pays off on large graphs. All pairs runs 64 sources at once, one bit lane per
+ *	source, so every edge is scanned once per level for the whole batch.
+ *
+ *	On Directed rows (see direction.h) distances follow the edges and we stay
+ *	top-down, a node's row does not hold the parents bottom-up would look for.
+ */
+
+#ifndef INC_ALGO_BFS_H_
+#define INC_ALGO_BFS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../instrument/counters.h"
+#include "../structure/direction.h"
+
+//distance of nodes the search never reached
+const unsigned int unreachedDistance = (unsigned int) -1;
+
+struct BfsOptions
+{
+	//go bottom-up once frontier edges exceed unvisited edges / alpha
+	unsigned int alpha = 14;
+	//come back top-down once the frontier drops under nodes / beta
+	unsigned int beta = 24;
+	//below this many nodes bottom-up never pays off
+	unsigned int bottomUpMinNodes = 1024;
+};
+
+/************************************************
+ *  SINGLE SOURCE
+ ***********************************************/
+
+template<class G>
+std::vector<unsigned int> bfsDistances(const G &graph, unsigned int source,
+		BfsOptions options = BfsOptions())
+{
+	PhaseTimer timer("bfs");
+	const unsigned int n = graph.getNodeCount();
+	const size_t words = (n + 63) / 64;
+	std::vector<unsigned int> distance(n, unreachedDistance);
+	if (source >= n || !graph.isLive(source))
+		return distance;
+
+	std::vector<std::uint64_t> frontier(words, 0), next(words, 0), visited(
+			words, 0);
+	auto setBit = [](std::vector<std::uint64_t> &bits, unsigned int v)
+	{	bits[v / 64] |= std::uint64_t(1) << (v % 64);};
+	auto hasBit = [](const std::vector<std::uint64_t> &bits, unsigned int v)
+	{	return (bits[v / 64] >> (v % 64)) & 1;};
+
+	size_t unvisitedEdges = 0;
+	for (unsigned int v = 0; v < n; v++)
+		unvisitedEdges += graph.getDegree(v);
+
+	setBit(frontier, source);
+	setBit(visited, source);
+	distance[source] = 0;
+	unvisitedEdges -= graph.getDegree(source);
+	size_t frontierNodes = 1;
+	size_t frontierEdges = graph.getDegree(source);
+	bool bottomUp = false;
+
+	for (unsigned int level = 1; frontierNodes > 0; level++)
+	{
+		if (hasSymmetricRows<G>() && n >= options.bottomUpMinNodes)
+		{
+			if (!bottomUp && frontierEdges * options.alpha > unvisitedEdges)
+				bottomUp = true;
+			else if (bottomUp && frontierNodes * options.beta < n)
+				bottomUp = false;
+		}
+		std::fill(next.begin(), next.end(), 0);
+		frontierNodes = 0;
+		frontierEdges = 0;
+		if (bottomUp)
+		{
+			for (unsigned int v = 0; v < n; v++)
+			{
+				if (hasBit(visited, v) || !graph.isLive(v))
+					continue;
+				graph.forEachNeighbor(v, [&](unsigned int w, unsigned int)
+				{
+					if (!hasBit(frontier, w))
+						return true;
+					setBit(next, v);
+					return false;
+				});
+			}
+		}
+		else
+		{
+			for (size_t word = 0; word < words; word++)
+			{
+				for (std::uint64_t bits = frontier[word]; bits; bits &= bits - 1)
+				{
+					unsigned int v = (unsigned int) (word * 64
+							+ __builtin_ctzll(bits));
+					graph.forEachNeighbor(v, [&](unsigned int w, unsigned int)
+					{
+						if (!hasBit(visited, w))
+							setBit(next, w);
+					});
+				}
+			}
+		}
+		for (size_t word = 0; word < words; word++)
+		{
+			next[word] &= ~visited[word];
+			visited[word] |= next[word];
+			for (std::uint64_t bits = next[word]; bits; bits &= bits - 1)
+			{
+				unsigned int w = (unsigned int) (word * 64 + __builtin_ctzll(bits));
+				distance[w] = level;
+				frontierNodes++;
+				frontierEdges += graph.getDegree(w);
+			}
+		}
+		unvisitedEdges -= std::min(unvisitedEdges, frontierEdges);
+		frontier.swap(next);
+	}
+	return distance;
+}
+
+/************************************************
+ *  DISTANCE MATRIX
+ ***********************************************/
+
+/* Symmetric, so only the upper triangle is stored, one byte per pair when every
+ * distance fits (which is every molecule we have seen) and two otherwise.
+ */
+class DistanceMatrix
+{
+public:
+	DistanceMatrix() = default;
+	explicit DistanceMatrix(unsigned int nodeCount) :
+			nodeCount(nodeCount)
+	{
+		this->wide.assign(pairCount(nodeCount), wideUnreached);
+	}
+
+	unsigned int getNodeCount() const
+	{
+		return this->nodeCount;
+	}
+
+	bool isNarrow() const
+	{
+		return this->wide.empty();
+	}
+
+	//unreachedDistance when there is no path
+	unsigned int get(unsigned int nodeA, unsigned int nodeB) const
+	{
+		if (nodeA == nodeB)
+			return 0;
+		size_t slot = this->slotOf(nodeA, nodeB);
+		if (this->isNarrow())
+			return (this->narrow[slot] == narrowUnreached) ?
+					unreachedDistance : this->narrow[slot];
+		return (this->wide[slot] == wideUnreached) ?
+				unreachedDistance : this->wide[slot];
+	}
+
+	void set(unsigned int nodeA, unsigned int nodeB, unsigned int distance)
+	{
+		if (nodeA != nodeB)
+			this->wide[this->slotOf(nodeA, nodeB)] = (std::uint16_t) std::min(
+					distance, (unsigned int) wideUnreached);
+	}
+
+	//drops to one byte per pair if every reachable distance allows it
+	void compact()
+	{
+		if (this->isNarrow())
+			return;
+		for (std::uint16_t value : this->wide)
+			if (value != wideUnreached && value >= narrowUnreached)
+				return;
+		this->narrow.resize(this->wide.size());
+		for (size_t slot = 0; slot < this->wide.size(); slot++)
+			this->narrow[slot] =
+					(this->wide[slot] == wideUnreached) ?
+							narrowUnreached : (std::uint8_t) this->wide[slot];
+		std::vector<std::uint16_t>().swap(this->wide);
+	}
+
+	size_t getBytes() const
+	{
+		return this->narrow.size() + this->wide.size() * sizeof(std::uint16_t);
+	}
+
+private:
+	static constexpr std::uint8_t narrowUnreached = 0xFF;
+	static constexpr std::uint16_t wideUnreached = 0xFFFF;
+
+	unsigned int nodeCount = 0;
+	std::vector<std::uint8_t> narrow;
+	std::vector<std::uint16_t> wide;
+
+	static size_t pairCount(size_t n)
+	{
+		return n * (n - (n ? 1 : 0)) / 2;
+	}
+
+	size_t slotOf(unsigned int nodeA, unsigned int nodeB) const
+	{
+		size_t i = std::min(nodeA, nodeB), j = std::max(nodeA, nodeB);
+		return i * (2 * (size_t) this->nodeCount - i - 1) / 2 + (j - i - 1);
+	}
+};
+
+/************************************************
+ *  ALL PAIRS
+ ***********************************************/
+
+/* One batch of up to 64 sources, lane b belongs to sources[first + b]. seen[v]
+ * holds the lanes that already reached v, visit[v] the lanes reaching v on the
+ * current level. Only nodes with something in visit are expanded.
+ * reached(w, lanes, level) hears about every node some lanes reach first on level.
+ */
+template<class G, class F>
+void multiSourceLevels(const G &graph, const std::vector<unsigned int> &sources,
+		size_t first, F reached)
+{
+	const unsigned int n = graph.getNodeCount();
+	const size_t lanes = std::min<size_t>(64, sources.size() - first);
+	std::vector<std::uint64_t> seen(n, 0), visit(n, 0), visitNext(n, 0);
+	std::vector<unsigned int> active, touched;
+	for (size_t b = 0; b < lanes; b++)
+	{
+		unsigned int src = sources[first + b];
+		seen[src] = std::uint64_t(1) << b;
+		visit[src] = std::uint64_t(1) << b;
+		active.push_back(src);
+	}
+
+	for (unsigned int level = 1; !active.empty(); level++)
+	{
+		touched.clear();
+		for (unsigned int v : active)
+		{
+			std::uint64_t lanesAtV = visit[v];
+			graph.forEachNeighbor(v, [&](unsigned int w, unsigned int)
+			{
+				if (!visitNext[w])
+					touched.push_back(w);
+				visitNext[w] |= lanesAtV;
+			});
+		}
+		for (unsigned int v : active)
+			visit[v] = 0;
+		active.clear();
+		for (unsigned int w : touched)
+		{
+			std::uint64_t fresh = visitNext[w] & ~seen[w];
+			visitNext[w] = 0;
+			if (!fresh)
+				continue;
+			seen[w] |= fresh;
+			visit[w] = fresh;
+			active.push_back(w);
+			reached(w, fresh, level);
+		}
+	}
+}
+
+template<class G>
+void multiSourceBfs(const G &graph, const std::vector<unsigned int> &sources,
+		size_t first, DistanceMatrix &matrix)
+{
+	PhaseTimer timer("multiSourceBfs");
+	multiSourceLevels(graph, sources, first,
+			[&](unsigned int w, std::uint64_t fresh, unsigned int level)
+			{
+				for (std::uint64_t bits = fresh; bits; bits &= bits - 1)
+				{
+					unsigned int src = sources[first + __builtin_ctzll(bits)];
+					if (src < w)
+						matrix.set(src, w, level);
+				}
+			});
+}
+
+/* Every pair of live nodes, distances are undirected so each pair is written by
+ * its smaller id. threads > 1 splits the 64 source batches between threads, each
+ * batch writes its own rows so they never collide.
+ */
+template<class G>
+DistanceMatrix allPairsDistances(const G &graph, unsigned int threads = 1)
+{
+	static_assert(hasSymmetricRows<G>(),
+			"DistanceMatrix is symmetric, Directed rows would lose half the pairs");
+	PhaseTimer timer("allPairsDistances");
+	const unsigned int n = graph.getNodeCount();
+	DistanceMatrix matrix(n);
+	std::vector<unsigned int> sources;
+	for (unsigned int v = 0; v < n; v++)
+		if (graph.isLive(v))
+			sources.push_back(v);
+	const size_t batches = (sources.size() + 63) / 64;
+	threads = std::max(1u, std::min<unsigned int>(threads, batches));
+	if (threads == 1)
+	{
+		for (size_t batch = 0; batch < batches; batch++)
+			multiSourceBfs(graph, sources, batch * 64, matrix);
+	}
+	else
+	{
+		std::vector<std::thread> workers;
+		for (unsigned int t = 0; t < threads; t++)
+			workers.emplace_back([&, t]()
+			{
+				for (size_t batch = t; batch < batches; batch += threads)
+					multiSourceBfs(graph, sources, batch * 64, matrix);
+			});
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+	matrix.compact();
+	return matrix;
+}
+
+#endif /* INC_ALGO_BFS_H_ */
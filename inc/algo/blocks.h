@@ -0,0 +1,266 @@
+/**
+ * @file blocks.h
+ * @brief Biconnected blocks and the block-cut tree of a traversable.
+ *
+ *	Fused ring systems (steroids, fused sugars, fullerenes) never share a ring
+ *	with anything outside their biconnected block, so ring perception, matching
+ *	and incremental updates can work one block at a time, and blocks can be
+ *	handed to different threads. blockCutTree() finds the blocks with an iterative
+ *	Hopcroft-Tarjan walk (long chains do not eat the stack) over anything
+ *	traversable (see snapshot.h, views work too) and links them through the
+ *	articulation nodes they share.
+ *
+ *	Direction is ignored. Bridges are one bond blocks, live nodes without any
+ *	bonds get a block of their own so every live node is in at least one block.
+ */
+
+#ifndef INC_ALGO_BLOCKS_H_
+#define INC_ALGO_BLOCKS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../instrument/counters.h"
+#include "../structure/direction.h"
+
+//one undirected bond between two node ids
+inline std::uint64_t ringEdgeKey(unsigned int nodeA, unsigned int nodeB)
+{
+	if (nodeA > nodeB)
+		std::swap(nodeA, nodeB);
+	return (std::uint64_t(nodeA) << 32) | nodeB;
+}
+
+inline unsigned int ringEdgeLow(std::uint64_t key)
+{
+	return (unsigned int) (key >> 32);
+}
+
+inline unsigned int ringEdgeHigh(std::uint64_t key)
+{
+	return (unsigned int) (key & 0xFFFFFFFFu);
+}
+
+//block of edge ids we never saw, and cut index of nodes that are not articulations
+const unsigned int noBlock = (unsigned int) -1;
+
+struct BiconnectedBlock
+{
+	//ascending node ids
+	std::vector<unsigned int> nodes;
+	//bond keys (see ringEdgeKey()) and the matching edge ids
+	std::vector<std::uint64_t> edges;
+	std::vector<unsigned int> edgeIds;
+};
+
+/* Tree nodes 0 .. blocks.size() - 1 are the blocks, blocks.size() + k is the k-th
+ * articulation. Every edge is between a block and an articulation it contains.
+ */
+struct BlockCutTree
+{
+	std::vector<BiconnectedBlock> blocks;
+	std::vector<unsigned int> articulations;
+	//per edge id, noBlock for ids that were not there
+	std::vector<unsigned int> edgeBlock;
+	//per node id, index into articulations or noBlock
+	std::vector<unsigned int> cutIndex;
+	//per node id, one block holding it (the only one unless it is an articulation)
+	std::vector<unsigned int> nodeBlock;
+	std::vector<std::vector<unsigned int>> tree;
+
+	unsigned int getBlockCount() const
+	{
+		return (unsigned int) this->blocks.size();
+	}
+
+	bool isArticulation(unsigned int node) const
+	{
+		return this->cutIndex[node] != noBlock;
+	}
+
+	//every block holding node
+	std::vector<unsigned int> getBlocksOf(unsigned int node) const
+	{
+		if (!this->isArticulation(node))
+			return (this->nodeBlock[node] == noBlock) ?
+					std::vector<unsigned int>() :
+					std::vector<unsigned int>(1, this->nodeBlock[node]);
+		return this->tree[this->blocks.size() + this->cutIndex[node]];
+	}
+};
+
+template<class G>
+BlockCutTree blockCutTree(const G &graph)
+{
+	PhaseTimer timer("blockCutTree");
+	const unsigned int n = graph.getNodeCount();
+	BlockCutTree result;
+	result.edgeBlock.assign(graph.getEdgeIdBound(), noBlock);
+	result.cutIndex.assign(n, noBlock);
+	result.nodeBlock.assign(n, noBlock);
+
+	//our own symmetric rows, the walk has to pick up where it left off in each
+	std::vector<unsigned int> offsets(n + 1, 0), targets, ids;
+	{
+		std::vector<std::pair<unsigned int, unsigned int>> entries;
+		std::vector<unsigned int> from;
+		for (unsigned int v = 0; v < n; v++)
+		{
+			if (!graph.isLive(v))
+				continue;
+			graph.forEachNeighbor(v, [&](unsigned int w, unsigned int id)
+			{
+				from.push_back(v);
+				entries.emplace_back(w, id);
+				if constexpr (!hasSymmetricRows<G>())
+				{
+					from.push_back(w);
+					entries.emplace_back(v, id);
+				}
+			});
+		}
+		for (unsigned int v : from)
+			offsets[v + 1]++;
+		for (unsigned int v = 0; v < n; v++)
+			offsets[v + 1] += offsets[v];
+		targets.resize(entries.size());
+		ids.resize(entries.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			unsigned int slot = fill[from[i]]++;
+			targets[slot] = entries[i].first;
+			ids[slot] = entries[i].second;
+		}
+		if constexpr (!hasSymmetricRows<G>())
+		{
+			//a -> b next to b -> a is still one bond, keep the first id
+			unsigned int written = 0;
+			for (unsigned int v = 0; v < n; v++)
+			{
+				std::vector<std::pair<unsigned int, unsigned int>> row;
+				for (unsigned int slot = offsets[v]; slot < offsets[v + 1]; slot++)
+					row.emplace_back(targets[slot], ids[slot]);
+				std::sort(row.begin(), row.end());
+				offsets[v] = written;
+				for (size_t i = 0; i < row.size(); i++)
+				{
+					if (i > 0 && row[i].first == row[i - 1].first)
+						continue;
+					targets[written] = row[i].first;
+					ids[written++] = row[i].second;
+				}
+			}
+			offsets[n] = written;
+		}
+	}
+
+	const unsigned int unseen = (unsigned int) -1;
+	std::vector<unsigned int> disc(n, unseen), low(n, 0), stamp(n, unseen);
+	struct Frame
+	{
+		unsigned int node;
+		unsigned int parentEdge;
+		unsigned int next;
+	};
+	std::vector<Frame> frames;
+	//slots into targets, plus the node each was walked from
+	std::vector<std::pair<unsigned int, unsigned int>> edgeStack;
+	unsigned int clock = 0;
+
+	auto addToBlock = [&](unsigned int block, unsigned int v)
+	{
+		if (stamp[v] == block)
+			return;
+		stamp[v] = block;
+		result.blocks[block].nodes.push_back(v);
+		if (result.nodeBlock[v] == noBlock)
+			result.nodeBlock[v] = block;
+		else if (result.cutIndex[v] == noBlock)
+		{
+			//second block through v, so v holds them together
+			result.cutIndex[v] = (unsigned int) result.articulations.size();
+			result.articulations.push_back(v);
+		}
+	};
+
+	for (unsigned int root = 0; root < n; root++)
+	{
+		if (disc[root] != unseen || !graph.isLive(root))
+			continue;
+		disc[root] = low[root] = clock++;
+		if (offsets[root] == offsets[root + 1])
+		{
+			result.blocks.emplace_back();
+			addToBlock(result.getBlockCount() - 1, root);
+			continue;
+		}
+		frames.push_back( { root, unseen, offsets[root] });
+		while (!frames.empty())
+		{
+			Frame &frame = frames.back();
+			unsigned int v = frame.node;
+			if (frame.next < offsets[v + 1])
+			{
+				unsigned int slot = frame.next++;
+				unsigned int w = targets[slot];
+				if (ids[slot] == frame.parentEdge)
+					continue;
+				if (disc[w] == unseen)
+				{
+					edgeStack.emplace_back(slot, v);
+					disc[w] = low[w] = clock++;
+					frames.push_back( { w, ids[slot], offsets[w] });
+				}
+				else if (disc[w] < disc[v])
+				{
+					edgeStack.emplace_back(slot, v);
+					low[v] = std::min(low[v], disc[w]);
+				}
+				continue;
+			}
+			unsigned int parentEdge = frame.parentEdge;
+			frames.pop_back();
+			if (frames.empty())
+				break;
+			unsigned int parent = frames.back().node;
+			low[parent] = std::min(low[parent], low[v]);
+			if (low[v] < disc[parent])
+				continue;
+			//everything above the tree edge parent -> v is one block
+			result.blocks.emplace_back();
+			unsigned int block = result.getBlockCount() - 1;
+			unsigned int id;
+			do
+			{
+				unsigned int slot = edgeStack.back().first;
+				unsigned int source = edgeStack.back().second;
+				edgeStack.pop_back();
+				id = ids[slot];
+				result.blocks[block].edges.push_back(
+						ringEdgeKey(source, targets[slot]));
+				result.blocks[block].edgeIds.push_back(id);
+				result.edgeBlock[id] = block;
+				addToBlock(block, source);
+				addToBlock(block, targets[slot]);
+			} while (id != parentEdge);
+			std::sort(result.blocks[block].nodes.begin(),
+					result.blocks[block].nodes.end());
+		}
+	}
+
+	result.tree.resize(result.blocks.size() + result.articulations.size());
+	for (unsigned int b = 0; b < result.getBlockCount(); b++)
+		for (unsigned int v : result.blocks[b].nodes)
+			if (result.isArticulation(v))
+			{
+				unsigned int cut = result.getBlockCount() + result.cutIndex[v];
+				result.tree[b].push_back(cut);
+				result.tree[cut].push_back(b);
+			}
+	return result;
+}
+
+#endif /* INC_ALGO_BLOCKS_H_ */
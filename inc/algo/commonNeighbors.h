@@ -0,0 +1,85 @@
+/**
+ * @file commonNeighbors.h
+ * @brief Common neighbor queries and triangle counting on a Snapshot.
+ *
+ *	Ids are the graph's dense node ids (Graph::getNodeId()/getNodeById()).
+ */
+
+#ifndef INC_ALGO_COMMONNEIGHBORS_H_
+#define INC_ALGO_COMMONNEIGHBORS_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "../instrument/counters.h"
+#include "../structure/snapshot.h"
+#include "intersect.h"
+
+/* Bitmap rows only pay off once the lists are long compared to the row, molecule
+ * rows of 2-4 ids are always cheaper to merge.
+ */
+template<class T, class E>
+bool preferBitmapRows(const Snapshot<T, E> &snapshot, unsigned int nodeA,
+		unsigned int nodeB)
+{
+	return snapshot.hasBitmapRows()
+			&& std::min(snapshot.getDegree(nodeA), snapshot.getDegree(nodeB)) * 8
+					> snapshot.getWordsPerRow();
+}
+
+/* Ascending ids adjacent to both nodes. The pair kernels are too short to time
+ * one by one, callers looping over pairs open one PhaseTimer around the loop.
+ */
+template<class T, class E>
+std::vector<unsigned int> commonNeighbors(const Snapshot<T, E> &snapshot,
+		unsigned int nodeA, unsigned int nodeB)
+{
+	std::vector<unsigned int> common(
+			std::min(snapshot.getDegree(nodeA), snapshot.getDegree(nodeB)));
+	size_t found = intersectSorted(snapshot.neighborsBegin(nodeA),
+			snapshot.getDegree(nodeA), snapshot.neighborsBegin(nodeB),
+			snapshot.getDegree(nodeB), common.data());
+	common.resize(found);
+	return common;
+}
+
+template<class T, class E>
+size_t countCommonNeighbors(const Snapshot<T, E> &snapshot, unsigned int nodeA,
+		unsigned int nodeB)
+{
+	if (preferBitmapRows(snapshot, nodeA, nodeB))
+		return bitmapAndCount(snapshot.bitmapRow(nodeA), snapshot.bitmapRow(nodeB),
+				snapshot.getWordsPerRow());
+	return intersectSortedCount(snapshot.neighborsBegin(nodeA),
+			snapshot.getDegree(nodeA), snapshot.neighborsBegin(nodeB),
+			snapshot.getDegree(nodeB));
+}
+
+/* Every 3-ring once: for each edge (u, v) with u < v count the common neighbors
+ * w > v, which means intersecting only the tails of both rows past v.
+ */
+template<class T, class E>
+size_t countTriangles(const Snapshot<T, E> &snapshot)
+{
+	static_assert(hasSymmetricRows<Snapshot<T, E>>(),
+			"each triangle is found from its smallest node, that needs both directions");
+	PhaseTimer timer("countTriangles");
+	size_t triangles = 0;
+	for (unsigned int u = 0; u < snapshot.getNodeCount(); u++)
+	{
+		const unsigned int *rowU = snapshot.neighborsBegin(u);
+		const unsigned int *endU = snapshot.neighborsEnd(u);
+		for (const unsigned int *v = std::upper_bound(rowU, endU, u); v != endU;
+				v++)
+		{
+			const unsigned int *tailU = v + 1;
+			const unsigned int *tailV = std::upper_bound(
+					snapshot.neighborsBegin(*v), snapshot.neighborsEnd(*v), *v);
+			triangles += intersectSortedCount(tailU, endU - tailU, tailV,
+					snapshot.neighborsEnd(*v) - tailV);
+		}
+	}
+	return triangles;
+}
+
+#endif /* INC_ALGO_COMMONNEIGHBORS_H_ */
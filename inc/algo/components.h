@@ -0,0 +1,283 @@
+/**
+ * @file components.h
+ * @brief Connected components (fragments) by union-find.
+ *
+ *	Records often hold a salt, a solvent or several chains next to the molecule we
+ *	care about. connectedComponents() labels every live node of a traversable (see
+ *	snapshot.h, views work too) with its fragment, fragments are numbered in order
+ *	of their smallest node id so the sequential and parallel runs agree.
+ *
+ *	The parallel run is for polymers and big assemblies: threads take slices of
+ *	the node ids and union lock free, every link hangs the larger root under the
+ *	smaller one with a compare and swap, so roots end up being the smallest id of
+ *	their fragment. Molecule sized inputs should stay on one thread.
+ *
+ *	Fragments can then be had as Views (no copies) or as Graphs of their own that
+ *	share the original nodes.
+ */
+
+#ifndef INC_ALGO_COMPONENTS_H_
+#define INC_ALGO_COMPONENTS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../instrument/counters.h"
+#include "../structure/direction.h"
+#include "../structure/graph.h"
+#include "../structure/view.h"
+
+//component of nodes that are not live
+const unsigned int noComponent = (unsigned int) -1;
+
+struct Components
+{
+	//per node id, noComponent for ids that are not live
+	std::vector<unsigned int> componentOf;
+	//per component
+	std::vector<unsigned int> sizes;
+
+	unsigned int getCount() const
+	{
+		return (unsigned int) this->sizes.size();
+	}
+
+	//node ids of one component, ascending
+	std::vector<unsigned int> getMembers(unsigned int component) const
+	{
+		std::vector<unsigned int> members;
+		for (unsigned int v = 0; v < this->componentOf.size(); v++)
+			if (this->componentOf[v] == component)
+				members.push_back(v);
+		return members;
+	}
+};
+
+/************************************************
+ *  DISJOINT SETS
+ ***********************************************/
+
+//union by size, path halving on every find
+class DisjointSets
+{
+public:
+	explicit DisjointSets(unsigned int count) :
+			parent(count), size(count, 1)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			this->parent[i] = i;
+	}
+
+	unsigned int find(unsigned int item)
+	{
+		while (this->parent[item] != item)
+		{
+			this->parent[item] = this->parent[this->parent[item]];
+			item = this->parent[item];
+		}
+		return item;
+	}
+
+	//false if they already shared a set
+	bool unite(unsigned int itemA, unsigned int itemB)
+	{
+		itemA = this->find(itemA);
+		itemB = this->find(itemB);
+		if (itemA == itemB)
+			return false;
+		if (this->size[itemA] < this->size[itemB])
+			std::swap(itemA, itemB);
+		this->parent[itemB] = itemA;
+		this->size[itemA] += this->size[itemB];
+		return true;
+	}
+
+private:
+	std::vector<unsigned int> parent;
+	std::vector<unsigned int> size;
+};
+
+/* Safe to find()/unite() from many threads at once. A root only ever gets a
+ * parent smaller than itself, so there are no cycles and the final root of a set
+ * is its smallest item.
+ */
+class ConcurrentDisjointSets
+{
+public:
+	explicit ConcurrentDisjointSets(unsigned int count) :
+			parent(new std::atomic<unsigned int>[count])
+	{
+		for (unsigned int i = 0; i < count; i++)
+			this->parent[i].store(i, std::memory_order_relaxed);
+	}
+
+	unsigned int find(unsigned int item)
+	{
+		unsigned int up = this->parent[item].load(std::memory_order_acquire);
+		while (up != item)
+		{
+			//halving, losing the race just means someone else shortened it
+			unsigned int upUp = this->parent[up].load(std::memory_order_acquire);
+			this->parent[item].compare_exchange_weak(up, upUp,
+					std::memory_order_acq_rel);
+			item = up;
+			up = this->parent[item].load(std::memory_order_acquire);
+		}
+		return item;
+	}
+
+	void unite(unsigned int itemA, unsigned int itemB)
+	{
+		while (true)
+		{
+			itemA = this->find(itemA);
+			itemB = this->find(itemB);
+			if (itemA == itemB)
+				return;
+			if (itemA < itemB)
+				std::swap(itemA, itemB);
+			//itemA is the larger root, hang it under itemB unless it stopped being a root
+			unsigned int expected = itemA;
+			if (this->parent[itemA].compare_exchange_strong(expected, itemB,
+					std::memory_order_acq_rel))
+				return;
+		}
+	}
+
+private:
+	std::unique_ptr<std::atomic<unsigned int>[]> parent;
+};
+
+/************************************************
+ *  COMPONENTS
+ ***********************************************/
+
+//numbers the sets by their smallest live node, find(v) is the set of node v
+template<class G, class Find>
+Components numberComponents(const G &graph, Find find)
+{
+	const unsigned int n = graph.getNodeCount();
+	Components components;
+	components.componentOf.assign(n, noComponent);
+	std::vector<unsigned int> numberOf(n, noComponent);
+	for (unsigned int v = 0; v < n; v++)
+	{
+		if (!graph.isLive(v))
+			continue;
+		unsigned int root = find(v);
+		if (numberOf[root] == noComponent)
+		{
+			numberOf[root] = components.getCount();
+			components.sizes.push_back(0);
+		}
+		components.componentOf[v] = numberOf[root];
+		components.sizes[numberOf[root]]++;
+	}
+	return components;
+}
+
+/* Direction is ignored, a directed graph gets its weakly connected components.
+ * threads > 1 only pays off on very large graphs.
+ */
+template<class G>
+Components connectedComponents(const G &graph, unsigned int threads = 1)
+{
+	PhaseTimer timer("connectedComponents");
+	const unsigned int n = graph.getNodeCount();
+	//a slice under a few thousand nodes is not worth a thread
+	threads = std::max(1u, std::min(threads, n / 4096 + 1));
+	if (threads == 1)
+	{
+		DisjointSets sets(n);
+		for (unsigned int v = 0; v < n; v++)
+		{
+			if (!graph.isLive(v))
+				continue;
+			graph.forEachNeighbor(v, [&](unsigned int w, unsigned int)
+			{
+				//symmetric rows list every edge twice, once is enough
+				if (!hasSymmetricRows<G>() || v < w)
+					sets.unite(v, w);
+			});
+		}
+		return numberComponents(graph, [&sets](unsigned int v)
+		{	return sets.find(v);});
+	}
+
+	ConcurrentDisjointSets sets(n);
+	std::vector<std::thread> workers;
+	const unsigned int slice = (n + threads - 1) / threads;
+	for (unsigned int t = 0; t < threads; t++)
+		workers.emplace_back([&, t]()
+		{
+			unsigned int end = std::min(n, (t + 1) * slice);
+			for (unsigned int v = t * slice; v < end; v++)
+			{
+				if (!graph.isLive(v))
+					continue;
+				graph.forEachNeighbor(v, [&](unsigned int w, unsigned int)
+				{
+					if (!hasSymmetricRows<G>() || v < w)
+						sets.unite(v, w);
+				});
+			}
+		});
+	for (std::thread &worker : workers)
+		worker.join();
+	return numberComponents(graph, [&sets](unsigned int v)
+	{	return sets.find(v);});
+}
+
+/************************************************
+ *  FRAGMENTS
+ ***********************************************/
+
+/* One view per component, in component order. They all point at
+ * components.componentOf instead of carrying a bitmap each, so components has to
+ * outlive them.
+ */
+template<class G>
+std::vector<View<G>> fragmentViews(const G &graph,
+		const Components &components)
+{
+	std::vector<View<G>> views;
+	views.reserve(components.getCount());
+	for (unsigned int c = 0; c < components.getCount(); c++)
+	{
+		views.emplace_back(graph);
+		views.back().keepLabeled(components.componentOf, c);
+	}
+	return views;
+}
+
+/* One Graph per component, named <graph>_<component>. The nodes are shared with
+ * graph, not copied, so edits to one show up in the other. components has to
+ * come from graph's ids (i.e. a Snapshot of it).
+ */
+template<class T, class E>
+std::vector<std::unique_ptr<Graph<T, E>>> splitFragments(Graph<T, E> &graph,
+		const Components &components)
+{
+	PhaseTimer timer("splitFragments");
+	std::vector<std::vector<std::shared_ptr<Node<E>>>> members(
+			components.getCount());
+	for (unsigned int c = 0; c < components.getCount(); c++)
+		members[c].reserve(components.sizes[c]);
+	for (unsigned int v = 0; v < components.componentOf.size(); v++)
+		if (components.componentOf[v] != noComponent)
+			members[components.componentOf[v]].push_back(graph.getNodeById(v));
+	std::vector<std::unique_ptr<Graph<T, E>>> fragments;
+	for (unsigned int c = 0; c < components.getCount(); c++)
+	{
+		fragments.emplace_back(
+				new Graph<T, E>(graph.getName() + "_" + std::to_string(c)));
+		fragments.back()->addNodes(members[c]);
+	}
+	return fragments;
+}
+
+#endif /* INC_ALGO_COMPONENTS_H_ */
@@ -0,0 +1,262 @@
+/**
+ * @file descriptors.h
+ * @brief Topological descriptors for many graphs at once, straight into columns.
+ *
+ *	Models downstream want a fixed row of numbers per molecule: Wiener index,
+ *	Balaban J, ring count, degree histogram and how many atom pairs sit at each
+ *	distance. A DescriptorEngine is told once which of those to compute and then
+ *	fills them for a whole batch of graphs into one column-major buffer (column c
+ *	of graph g at out[c * graphCount + g]), which numpy or arrow take as is.
+ *
+ *	Everything comes out of one pass over a snapshot: the degrees from the CSR
+ *	rows, the rest from the 64 sources at a time BFS of bfs.h, where each level
+ *	adds lanes * level to the Wiener sum with a popcount and the per source
+ *	distance sums (Balaban) and fragment roots (rings) fall out of the same bits.
+ *	No distance matrix is ever built.
+ *
+ *		nodes, edges	live nodes, distinct edges
+ *		wiener			sum of distances over connected pairs
+ *		balabanJ		m / (mu + 1) * sum over edges of 1 / sqrt(s_i * s_j), s the
+ *						distance sums, meant for connected graphs (a fragment only
+ *						sees its own nodes)
+ *		rings			cyclomatic number m - n + fragments, the size of the SSSR
+ *		degree0..		nodes per degree, the last bin also takes everything above
+ *		paths1..		pairs at distance 1, 2, ... (paths1 is edges), farther are left out
+ *
+ *	Threads in a batch each take a contiguous slice of the graphs. Taking the
+ *	snapshot syncs a graph's edge ids, so no two graphs of a threaded batch may
+ *	share nodes (share clones, split fragments).
+ */
+
+#ifndef INC_ALGO_DESCRIPTORS_H_
+#define INC_ALGO_DESCRIPTORS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../instrument/counters.h"
+#include "../structure/direction.h"
+#include "../structure/graph.h"
+#include "../structure/snapshot.h"
+#include "bfs.h"
+
+struct DescriptorOptions
+{
+	bool counts = true; //nodes, edges
+	bool wiener = true;
+	bool balaban = true;
+	bool rings = true;
+	//degree0 .. degree<bins - 1>, 0 for none
+	unsigned int degreeBins = 5;
+	//paths1 .. paths<lengths>, 0 for none
+	unsigned int pathLengths = 8;
+};
+
+class DescriptorEngine
+{
+public:
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	explicit DescriptorEngine(DescriptorOptions options = DescriptorOptions());
+
+	/************************************************
+	 *  GETTER/SETTER PAIRS
+	 ***********************************************/
+	//in output order
+	const std::vector<std::string>& getColumns() const;
+	size_t getColumnCount() const;
+
+	/************************************************
+	 *  COMPUTING
+	 ***********************************************/
+	//one traversable with symmetric rows, column c goes to out[c * stride]
+	template<class G>
+	void computeRow(const G &graph, double *out, size_t stride) const;
+
+	//out holds getColumnCount() * graphs.size() doubles
+	template<class T, class E>
+	void compute(const std::vector<Graph<T, E>*> &graphs, double *out,
+			unsigned int threads = 1) const;
+	template<class T, class E>
+	std::vector<double> compute(const std::vector<Graph<T, E>*> &graphs,
+			unsigned int threads = 1) const;
+
+private:
+	DescriptorOptions options;
+	std::vector<std::string> columns;
+};
+
+/************************************************
+ *  CONSTRUCTORS/DESTRUCTORS
+ ***********************************************/
+
+inline DescriptorEngine::DescriptorEngine(DescriptorOptions options) :
+		options(options)
+{
+	if (this->options.counts)
+	{
+		this->columns.push_back("nodes");
+		this->columns.push_back("edges");
+	}
+	if (this->options.wiener)
+		this->columns.push_back("wiener");
+	if (this->options.balaban)
+		this->columns.push_back("balabanJ");
+	if (this->options.rings)
+		this->columns.push_back("rings");
+	for (unsigned int d = 0; d < this->options.degreeBins; d++)
+		this->columns.push_back("degree" + std::to_string(d));
+	for (unsigned int k = 1; k <= this->options.pathLengths; k++)
+		this->columns.push_back("paths" + std::to_string(k));
+}
+
+/************************************************
+ *  GETTER/SETTER PAIRS
+ ***********************************************/
+
+inline const std::vector<std::string>& DescriptorEngine::getColumns() const
+{
+	return this->columns;
+}
+
+inline size_t DescriptorEngine::getColumnCount() const
+{
+	return this->columns.size();
+}
+
+/************************************************
+ *  COMPUTING
+ ***********************************************/
+
+template<class G>
+void DescriptorEngine::computeRow(const G &graph, double *out, size_t stride) const
+{
+	static_assert(hasSymmetricRows<G>(),
+			"descriptors are undirected, Directed rows would lose half the pairs");
+	PhaseTimer timer("descriptors");
+	const unsigned int n = graph.getNodeCount();
+	std::vector<unsigned int> sources;
+	std::vector<double> degreeCounts(this->options.degreeBins, 0);
+	unsigned long long edges = 0;
+	for (unsigned int v = 0; v < n; v++)
+	{
+		if (!graph.isLive(v))
+			continue;
+		sources.push_back(v);
+		unsigned int degree = graph.getDegree(v);
+		edges += degree;
+		if (!degreeCounts.empty())
+			degreeCounts[std::min<size_t>(degree, degreeCounts.size() - 1)]++;
+	}
+	edges /= 2;
+
+	//every pair gets seen from both of its ends
+	const bool perSource = this->options.balaban || this->options.rings;
+	unsigned long long wiener = 0;
+	unsigned int fragments = 0;
+	std::vector<unsigned long long> pathCounts(this->options.pathLengths + 1, 0);
+	std::vector<unsigned long long> distanceSums(perSource ? n : 0, 0);
+	if (this->options.wiener || this->options.pathLengths || perSource)
+		for (size_t first = 0; first < sources.size(); first += 64)
+		{
+			const size_t lanes = std::min<size_t>(64, sources.size() - first);
+			std::uint64_t notRoot = 0;
+			multiSourceLevels(graph, sources, first,
+					[&](unsigned int w, std::uint64_t fresh, unsigned int level)
+					{
+						unsigned int count = __builtin_popcountll(fresh);
+						wiener += (unsigned long long) level * count;
+						if (level < pathCounts.size())
+							pathCounts[level] += count;
+						if (!perSource)
+							return;
+						for (std::uint64_t bits = fresh; bits; bits &= bits - 1)
+						{
+							unsigned int lane = __builtin_ctzll(bits);
+							distanceSums[sources[first + lane]] += level;
+							//a fragment's root is its smallest id, nothing smaller reaches it
+							if (w < sources[first + lane])
+								notRoot |= std::uint64_t(1) << lane;
+						}
+					});
+			fragments += (unsigned int) lanes - __builtin_popcountll(notRoot);
+		}
+	const long long cyclomatic = (long long) edges - (long long) sources.size()
+			+ fragments;
+
+	size_t column = 0;
+	auto put = [&](double value)
+	{
+		out[column++ * stride] = value;
+	};
+	if (this->options.counts)
+	{
+		put(sources.size());
+		put(edges);
+	}
+	if (this->options.wiener)
+		put(wiener / 2);
+	if (this->options.balaban)
+	{
+		double sum = 0;
+		for (unsigned int v : sources)
+			graph.forEachNeighbor(v, [&](unsigned int w, unsigned int)
+			{
+				if (v < w)
+					sum += 1 / std::sqrt((double) distanceSums[v] * distanceSums[w]);
+			});
+		put(edges ? edges / (cyclomatic + 1.0) * sum : 0);
+	}
+	if (this->options.rings)
+		put(cyclomatic);
+	for (double count : degreeCounts)
+		put(count);
+	for (unsigned int k = 1; k < pathCounts.size(); k++)
+		put(pathCounts[k] / 2);
+}
+
+template<class T, class E>
+void DescriptorEngine::compute(const std::vector<Graph<T, E>*> &graphs,
+		double *out, unsigned int threads) const
+{
+	PhaseTimer timer("descriptorBatch");
+	const size_t rows = graphs.size();
+	auto work = [&](size_t begin, size_t end)
+	{
+		for (size_t g = begin; g < end; g++)
+		{
+			Snapshot<T, E> snapshot(*graphs[g]);
+			this->computeRow(snapshot, out + g, rows);
+		}
+	};
+	//a slice under a few dozen molecules is not worth a thread
+	threads = std::max(1u, std::min<unsigned int>(threads, rows / 64 + 1));
+	if (threads == 1)
+	{
+		work(0, rows);
+		return;
+	}
+	std::vector<std::thread> workers;
+	const size_t slice = (rows + threads - 1) / threads;
+	for (unsigned int t = 0; t < threads; t++)
+		workers.emplace_back(work, std::min(rows, t * slice),
+				std::min(rows, (t + 1) * slice));
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+template<class T, class E>
+std::vector<double> DescriptorEngine::compute(
+		const std::vector<Graph<T, E>*> &graphs, unsigned int threads) const
+{
+	std::vector<double> out(this->getColumnCount() * graphs.size(), 0);
+	this->compute(graphs, out.data(), threads);
+	return out;
+}
+
+#endif /* INC_ALGO_DESCRIPTORS_H_ */
@@ -0,0 +1,242 @@
+/**
+ * @file intersect.h
+ * @brief Sorted id list intersection and bitmap AND kernels.
+ *
+ *	Ring counting, match candidate refinement and common neighbor queries all come
+ *	down to intersecting two sorted adjacency lists (Snapshot rows) or AND-ing two
+ *	bitmap rows. The vector paths are picked at compile time: AVX2 when built with
+ *	-mavx2 (or -march=native on a machine that has it), SSE2 otherwise on x86-64,
+ *	plain scalar code everywhere else. Lists must be sorted and duplicate free.
+ */
+
+#ifndef INC_ALGO_INTERSECT_H_
+#define INC_ALGO_INTERSECT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GRAB_INTERSECT_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define GRAB_INTERSECT_SSE2 1
+#endif
+
+static_assert(sizeof(unsigned int) == 4, "intersection kernels expect 32 bit ids");
+
+/************************************************
+ *  SCALAR KERNELS
+ ***********************************************/
+
+//out may be nullptr when only the count is wanted
+inline size_t intersectSortedScalar(const unsigned int *listA, size_t sizeA,
+		const unsigned int *listB, size_t sizeB, unsigned int *out)
+{
+	size_t i = 0, j = 0, found = 0;
+	while (i < sizeA && j < sizeB)
+	{
+		if (listA[i] < listB[j])
+			i++;
+		else if (listA[i] > listB[j])
+			j++;
+		else
+		{
+			if (out)
+				out[found] = listA[i];
+			found++;
+			i++;
+			j++;
+		}
+	}
+	return found;
+}
+
+inline size_t bitmapAndScalar(const std::uint64_t *rowA,
+		const std::uint64_t *rowB, std::uint64_t *out, size_t words)
+{
+	size_t found = 0;
+	for (size_t w = 0; w < words; w++)
+	{
+		std::uint64_t both = rowA[w] & rowB[w];
+		if (out)
+			out[w] = both;
+		found += __builtin_popcountll(both);
+	}
+	return found;
+}
+
+/************************************************
+ *  VECTOR KERNELS
+ ***********************************************/
+
+/* Block compare: take a block of each list, compare every element of A's block
+ * against every element of B's block (rotating B's register), write out the hits
+ * of A in order, then drop whichever block ends lower. Scalar merge for the tails.
+ */
+#if defined(GRAB_INTERSECT_AVX2)
+inline size_t intersectSortedVector(const unsigned int *listA, size_t sizeA,
+		const unsigned int *listB, size_t sizeB, unsigned int *out)
+{
+	const size_t block = 8;
+	size_t i = 0, j = 0, found = 0;
+	const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+	while (i + block <= sizeA && j + block <= sizeB)
+	{
+		__m256i blockA = _mm256_loadu_si256((const __m256i*) (listA + i));
+		__m256i blockB = _mm256_loadu_si256((const __m256i*) (listB + j));
+		__m256i hits = _mm256_cmpeq_epi32(blockA, blockB);
+		for (int r = 1; r < 8; r++)
+		{
+			blockB = _mm256_permutevar8x32_epi32(blockB, rotate);
+			hits = _mm256_or_si256(hits, _mm256_cmpeq_epi32(blockA, blockB));
+		}
+		unsigned int mask = (unsigned int) _mm256_movemask_ps(
+				_mm256_castsi256_ps(hits));
+		if (out)
+		{
+			while (mask)
+			{
+				out[found++] = listA[i + __builtin_ctz(mask)];
+				mask &= mask - 1;
+			}
+		}
+		else
+			found += __builtin_popcount(mask);
+		unsigned int lastA = listA[i + block - 1], lastB = listB[j + block - 1];
+		if (lastA <= lastB)
+			i += block;
+		if (lastB <= lastA)
+			j += block;
+	}
+	return found
+			+ intersectSortedScalar(listA + i, sizeA - i, listB + j, sizeB - j,
+					out ? out + found : nullptr);
+}
+
+inline size_t bitmapAndVector(const std::uint64_t *rowA,
+		const std::uint64_t *rowB, std::uint64_t *out, size_t words)
+{
+	size_t found = 0, w = 0;
+	for (; w + 4 <= words; w += 4)
+	{
+		__m256i both = _mm256_and_si256(
+				_mm256_loadu_si256((const __m256i*) (rowA + w)),
+				_mm256_loadu_si256((const __m256i*) (rowB + w)));
+		if (out)
+			_mm256_storeu_si256((__m256i*) (out + w), both);
+		found += __builtin_popcountll(_mm256_extract_epi64(both, 0))
+				+ __builtin_popcountll(_mm256_extract_epi64(both, 1))
+				+ __builtin_popcountll(_mm256_extract_epi64(both, 2))
+				+ __builtin_popcountll(_mm256_extract_epi64(both, 3));
+	}
+	return found
+			+ bitmapAndScalar(rowA + w, rowB + w, out ? out + w : nullptr,
+					words - w);
+}
+#elif defined(GRAB_INTERSECT_SSE2)
+inline size_t intersectSortedVector(const unsigned int *listA, size_t sizeA,
+		const unsigned int *listB, size_t sizeB, unsigned int *out)
+{
+	const size_t block = 4;
+	size_t i = 0, j = 0, found = 0;
+	while (i + block <= sizeA && j + block <= sizeB)
+	{
+		__m128i blockA = _mm_loadu_si128((const __m128i*) (listA + i));
+		__m128i blockB = _mm_loadu_si128((const __m128i*) (listB + j));
+		__m128i hits = _mm_cmpeq_epi32(blockA, blockB);
+		blockB = _mm_shuffle_epi32(blockB, _MM_SHUFFLE(0, 3, 2, 1));
+		hits = _mm_or_si128(hits, _mm_cmpeq_epi32(blockA, blockB));
+		blockB = _mm_shuffle_epi32(blockB, _MM_SHUFFLE(0, 3, 2, 1));
+		hits = _mm_or_si128(hits, _mm_cmpeq_epi32(blockA, blockB));
+		blockB = _mm_shuffle_epi32(blockB, _MM_SHUFFLE(0, 3, 2, 1));
+		hits = _mm_or_si128(hits, _mm_cmpeq_epi32(blockA, blockB));
+		unsigned int mask = (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(hits));
+		if (out)
+		{
+			while (mask)
+			{
+				out[found++] = listA[i + __builtin_ctz(mask)];
+				mask &= mask - 1;
+			}
+		}
+		else
+			found += __builtin_popcount(mask);
+		unsigned int lastA = listA[i + block - 1], lastB = listB[j + block - 1];
+		if (lastA <= lastB)
+			i += block;
+		if (lastB <= lastA)
+			j += block;
+	}
+	return found
+			+ intersectSortedScalar(listA + i, sizeA - i, listB + j, sizeB - j,
+					out ? out + found : nullptr);
+}
+
+inline size_t bitmapAndVector(const std::uint64_t *rowA,
+		const std::uint64_t *rowB, std::uint64_t *out, size_t words)
+{
+	size_t found = 0, w = 0;
+	for (; w + 2 <= words; w += 2)
+	{
+		__m128i both = _mm_and_si128(_mm_loadu_si128((const __m128i*) (rowA + w)),
+				_mm_loadu_si128((const __m128i*) (rowB + w)));
+		if (out)
+			_mm_storeu_si128((__m128i*) (out + w), both);
+		found += __builtin_popcountll(rowA[w] & rowB[w])
+				+ __builtin_popcountll(rowA[w + 1] & rowB[w + 1]);
+	}
+	return found
+			+ bitmapAndScalar(rowA + w, rowB + w, out ? out + w : nullptr,
+					words - w);
+}
+#else
+inline size_t intersectSortedVector(const unsigned int *listA, size_t sizeA,
+		const unsigned int *listB, size_t sizeB, unsigned int *out)
+{
+	return intersectSortedScalar(listA, sizeA, listB, sizeB, out);
+}
+
+inline size_t bitmapAndVector(const std::uint64_t *rowA,
+		const std::uint64_t *rowB, std::uint64_t *out, size_t words)
+{
+	return bitmapAndScalar(rowA, rowB, out, words);
+}
+#endif
+
+/************************************************
+ *  PUBLIC PRIMITIVES
+ ***********************************************/
+
+/* Writes the common ids of both lists in ascending order to out (room for
+ * min(sizeA, sizeB) ids) and returns how many. Molecule rows are mostly a handful
+ * of ids long, so short lists skip the vector setup.
+ */
+inline size_t intersectSorted(const unsigned int *listA, size_t sizeA,
+		const unsigned int *listB, size_t sizeB, unsigned int *out)
+{
+	if (sizeA < 8 || sizeB < 8)
+		return intersectSortedScalar(listA, sizeA, listB, sizeB, out);
+	return intersectSortedVector(listA, sizeA, listB, sizeB, out);
+}
+
+inline size_t intersectSortedCount(const unsigned int *listA, size_t sizeA,
+		const unsigned int *listB, size_t sizeB)
+{
+	return intersectSorted(listA, sizeA, listB, sizeB, nullptr);
+}
+
+//out (may be nullptr) gets rowA & rowB, returns the number of set bits
+inline size_t bitmapAnd(const std::uint64_t *rowA, const std::uint64_t *rowB,
+		std::uint64_t *out, size_t words)
+{
+	return bitmapAndVector(rowA, rowB, out, words);
+}
+
+inline size_t bitmapAndCount(const std::uint64_t *rowA,
+		const std::uint64_t *rowB, size_t words)
+{
+	return bitmapAndVector(rowA, rowB, nullptr, words);
+}
+
+#endif /* INC_ALGO_INTERSECT_H_ */
@@ -0,0 +1,682 @@
+/**
+ * @file match.h
+ * @brief Substructure patterns, compiled once and matched rarest atom first.
+ *
+ *	A Pattern is written in a small SMILES like language and compiled into a
+ *	Graph of its own (one node per atom, labeled with the atom's labels):
+ *
+ *		C			an atom labeled C (upper case letter, then lower case ones)
+ *		*			any atom
+ *		[N,O;D2;R]	N or O, exactly two neighbors, in a ring. Terms are split by
+ *					';' and all have to hold: a ',' list of labels, Dn, R, !R, *
+ *		CC(O)N		bonds follow the string, ( ) branches off the atom before it
+ *		C1CCCCC1	a digit opens a ring bond, the same digit again closes it
+ *
+ *	'-' between atoms is allowed and means nothing, bonds have no order or
+ *	direction. Inside brackets R, !R and D<n> are ours, not labels.
+ *
+ *	Matching walks the pattern in the order of a MatchPlan. plan() seeds with
+ *	the atom the target should have the fewest of, judged from the label index
+ *	and degree counts every Graph keeps current (countNodesByLabel(),
+ *	getDegreeCounts()), and then always takes the atom with the most bonds back
+ *	into what is placed, rarest first among those. Every atom after a seed only
+ *	looks at the neighbors of a placed atom's image, and every extra bond is a
+ *	check that prunes right there.
+ *
+ *	A target is two things with the same node ids: rows, any traversable with
+ *	symmetric rows (Snapshot, View, StoredGraph), and labels, anything with the
+ *	label queries above plus selectNodesByLabel(). A Graph is its own labels for
+ *	its Snapshot and Views over that, StoredLabels (store.h) stands in for a
+ *	stored graph. Every embedding is reported, symmetric ones included (a six ring matches a
+ *	benzene twelve times), unless asked for distinct ones: then the pattern's own
+ *	automorphisms (symmetry.h) turn into image[a] < image[b] checks on the plan's
+ *	steps, which cut the symmetric branches off as they are tried and leave one
+ *	embedding per set of symmetric ones.
+ */
+
+#ifndef INC_ALGO_MATCH_H_
+#define INC_ALGO_MATCH_H_
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "../lazyPrints.h"
+#include "../instrument/counters.h"
+#include "../structure/direction.h"
+#include "../structure/node.h"
+#include "../structure/edge.h"
+#include "../structure/graph.h"
+#include "../structure/snapshot.h"
+#include "blocks.h"
+#include "symmetry.h"
+
+//image of atoms not placed yet, and parent of steps that seed a fragment
+const unsigned int noAtom = (unsigned int) -1;
+
+struct PatternAtom
+{
+	//any one of these, empty matches every label
+	std::vector<std::string> labels;
+	//exact number of neighbors, -1 for any
+	int degree = -1;
+	//1 in a ring, 0 not in a ring, -1 either
+	int ring = -1;
+};
+
+struct MatchStep
+{
+	unsigned int atom;
+	//placed neighbor whose image's row gives our candidates, noAtom seeds a fragment
+	unsigned int parent;
+	//other placed neighbors, our image has to be bonded to theirs
+	std::vector<unsigned int> checks;
+	//placed atoms whose images ours has to be above, and below (distinct matches only)
+	std::vector<unsigned int> above;
+	std::vector<unsigned int> below;
+	//target nodes expected to pass the atom's own constraints
+	double estimate;
+};
+
+struct MatchPlan
+{
+	std::vector<MatchStep> steps;
+};
+
+/************************************************
+ *  PATTERN
+ ***********************************************/
+template<class T, class E>
+class Pattern
+{
+	static_assert(!isDirected<E>(), "pattern bonds have no direction");
+public:
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	//check isValid(), a bad pattern says where it went wrong through badBehavior
+	explicit Pattern(std::string text);
+
+	/************************************************
+	 *  GETTER/SETTER PAIRS
+	 ***********************************************/
+	bool isValid() const;
+	std::string getText() const;
+
+	//atom i is the graph's node with id i
+	const Graph<T, E>& getGraph() const;
+	unsigned int getAtomCount() const;
+	const PatternAtom& getAtom(unsigned int atom) const;
+	//neighbors of atom in the pattern, ascending
+	const std::vector<unsigned int>& getBonds(unsigned int atom) const;
+	//automorphisms of the pattern, constraints included
+	const Symmetry& getSymmetry() const;
+
+	/************************************************
+	 *  PLANNING
+	 ***********************************************/
+	//how many of target's nodes should pass atom's own constraints, from its label counts alone
+	template<class L>
+	double estimate(unsigned int atom, const L &target) const;
+	//distinct attaches the symmetry breaking orderings to the steps
+	template<class L>
+	MatchPlan plan(const L &target, bool distinct = false) const;
+
+private:
+	std::string text;
+	bool valid = false;
+	//before the handles so the handles go first and the graph can collect the bonds
+	std::unique_ptr<Graph<T, E>> graph;
+	//a graph lets go of nodes nobody else holds
+	std::vector<std::shared_ptr<Node<E>>> nodes;
+	std::vector<PatternAtom> atoms;
+	std::vector<std::vector<unsigned int>> bonds;
+	Symmetry symmetry;
+
+	/************************************************
+	 *  HELPER FUNCTIONS
+	 ***********************************************/
+	bool parse();
+	bool parseAtom(size_t &at, PatternAtom &atom);
+	void build(const std::vector<std::pair<unsigned int, unsigned int>> &pairs);
+	bool fail(size_t at, std::string msg);
+};
+
+/************************************************
+ *  CONSTRUCTORS/DESTRUCTORS
+ ***********************************************/
+
+template<class T, class E>
+Pattern<T, E>::Pattern(std::string text) :
+		text(text)
+{
+	PhaseTimer timer("patternCompile");
+	this->valid = this->parse();
+}
+
+/************************************************
+ *  GETTER/SETTER PAIRS
+ ***********************************************/
+
+template<class T, class E>
+bool Pattern<T, E>::isValid() const
+{
+	return this->valid;
+}
+
+template<class T, class E>
+std::string Pattern<T, E>::getText() const
+{
+	return this->text;
+}
+
+template<class T, class E>
+const Graph<T, E>& Pattern<T, E>::getGraph() const
+{
+	return *this->graph;
+}
+
+template<class T, class E>
+unsigned int Pattern<T, E>::getAtomCount() const
+{
+	return (unsigned int) this->atoms.size();
+}
+
+template<class T, class E>
+const PatternAtom& Pattern<T, E>::getAtom(unsigned int atom) const
+{
+	return this->atoms[atom];
+}
+
+template<class T, class E>
+const std::vector<unsigned int>& Pattern<T, E>::getBonds(unsigned int atom) const
+{
+	return this->bonds[atom];
+}
+
+template<class T, class E>
+const Symmetry& Pattern<T, E>::getSymmetry() const
+{
+	return this->symmetry;
+}
+
+/************************************************
+ *  PLANNING
+ ***********************************************/
+
+/* Label and degree are taken as independent. There are no ring counts to go
+ * by, a ring constraint just halves the guess.
+ */
+template<class T, class E>
+template<class L>
+double Pattern<T, E>::estimate(unsigned int atom, const L &target) const
+{
+	const std::vector<grabIndex> &degrees = target.getDegreeCounts();
+	double live = 0;
+	for (grabIndex count : degrees)
+		live += count;
+	if (live == 0)
+		return 0;
+	const PatternAtom &constraints = this->atoms[atom];
+	double labeled = live;
+	if (!constraints.labels.empty())
+	{
+		labeled = 0;
+		for (std::string const &label : constraints.labels)
+			labeled += target.countNodesByLabel(label);
+		labeled = std::min(labeled, live);
+	}
+	double fitting = 0;
+	if (constraints.degree >= 0)
+		fitting = ((size_t) constraints.degree < degrees.size()) ?
+				degrees[constraints.degree] : 0;
+	else
+		for (size_t d = this->bonds[atom].size(); d < degrees.size(); d++)
+			fitting += degrees[d];
+	double expected = labeled * fitting / live;
+	if (constraints.ring >= 0)
+		expected /= 2;
+	return expected;
+}
+
+template<class T, class E>
+template<class L>
+MatchPlan Pattern<T, E>::plan(const L &target, bool distinct) const
+{
+	PhaseTimer timer("matchPlan");
+	const unsigned int n = this->getAtomCount();
+	MatchPlan plan;
+	std::vector<double> expected(n);
+	for (unsigned int a = 0; a < n; a++)
+		expected[a] = this->estimate(a, target);
+	std::vector<unsigned char> placed(n, 0);
+	//bonds from each atom into what is placed, anything above 0 is on the frontier
+	std::vector<unsigned int> links(n, 0);
+	while (plan.steps.size() < n)
+	{
+		unsigned int best = noAtom;
+		for (unsigned int a = 0; a < n; a++)
+		{
+			if (placed[a])
+				continue;
+			if (best == noAtom || links[a] > links[best]
+					|| (links[a] == links[best] && expected[a] < expected[best]))
+				best = a;
+		}
+		MatchStep step;
+		step.atom = best;
+		step.parent = noAtom;
+		step.estimate = expected[best];
+		//bonds to placed atoms, the earliest one placed hands out the candidates
+		for (const MatchStep &earlier : plan.steps)
+			if (std::binary_search(this->bonds[best].begin(),
+					this->bonds[best].end(), earlier.atom))
+			{
+				if (step.parent == noAtom)
+					step.parent = earlier.atom;
+				else
+					step.checks.push_back(earlier.atom);
+			}
+		//an ordering is checked by whichever of its two atoms comes later
+		if (distinct)
+			for (const std::pair<unsigned int, unsigned int> &order :
+					this->symmetry.orderings)
+			{
+				if (order.second == best && placed[order.first])
+					step.above.push_back(order.first);
+				else if (order.first == best && placed[order.second])
+					step.below.push_back(order.second);
+			}
+		plan.steps.push_back(step);
+		placed[best] = 1;
+		for (unsigned int neighbor : this->bonds[best])
+			links[neighbor]++;
+	}
+	return plan;
+}
+
+/************************************************
+ *  HELPER FUNCTIONS
+ ***********************************************/
+
+template<class T, class E>
+bool Pattern<T, E>::parse()
+{
+	std::vector<std::pair<unsigned int, unsigned int>> pairs;
+	std::vector<unsigned int> branches;
+	std::unordered_map<char, unsigned int> openRings;
+	unsigned int previous = noAtom;
+	size_t at = 0;
+	while (at < this->text.size())
+	{
+		char c = this->text[at];
+		if (c == '(')
+		{
+			if (previous == noAtom)
+				return this->fail(at, "branch without an atom before it");
+			branches.push_back(previous);
+			at++;
+		}
+		else if (c == ')')
+		{
+			if (branches.empty())
+				return this->fail(at, "')' without a branch to close");
+			previous = branches.back();
+			branches.pop_back();
+			at++;
+		}
+		else if (c == '-')
+			at++;
+		else if (std::isdigit((unsigned char) c))
+		{
+			if (previous == noAtom)
+				return this->fail(at, "ring bond without an atom before it");
+			auto found = openRings.find(c);
+			if (found == openRings.end())
+				openRings.emplace(c, previous);
+			else
+			{
+				if (found->second == previous)
+					return this->fail(at, "ring bond from an atom to itself");
+				pairs.emplace_back(found->second, previous);
+				openRings.erase(found);
+			}
+			at++;
+		}
+		else if (c == '[' || c == '*' || std::isupper((unsigned char) c))
+		{
+			PatternAtom atom;
+			if (!this->parseAtom(at, atom))
+				return false;
+			unsigned int id = (unsigned int) this->atoms.size();
+			this->atoms.push_back(atom);
+			if (previous != noAtom)
+				pairs.emplace_back(previous, id);
+			previous = id;
+		}
+		else
+			return this->fail(at, std::string("unexpected '") + c + "'");
+	}
+	if (!branches.empty())
+		return this->fail(at, "branch left open");
+	if (!openRings.empty())
+		return this->fail(at, "ring bond left open");
+	if (this->atoms.empty())
+		return this->fail(at, "no atoms");
+	this->build(pairs);
+	return true;
+}
+
+template<class T, class E>
+bool Pattern<T, E>::parseAtom(size_t &at, PatternAtom &atom)
+{
+	const std::string &text = this->text;
+	if (text[at] == '*')
+	{
+		at++;
+		return true;
+	}
+	if (text[at] != '[')
+	{
+		size_t end = at + 1;
+		while (end < text.size() && std::islower((unsigned char) text[end]))
+			end++;
+		atom.labels.push_back(text.substr(at, end - at));
+		at = end;
+		return true;
+	}
+	size_t close = text.find(']', at);
+	if (close == std::string::npos)
+		return this->fail(at, "'[' without ']'");
+	size_t start = at + 1;
+	at = close + 1;
+	while (start <= close)
+	{
+		size_t end = std::min(text.find(';', start), close);
+		std::string term = text.substr(start, end - start);
+		start = end + 1;
+		if (term.empty())
+			return this->fail(end, "empty term");
+		if (term == "*")
+			continue;
+		if (term == "R" || term == "!R")
+		{
+			atom.ring = (term == "R");
+			continue;
+		}
+		if (term[0] == 'D' && term.size() > 1
+				&& std::all_of(term.begin() + 1, term.end(), [](char c)
+				{	return std::isdigit((unsigned char) c);}))
+		{
+			//strtoul saturates, so an overflow shows up as out of range too
+			unsigned long degree = std::strtoul(term.c_str() + 1, nullptr, 10);
+			if (degree > (unsigned long) std::numeric_limits<int>::max())
+				return this->fail(end, "degree " + term.substr(1) + " out of range");
+			atom.degree = (int) degree;
+			continue;
+		}
+		if (!atom.labels.empty())
+			return this->fail(end, "more than one label list");
+		size_t from = 0;
+		while (from <= term.size())
+		{
+			size_t comma = std::min(term.find(',', from), term.size());
+			if (comma == from)
+				return this->fail(end, "empty label");
+			atom.labels.push_back(term.substr(from, comma - from));
+			from = comma + 1;
+		}
+	}
+	return true;
+}
+
+template<class T, class E>
+void Pattern<T, E>::build(
+		const std::vector<std::pair<unsigned int, unsigned int>> &pairs)
+{
+	this->graph.reset(new Graph<T, E>("pattern " + this->text));
+	for (unsigned int a = 0; a < this->atoms.size(); a++)
+	{
+		this->nodes.push_back(std::make_shared<Node<E>>("a" + std::to_string(a)));
+		this->nodes.back()->setLabels(this->atoms[a].labels);
+		this->graph->addNode(this->nodes.back());
+	}
+	for (size_t b = 0; b < pairs.size(); b++)
+	{
+		std::shared_ptr<Node<E>> &from = this->nodes[pairs[b].first];
+		std::shared_ptr<Node<E>> &to = this->nodes[pairs[b].second];
+		if (!from->isNeighbor(to))
+			from->addChild("b" + std::to_string(b), to);
+	}
+	//bonds read back off the graph, the way any target's would be
+	Snapshot<T, E> rows(*this->graph);
+	this->bonds.resize(this->atoms.size());
+	for (unsigned int a = 0; a < this->atoms.size(); a++)
+		this->bonds[a].assign(rows.neighborsBegin(a), rows.neighborsEnd(a));
+	//two atoms are only the same color when every constraint is
+	std::map<std::tuple<std::vector<std::string>, int, int>, unsigned int> ranks;
+	std::vector<std::tuple<std::vector<std::string>, int, int>> keys;
+	for (const PatternAtom &atom : this->atoms)
+	{
+		std::vector<std::string> labels = atom.labels;
+		std::sort(labels.begin(), labels.end());
+		labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+		keys.emplace_back(labels, atom.degree, atom.ring);
+		ranks.emplace(keys.back(), 0);
+	}
+	unsigned int rank = 0;
+	for (auto &entry : ranks)
+		entry.second = rank++;
+	std::vector<unsigned int> colors;
+	for (const auto &key : keys)
+		colors.push_back(ranks[key]);
+	this->symmetry = automorphisms(rows, colors);
+}
+
+template<class T, class E>
+bool Pattern<T, E>::fail(size_t at, std::string msg)
+{
+	badBehavior(__LINE__, __func__,
+			"Warning: pattern (" + this->text + ") at " + std::to_string(at)
+					+ ": " + msg);
+	return false;
+}
+
+/************************************************
+ *  MATCHING
+ ***********************************************/
+
+//rows that hand out contiguous neighbor ranges (Snapshot, StoredGraph), a View only walks them
+template<class G, class = void>
+struct HasNeighborRanges: std::false_type
+{
+};
+
+template<class G>
+struct HasNeighborRanges<G,
+		std::void_t<decltype(std::declval<const G&>().neighborsBegin(0u))>> : std::true_type
+{
+};
+
+/* func(image) for every embedding, image[atom] is the target node id it went to.
+ * If func returns bool, returning false stops the search. labels and rows have
+ * to describe the same target as it is now (a Graph and a Snapshot or View of
+ * it, a StoredLabels and its StoredGraph). distinct leaves one of every set of
+ * embeddings that only differ by a symmetry of the pattern.
+ */
+template<class T, class E, class L, class G, class F>
+void forEachMatch(const Pattern<T, E> &pattern, const L &labels, const G &rows,
+		F func, bool distinct = false)
+{
+	static_assert(hasSymmetricRows<G>(), "pattern bonds are matched both ways");
+	if (!pattern.isValid())
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: pattern (" + pattern.getText() + ") did not compile");
+		return;
+	}
+	PhaseTimer timer("match");
+	const unsigned int n = pattern.getAtomCount();
+	const unsigned int nodeCount = rows.getNodeCount();
+	MatchPlan plan = pattern.plan(labels, distinct);
+
+	//label constraints as one byte per target node, straight off the label index
+	std::vector<std::vector<unsigned char>> allowed(n);
+	bool anyRing = false;
+	for (unsigned int a = 0; a < n; a++)
+	{
+		const PatternAtom &atom = pattern.getAtom(a);
+		anyRing |= (atom.ring >= 0);
+		if (atom.labels.empty())
+			continue;
+		allowed[a].assign(nodeCount, 0);
+		for (std::string const &label : atom.labels)
+			for (grabIndex v : labels.selectNodesByLabel(label))
+				if (v < nodeCount)
+					allowed[a][v] = 1;
+	}
+	//a node is in a ring when one of its blocks is more than a bridge
+	std::vector<unsigned char> inRing;
+	if (anyRing)
+	{
+		inRing.assign(nodeCount, 0);
+		BlockCutTree tree = blockCutTree(rows);
+		for (const BiconnectedBlock &block : tree.blocks)
+			if (block.edges.size() > 1)
+				for (unsigned int v : block.nodes)
+					inRing[v] = 1;
+	}
+
+	std::vector<unsigned int> image(n, noAtom);
+	std::vector<unsigned char> used(nodeCount, 0);
+	auto fits = [&](const MatchStep &step, unsigned int v)
+	{
+		const PatternAtom &atom = pattern.getAtom(step.atom);
+		if (used[v] || !rows.isLive(v))
+			return false;
+		if (!allowed[step.atom].empty() && !allowed[step.atom][v])
+			return false;
+		unsigned int degree = rows.getDegree(v);
+		if ((atom.degree >= 0) ?
+				degree != (unsigned int) atom.degree :
+				degree < pattern.getBonds(step.atom).size())
+			return false;
+		if (atom.ring >= 0 && inRing[v] != atom.ring)
+			return false;
+		for (unsigned int check : step.checks)
+			if (!rows.isNeighbor(image[check], v))
+				return false;
+		for (unsigned int other : step.above)
+			if (v < image[other])
+				return false;
+		for (unsigned int other : step.below)
+			if (v > image[other])
+				return false;
+		return true;
+	};
+
+	//seeds take their candidates from a list, everyone else from a placed row
+	std::vector<std::vector<unsigned int>> seeds(n);
+	for (unsigned int s = 0; s < n; s++)
+	{
+		const MatchStep &step = plan.steps[s];
+		if (step.parent != noAtom)
+			continue;
+		for (unsigned int v = 0; v < nodeCount; v++)
+			if (allowed[step.atom].empty() ? rows.isLive(v) : allowed[step.atom][v])
+				seeds[s].push_back(v);
+	}
+	//rows without ranges get their row copied into the step's list when it opens
+	std::vector<const unsigned int*> cursor(n), end(n);
+	auto open = [&](unsigned int s)
+	{
+		const MatchStep &step = plan.steps[s];
+		if (step.parent == noAtom)
+		{
+			cursor[s] = seeds[s].data();
+			end[s] = seeds[s].data() + seeds[s].size();
+		}
+		else if constexpr (HasNeighborRanges<G>::value)
+		{
+			cursor[s] = rows.neighborsBegin(image[step.parent]);
+			end[s] = rows.neighborsEnd(image[step.parent]);
+		}
+		else
+		{
+			seeds[s].clear();
+			rows.forEachNeighbor(image[step.parent], [&](unsigned int w, unsigned int)
+			{
+				seeds[s].push_back(w);
+			});
+			cursor[s] = seeds[s].data();
+			end[s] = seeds[s].data() + seeds[s].size();
+		}
+	};
+
+	unsigned int depth = 0;
+	open(0);
+	while (true)
+	{
+		const MatchStep &step = plan.steps[depth];
+		if (image[step.atom] != noAtom)
+		{
+			used[image[step.atom]] = 0;
+			image[step.atom] = noAtom;
+		}
+		while (cursor[depth] != end[depth])
+		{
+			unsigned int v = *cursor[depth]++;
+			if (fits(step, v))
+			{
+				image[step.atom] = v;
+				used[v] = 1;
+				break;
+			}
+		}
+		if (image[step.atom] == noAtom)
+		{
+			if (depth == 0)
+				return;
+			depth--;
+			continue;
+		}
+		if (depth + 1 < n)
+		{
+			open(++depth);
+			continue;
+		}
+		if constexpr (std::is_same<decltype(func(image)), bool>::value)
+		{
+			if (!func(image))
+				return;
+		}
+		else
+			func(image);
+	}
+}
+
+//at most limit embeddings (0 for all), each indexed by pattern atom
+template<class T, class E, class L, class G>
+std::vector<std::vector<unsigned int>> findMatches(
+		const Pattern<T, E> &pattern, const L &labels, const G &rows,
+		size_t limit = 0, bool distinct = false)
+{
+	std::vector<std::vector<unsigned int>> matches;
+	forEachMatch(pattern, labels, rows,
+			[&](const std::vector<unsigned int> &image)
+			{
+				matches.push_back(image);
+				return limit == 0 || matches.size() < limit;
+			}, distinct);
+	return matches;
+}
+
+#endif /* INC_ALGO_MATCH_H_ */
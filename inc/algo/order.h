@@ -0,0 +1,244 @@
+/**
+ * @file order.h
+ * @brief Node orders that keep neighbors close: reverse Cuthill-McKee, BFS, degree.
+ *
+ *	A graph's dense ids come from insertion order and reused ids, and a Graph's
+ *	nodes sit in a hash set, so nothing says the neighbors of a node have ids (and
+ *	with that payload rows and snapshot rows) anywhere near its own. On big graphs
+ *	every hop of a traversal is then a cache miss.
+ *
+ *	Each function here returns the live node ids of a traversable (see
+ *	snapshot.h) in a new order, order[i] being the node that should become i:
+ *
+ *		reverseCuthillMcKee()	level by level from a far out node, lowest degree
+ *								first, reversed. Smallest bandwidth, best for sweeps
+ *		bfsOrder()				plain level order from the lowest id of each fragment
+ *		degreeOrder()			hubs first, for algorithms that start at high degree
+ *
+ *	Graph::renumberNodes() applies one to the graph's ids, payloads included, and
+ *	snapshots taken after that have the new layout. reorderNodes() does both.
+ *	Fragments stay together (one after the other) in every order but degreeOrder().
+ */
+
+#ifndef INC_ALGO_ORDER_H_
+#define INC_ALGO_ORDER_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "../instrument/counters.h"
+#include "../structure/graph.h"
+#include "../structure/snapshot.h"
+
+enum class NodeOrder
+{
+	ReverseCuthillMcKee, BreadthFirst, Degree
+};
+
+/************************************************
+ *  HELPER FUNCTIONS
+ ***********************************************/
+
+/* Level order from start over nodes not placed yet, appended to reached. Levels
+ * are left set for the caller to reset through reached, returns the last level.
+ */
+template<class G>
+unsigned int orderLevels(const G &graph, unsigned int start,
+		const std::vector<unsigned char> &placed,
+		std::vector<unsigned int> &level, std::vector<unsigned int> &reached)
+{
+	size_t head = reached.size();
+	reached.push_back(start);
+	level[start] = 0;
+	unsigned int last = 0;
+	for (; head < reached.size(); head++)
+	{
+		unsigned int v = reached[head];
+		last = level[v];
+		graph.forEachNeighbor(v, [&](unsigned int w, unsigned int)
+		{
+			if (!placed[w] && level[w] == (unsigned int) -1)
+			{
+				level[w] = last + 1;
+				reached.push_back(w);
+			}
+		});
+	}
+	return last;
+}
+
+/* George and Liu: keep jumping to the lowest degree node of the last level while
+ * that makes the eccentricity grow. Far out starts give narrow levels.
+ */
+template<class G>
+unsigned int peripheralNode(const G &graph, unsigned int start,
+		const std::vector<unsigned char> &placed, std::vector<unsigned int> &level,
+		std::vector<unsigned int> &reached)
+{
+	auto lowestDegree = [&](size_t from, unsigned int onLevel)
+	{
+		unsigned int best = reached[from];
+		for (size_t i = from; i < reached.size(); i++)
+		{
+			unsigned int v = reached[i];
+			if ((onLevel == (unsigned int) -1 || level[v] == onLevel)
+					&& (graph.getDegree(v) < graph.getDegree(best)
+							|| (graph.getDegree(v) == graph.getDegree(best) && v < best)))
+				best = v;
+		}
+		return best;
+	};
+	auto reset = [&]()
+	{
+		for (unsigned int v : reached)
+			level[v] = (unsigned int) -1;
+		reached.clear();
+	};
+
+	orderLevels(graph, start, placed, level, reached);
+	start = lowestDegree(0, (unsigned int) -1);
+	reset();
+	unsigned int eccentricity = orderLevels(graph, start, placed, level, reached);
+	while (true)
+	{
+		unsigned int candidate = lowestDegree(0, eccentricity);
+		reset();
+		unsigned int further = orderLevels(graph, candidate, placed, level, reached);
+		if (further <= eccentricity)
+		{
+			reset();
+			return start;
+		}
+		start = candidate;
+		eccentricity = further;
+	}
+}
+
+/************************************************
+ *  ORDERS
+ ***********************************************/
+
+//neighbors are taken lowest degree first, ties by id
+template<class G>
+std::vector<unsigned int> reverseCuthillMcKee(const G &graph)
+{
+	PhaseTimer timer("reverseCuthillMcKee");
+	const unsigned int n = graph.getNodeCount();
+	std::vector<unsigned int> order;
+	std::vector<unsigned char> placed(n, 0);
+	std::vector<unsigned int> level(n, (unsigned int) -1);
+	std::vector<unsigned int> reached, fresh;
+	for (unsigned int root = 0; root < n; root++)
+	{
+		if (!graph.isLive(root) || placed[root])
+			continue;
+		unsigned int start = peripheralNode(graph, root, placed, level, reached);
+		size_t head = order.size();
+		order.push_back(start);
+		placed[start] = 1;
+		for (; head < order.size(); head++)
+		{
+			fresh.clear();
+			graph.forEachNeighbor(order[head], [&](unsigned int w, unsigned int)
+			{
+				if (!placed[w])
+				{
+					placed[w] = 1;
+					fresh.push_back(w);
+				}
+			});
+			std::sort(fresh.begin(), fresh.end(),
+					[&graph](unsigned int a, unsigned int b)
+					{
+						unsigned int degreeA = graph.getDegree(a);
+						unsigned int degreeB = graph.getDegree(b);
+						return degreeA < degreeB || (degreeA == degreeB && a < b);
+					});
+			order.insert(order.end(), fresh.begin(), fresh.end());
+		}
+	}
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+template<class G>
+std::vector<unsigned int> bfsOrder(const G &graph)
+{
+	PhaseTimer timer("bfsOrder");
+	const unsigned int n = graph.getNodeCount();
+	std::vector<unsigned int> order;
+	std::vector<unsigned char> placed(n, 0);
+	for (unsigned int root = 0; root < n; root++)
+	{
+		if (!graph.isLive(root) || placed[root])
+			continue;
+		size_t head = order.size();
+		order.push_back(root);
+		placed[root] = 1;
+		for (; head < order.size(); head++)
+			graph.forEachNeighbor(order[head], [&](unsigned int w, unsigned int)
+			{
+				if (!placed[w])
+				{
+					placed[w] = 1;
+					order.push_back(w);
+				}
+			});
+	}
+	return order;
+}
+
+//descending degree, ties by id
+template<class G>
+std::vector<unsigned int> degreeOrder(const G &graph)
+{
+	PhaseTimer timer("degreeOrder");
+	const unsigned int n = graph.getNodeCount();
+	std::vector<unsigned int> order;
+	for (unsigned int v = 0; v < n; v++)
+		if (graph.isLive(v))
+			order.push_back(v);
+	std::stable_sort(order.begin(), order.end(),
+			[&graph](unsigned int a, unsigned int b)
+			{	return graph.getDegree(a) > graph.getDegree(b);});
+	return order;
+}
+
+//largest id distance between two neighbors once order is applied, what RCM keeps small
+template<class G>
+unsigned int orderBandwidth(const G &graph, const std::vector<unsigned int> &order)
+{
+	std::vector<unsigned int> position(graph.getNodeCount(), 0);
+	for (unsigned int i = 0; i < order.size(); i++)
+		position[order[i]] = i;
+	unsigned int bandwidth = 0;
+	for (unsigned int v : order)
+		graph.forEachNeighbor(v, [&](unsigned int w, unsigned int)
+		{
+			bandwidth = std::max(bandwidth,
+					(unsigned int) std::abs((long long) position[v] - position[w]));
+		});
+	return bandwidth;
+}
+
+/************************************************
+ *  APPLYING
+ ***********************************************/
+
+//computes the order on a fresh snapshot and renumbers graph by it
+template<class T, class E>
+bool reorderNodes(Graph<T, E> &graph, NodeOrder how = NodeOrder::ReverseCuthillMcKee)
+{
+	Snapshot<T, E> snapshot(graph);
+	std::vector<unsigned int> order;
+	if (how == NodeOrder::ReverseCuthillMcKee)
+		order = reverseCuthillMcKee(snapshot);
+	else if (how == NodeOrder::BreadthFirst)
+		order = bfsOrder(snapshot);
+	else
+		order = degreeOrder(snapshot);
+	return graph.renumberNodes(std::vector<grabIndex>(order.begin(), order.end()));
+}
+
+#endif /* INC_ALGO_ORDER_H_ */
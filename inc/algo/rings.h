@@ -0,0 +1,733 @@
+/**
+ * @file rings.h
+ * @brief Ring perception that keeps up with single bond edits.
+ *
+ *	Rings never cross a biconnected component (block), so a RingTracker keeps the
+ *	ring set per block. Adding a bond between two nodes of the same fragment fuses
+ *	the blocks along the path between them into one, adding one between fragments
+ *	is a new bridge. Removing a bond only splits the block it was in. Either way
+ *	only the block(s) involved get their rings worked out again, every other ring
+ *	is left alone.
+ *
+ *	Rings per block are a smallest set of smallest rings in the usual chemistry
+ *	sense: the shortest independent cycles, as many as the block's circuit rank.
+ *	Ids are the graph's dense node ids, direction is ignored and parallel edges
+ *	count as one bond (same as Snapshot).
+ */
+
+#ifndef INC_ALGO_RINGS_H_
+#define INC_ALGO_RINGS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../structure/node.h"
+#include "../structure/edge.h"
+#include "../structure/graph.h"
+#include "../structure/snapshot.h"
+#include "blocks.h"
+
+/************************************************
+ *  BLOCK HELPERS
+ ***********************************************/
+
+/* Local view of a list of bonds: nodes renumbered 0..k-1, each adjacency entry
+ * is (local neighbor, bond index).
+ */
+struct RingLocalGraph
+{
+	std::vector<unsigned int> nodes;
+	std::vector<std::vector<std::pair<unsigned int, unsigned int>>> adjacency;
+	std::vector<std::pair<unsigned int, unsigned int>> ends;
+
+	explicit RingLocalGraph(const std::vector<std::uint64_t> &edges)
+	{
+		std::unordered_map<unsigned int, unsigned int> local;
+		auto localId = [&](unsigned int node)
+		{
+			auto found = local.find(node);
+			if (found != local.end())
+				return found->second;
+			unsigned int id = (unsigned int) this->nodes.size();
+			local.emplace(node, id);
+			this->nodes.push_back(node);
+			this->adjacency.emplace_back();
+			return id;
+		};
+		for (unsigned int e = 0; e < edges.size(); e++)
+		{
+			unsigned int a = localId(ringEdgeLow(edges[e]));
+			unsigned int b = localId(ringEdgeHigh(edges[e]));
+			this->adjacency[a].emplace_back(b, e);
+			this->adjacency[b].emplace_back(a, e);
+			this->ends.emplace_back(a, b);
+		}
+	}
+};
+
+/* Biconnected components of a bond list (iterative Tarjan, so long chains do not
+ * eat the stack). Bridges come back as one bond blocks.
+ */
+inline std::vector<std::vector<std::uint64_t>> splitBiconnected(
+		const std::vector<std::uint64_t> &edges)
+{
+	RingLocalGraph local(edges);
+	const unsigned int unseen = (unsigned int) -1;
+	std::vector<unsigned int> disc(local.nodes.size(), unseen), low(
+			local.nodes.size(), 0);
+	struct Frame
+	{
+		unsigned int node;
+		unsigned int parentEdge;
+		size_t next;
+	};
+	std::vector<Frame> frames;
+	std::vector<unsigned int> edgeStack;
+	std::vector<std::vector<std::uint64_t>> blocks;
+	unsigned int clock = 0;
+
+	for (unsigned int root = 0; root < local.nodes.size(); root++)
+	{
+		if (disc[root] != unseen)
+			continue;
+		disc[root] = low[root] = clock++;
+		frames.push_back( { root, unseen, 0 });
+		while (!frames.empty())
+		{
+			Frame &frame = frames.back();
+			unsigned int v = frame.node;
+			if (frame.next < local.adjacency[v].size())
+			{
+				std::pair<unsigned int, unsigned int> step =
+						local.adjacency[v][frame.next++];
+				if (step.second == frame.parentEdge)
+					continue;
+				if (disc[step.first] == unseen)
+				{
+					edgeStack.push_back(step.second);
+					disc[step.first] = low[step.first] = clock++;
+					frames.push_back( { step.first, step.second, 0 });
+				}
+				else if (disc[step.first] < disc[v])
+				{
+					edgeStack.push_back(step.second);
+					low[v] = std::min(low[v], disc[step.first]);
+				}
+				continue;
+			}
+			unsigned int parentEdge = frame.parentEdge;
+			frames.pop_back();
+			if (frames.empty())
+				break;
+			unsigned int parent = frames.back().node;
+			low[parent] = std::min(low[parent], low[v]);
+			if (low[v] >= disc[parent])
+			{
+				blocks.emplace_back();
+				unsigned int e;
+				do
+				{
+					e = edgeStack.back();
+					edgeStack.pop_back();
+					blocks.back().push_back(edges[e]);
+				} while (e != parentEdge);
+			}
+		}
+	}
+	return blocks;
+}
+
+/* Cycles kept independent over GF(2), one bit per bond of the block. Every row is
+ * reduced against the ones before it, so a candidate reduces in a single pass.
+ */
+class CycleSpace
+{
+public:
+	explicit CycleSpace(unsigned int edgeCount) :
+			words((edgeCount + 63) / 64)
+	{
+	}
+
+	size_t getRank() const
+	{
+		return this->pivots.size();
+	}
+
+	//keeps the cycle (bond indices) and returns true unless it is a sum of ours
+	bool addIfIndependent(const std::vector<unsigned int> &cycleEdges)
+	{
+		this->row.assign(this->words, 0);
+		for (unsigned int e : cycleEdges)
+			this->row[e / 64] ^= std::uint64_t(1) << (e % 64);
+		for (size_t r = 0; r < this->pivots.size(); r++)
+		{
+			if (!((this->row[this->pivots[r] / 64] >> (this->pivots[r] % 64)) & 1))
+				continue;
+			const std::uint64_t *basisRow = this->rows.data() + r * this->words;
+			for (size_t w = 0; w < this->words; w++)
+				this->row[w] ^= basisRow[w];
+		}
+		for (size_t w = 0; w < this->words; w++)
+		{
+			if (!this->row[w])
+				continue;
+			this->pivots.push_back(w * 64 + __builtin_ctzll(this->row[w]));
+			this->rows.insert(this->rows.end(), this->row.begin(), this->row.end());
+			return true;
+		}
+		return false;
+	}
+
+private:
+	size_t words;
+	std::vector<std::uint64_t> rows;
+	std::vector<size_t> pivots;
+	std::vector<std::uint64_t> row;
+};
+
+/* Smallest rings of one block: candidate cycles are taken shortest first while
+ * they stay independent. Horton's candidates (two shortest paths from a root to
+ * the ends of a bond) make that an exact minimum cycle basis, but it takes a BFS
+ * tree per node, so past hortonLimit (nodes * bonds) we settle for the shortest
+ * cycle through each bond, which still gets fused ring systems right in practice.
+ */
+inline std::vector<std::vector<unsigned int>> smallestRings(
+		const std::vector<std::uint64_t> &edges, size_t hortonLimit = 1 << 16)
+{
+	PhaseTimer timer("smallestRings");
+	RingLocalGraph local(edges);
+	const unsigned int m = (unsigned int) edges.size();
+	const unsigned int k = (unsigned int) local.nodes.size();
+	std::vector<std::vector<unsigned int>> rings;
+	if (m + 1 <= k)
+		return rings;
+	const size_t rank = m - k + 1;
+	const unsigned int none = (unsigned int) -1;
+
+	CycleSpace space(m);
+	std::vector<unsigned int> cycleNodes, cycleEdges;
+	//true once we have all the rings there are
+	auto offer = [&]()
+	{
+		if (space.addIfIndependent(cycleEdges))
+		{
+			rings.emplace_back();
+			for (unsigned int v : cycleNodes)
+				rings.back().push_back(local.nodes[v]);
+		}
+		return rings.size() == rank;
+	};
+	//BFS from one node over the block, skipping one bond, stopping early at target
+	std::vector<unsigned int> queue;
+	auto bfs = [&](unsigned int from, unsigned int skipEdge, unsigned int target,
+			unsigned int *parentNode, unsigned int *parentEdge, unsigned int *depth)
+	{
+		depth[from] = 0;
+		queue.assign(1, from);
+		for (size_t head = 0; head < queue.size(); head++)
+		{
+			unsigned int v = queue[head];
+			for (const std::pair<unsigned int, unsigned int> &step : local.adjacency[v])
+			{
+				if (step.second == skipEdge || depth[step.first] != none)
+					continue;
+				depth[step.first] = depth[v] + 1;
+				parentNode[step.first] = v;
+				parentEdge[step.first] = step.second;
+				queue.push_back(step.first);
+				if (step.first == target)
+					return;
+			}
+		}
+	};
+
+	if ((size_t) k * m <= hortonLimit)
+	{
+		//one tree per root, k * k entries stays within the limit
+		std::vector<unsigned int> parentNode((size_t) k * k), parentEdge(
+				(size_t) k * k, none), depth((size_t) k * k, none);
+		struct Candidate
+		{
+			unsigned int length;
+			unsigned int root;
+			unsigned int edge;
+		};
+		std::vector<Candidate> candidates;
+		for (unsigned int root = 0; root < k; root++)
+		{
+			size_t row = (size_t) root * k;
+			bfs(root, none, none, &parentNode[row], &parentEdge[row], &depth[row]);
+			for (unsigned int e = 0; e < m; e++)
+			{
+				unsigned int a = local.ends[e].first, b = local.ends[e].second;
+				if (parentEdge[row + a] != e && parentEdge[row + b] != e)
+					candidates.push_back( { depth[row + a] + depth[row + b] + 1, root, e });
+			}
+		}
+		std::stable_sort(candidates.begin(), candidates.end(),
+				[](const Candidate &a, const Candidate &b)
+				{	return a.length < b.length;});
+
+		std::vector<unsigned int> down, downEdges;
+		for (const Candidate &candidate : candidates)
+		{
+			size_t row = (size_t) candidate.root * k;
+			cycleNodes.clear();
+			cycleEdges.clear();
+			down.clear();
+			downEdges.clear();
+			for (unsigned int v = local.ends[candidate.edge].first;
+					v != candidate.root; v = parentNode[row + v])
+			{
+				cycleNodes.push_back(v);
+				cycleEdges.push_back(parentEdge[row + v]);
+			}
+			for (unsigned int v = local.ends[candidate.edge].second;
+					v != candidate.root; v = parentNode[row + v])
+			{
+				down.push_back(v);
+				downEdges.push_back(parentEdge[row + v]);
+			}
+			//both tree paths may only meet at the root
+			if (!cycleNodes.empty() && !down.empty()
+					&& cycleNodes.back() == down.back())
+				continue;
+			cycleNodes.push_back(candidate.root);
+			std::reverse(cycleNodes.begin(), cycleNodes.end());
+			cycleNodes.insert(cycleNodes.end(), down.begin(), down.end());
+			cycleEdges.push_back(candidate.edge);
+			cycleEdges.insert(cycleEdges.end(), downEdges.begin(), downEdges.end());
+			if (offer())
+				break;
+		}
+		return rings;
+	}
+
+	//shortest cycle through each bond, only the neighborhood up to it gets walked
+	std::vector<unsigned int> parentNode(k), parentEdge(k, none), depth(k, none);
+	std::vector<std::vector<unsigned int>> candidateNodes, candidateEdges;
+	for (unsigned int e = 0; e < m; e++)
+	{
+		unsigned int a = local.ends[e].first, b = local.ends[e].second;
+		bfs(a, e, b, parentNode.data(), parentEdge.data(), depth.data());
+		if (depth[b] != none)
+		{
+			candidateNodes.emplace_back();
+			candidateEdges.emplace_back(1, e);
+			for (unsigned int v = b; v != a; v = parentNode[v])
+			{
+				candidateNodes.back().push_back(v);
+				candidateEdges.back().push_back(parentEdge[v]);
+			}
+			candidateNodes.back().push_back(a);
+		}
+		for (unsigned int v : queue)
+			depth[v] = none;
+	}
+	std::vector<size_t> order(candidateNodes.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y)
+	{	return candidateNodes[x].size() < candidateNodes[y].size();});
+	for (size_t i : order)
+	{
+		cycleNodes.swap(candidateNodes[i]);
+		cycleEdges.swap(candidateEdges[i]);
+		if (offer())
+			return rings;
+	}
+
+	//short cycles did not span (rare), a tree's fundamental cycles always do
+	bfs(0, none, none, parentNode.data(), parentEdge.data(), depth.data());
+	for (unsigned int e = 0; e < m; e++)
+	{
+		unsigned int a = local.ends[e].first, b = local.ends[e].second;
+		if (parentEdge[a] == e || parentEdge[b] == e)
+			continue;
+		std::vector<unsigned int> down, downEdges;
+		cycleNodes.clear();
+		cycleEdges.assign(1, e);
+		while (depth[a] > depth[b])
+			cycleNodes.push_back(a), cycleEdges.push_back(parentEdge[a]), a =
+					parentNode[a];
+		while (depth[b] > depth[a])
+			down.push_back(b), downEdges.push_back(parentEdge[b]), b = parentNode[b];
+		while (a != b)
+		{
+			cycleNodes.push_back(a), cycleEdges.push_back(parentEdge[a]), a =
+					parentNode[a];
+			down.push_back(b), downEdges.push_back(parentEdge[b]), b = parentNode[b];
+		}
+		cycleNodes.push_back(a);
+		cycleNodes.insert(cycleNodes.end(), down.rbegin(), down.rend());
+		cycleEdges.insert(cycleEdges.end(), downEdges.begin(), downEdges.end());
+		if (offer())
+			break;
+	}
+	return rings;
+}
+
+/************************************************
+ *  WHOLE GRAPH
+ ***********************************************/
+
+/* Smallest rings of every block of a traversable (see blocks.h), blocks are
+ * independent so threads > 1 hands them out biggest first. Rings come back
+ * grouped by block in block order whatever the thread count.
+ */
+template<class G>
+std::vector<std::vector<unsigned int>> smallestRingsPerBlock(const G &graph,
+		unsigned int threads = 1)
+{
+	PhaseTimer timer("smallestRingsPerBlock");
+	BlockCutTree blocks = blockCutTree(graph);
+	//bridges and lone nodes close no rings
+	std::vector<unsigned int> work;
+	for (unsigned int b = 0; b < blocks.getBlockCount(); b++)
+		if (blocks.blocks[b].edges.size() >= 3)
+			work.push_back(b);
+	std::sort(work.begin(), work.end(), [&blocks](unsigned int a, unsigned int b)
+	{	return blocks.blocks[a].edges.size() > blocks.blocks[b].edges.size();});
+
+	std::vector<std::vector<std::vector<unsigned int>>> found(
+			blocks.getBlockCount());
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < work.size(); i = next++)
+			found[work[i]] = smallestRings(blocks.blocks[work[i]].edges);
+	};
+	threads = std::max(1u, std::min<unsigned int>(threads, work.size()));
+	std::vector<std::thread> helpers;
+	for (unsigned int t = 1; t < threads; t++)
+		helpers.emplace_back(worker);
+	worker();
+	for (std::thread &helper : helpers)
+		helper.join();
+
+	std::vector<std::vector<unsigned int>> rings;
+	for (std::vector<std::vector<unsigned int>> &blockRings : found)
+		for (std::vector<unsigned int> &ring : blockRings)
+			rings.push_back(std::move(ring));
+	return rings;
+}
+
+/************************************************
+ *  RING TRACKER
+ ***********************************************/
+
+/* Bond edits have to go through addEdge()/deleteEdges() here for the tracker to
+ * see them, anything done straight on the nodes (or Graph::removeNode(), which can
+ * recycle ids) needs a rebuild().
+ */
+template<class T, class E>
+class RingTracker
+{
+public:
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	explicit RingTracker(Graph<T, E> &graph);
+
+	//from scratch, off a Snapshot of the graph
+	void rebuild();
+
+	/************************************************
+	 *  EDITING
+	 ***********************************************/
+	//parent->addChild(edgeName, child) and fix up the rings it closed
+	void addEdge(std::string edgeName, std::shared_ptr<Node<E>> parent,
+			std::shared_ptr<Node<E>> child);
+	//nodeA->deleteEdges(nodeB) and fix up the rings it opened
+	void deleteEdges(std::shared_ptr<Node<E>> nodeA,
+			std::shared_ptr<Node<E>> nodeB);
+
+	/************************************************
+	 *  GETTER/SETTER PAIRS
+	 ***********************************************/
+	size_t getRingCount() const;
+	//each ring as node ids in walking order
+	std::vector<std::vector<unsigned int>> getRings() const;
+	unsigned int getBlockCount() const;
+	//bonds whose block had its rings recomputed by the last edit/rebuild
+	size_t getLastTouchedEdges() const;
+
+private:
+	struct Block
+	{
+		std::vector<std::uint64_t> edges;
+		std::vector<std::vector<unsigned int>> rings;
+	};
+
+	Graph<T, E> &graph;
+	std::vector<std::vector<unsigned int>> adjacency;
+	std::unordered_map<std::uint64_t, unsigned int> edgeBlock;
+	std::vector<Block> blocks;
+	std::vector<unsigned char> liveBlocks;
+	std::vector<unsigned int> freeBlocks;
+	size_t ringCount = 0;
+	size_t lastTouched = 0;
+
+	/************************************************
+	 *  HELPING FUNCTIONS
+	 ***********************************************/
+	bool trackedIds(std::shared_ptr<Node<E>> nodeA,
+			std::shared_ptr<Node<E>> nodeB, unsigned int &idA, unsigned int &idB);
+	void addBlock(std::vector<std::uint64_t> edges);
+	void dropBlock(unsigned int block);
+	bool findPath(unsigned int from, unsigned int to,
+			std::vector<std::uint64_t> &path) const;
+};
+
+/************************************************
+ *  CONSTRUCTORS/DESTRUCTORS
+ ***********************************************/
+
+template<class T, class E>
+RingTracker<T, E>::RingTracker(Graph<T, E> &graph) :
+		graph(graph)
+{
+	this->rebuild();
+}
+
+template<class T, class E>
+void RingTracker<T, E>::rebuild()
+{
+	PhaseTimer timer("ringRebuild");
+	this->adjacency.clear();
+	this->edgeBlock.clear();
+	this->blocks.clear();
+	this->liveBlocks.clear();
+	this->freeBlocks.clear();
+	this->ringCount = 0;
+	this->lastTouched = 0;
+
+	Snapshot<T, E> snapshot(this->graph);
+	this->adjacency.resize(snapshot.getNodeCount());
+	std::vector<std::uint64_t> edges;
+	if constexpr (hasSymmetricRows<Snapshot<T, E>>())
+	{
+		for (unsigned int v = 0; v < snapshot.getNodeCount(); v++)
+		{
+			this->adjacency[v].assign(snapshot.neighborsBegin(v),
+					snapshot.neighborsEnd(v));
+			for (unsigned int w : this->adjacency[v])
+				if (v < w)
+					edges.push_back(ringEdgeKey(v, w));
+		}
+	}
+	else
+	{
+		//rows only hold children, rings do not care which way a bond points
+		for (unsigned int v = 0; v < snapshot.getNodeCount(); v++)
+			for (const unsigned int *w = snapshot.neighborsBegin(v);
+					w != snapshot.neighborsEnd(v); w++)
+				edges.push_back(ringEdgeKey(v, *w));
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+		for (std::uint64_t key : edges)
+		{
+			this->adjacency[ringEdgeLow(key)].push_back(ringEdgeHigh(key));
+			this->adjacency[ringEdgeHigh(key)].push_back(ringEdgeLow(key));
+		}
+		for (std::vector<unsigned int> &row : this->adjacency)
+			std::sort(row.begin(), row.end());
+	}
+	for (std::vector<std::uint64_t> &block : splitBiconnected(edges))
+		this->addBlock(block);
+}
+
+/************************************************
+ *  EDITING
+ ***********************************************/
+
+template<class T, class E>
+void RingTracker<T, E>::addEdge(std::string edgeName,
+		std::shared_ptr<Node<E>> parent, std::shared_ptr<Node<E>> child)
+{
+	unsigned int idA, idB;
+	if (!this->trackedIds(parent, child, idA, idB))
+		return;
+	parent->addChild(edgeName, child);
+	this->lastTouched = 0;
+	std::vector<unsigned int> &row = this->adjacency[idA];
+	//self loops and parallel bonds do not change any ring
+	if (idA == idB || std::find(row.begin(), row.end(), idB) != row.end())
+		return;
+
+	std::vector<std::uint64_t> path;
+	std::vector<std::uint64_t> merged;
+	if (this->findPath(idA, idB, path))
+	{
+		//every block on the path between the two ends fuses with the new bond
+		std::vector<unsigned int> fused;
+		for (std::uint64_t key : path)
+			fused.push_back(this->edgeBlock[key]);
+		std::sort(fused.begin(), fused.end());
+		fused.erase(std::unique(fused.begin(), fused.end()), fused.end());
+		for (unsigned int block : fused)
+		{
+			merged.insert(merged.end(), this->blocks[block].edges.begin(),
+					this->blocks[block].edges.end());
+			this->dropBlock(block);
+		}
+	}
+	merged.push_back(ringEdgeKey(idA, idB));
+	this->adjacency[idA].push_back(idB);
+	this->adjacency[idB].push_back(idA);
+	this->addBlock(merged);
+}
+
+template<class T, class E>
+void RingTracker<T, E>::deleteEdges(std::shared_ptr<Node<E>> nodeA,
+		std::shared_ptr<Node<E>> nodeB)
+{
+	unsigned int idA, idB;
+	if (!this->trackedIds(nodeA, nodeB, idA, idB))
+		return;
+	nodeA->deleteEdges(nodeB);
+	this->lastTouched = 0;
+	auto found = this->edgeBlock.find(ringEdgeKey(idA, idB));
+	if (found == this->edgeBlock.end())
+		return;
+	unsigned int block = found->second;
+	std::vector<unsigned int> &rowA = this->adjacency[idA];
+	std::vector<unsigned int> &rowB = this->adjacency[idB];
+	rowA.erase(std::find(rowA.begin(), rowA.end(), idB));
+	rowB.erase(std::find(rowB.begin(), rowB.end(), idA));
+
+	//only the bond's own block can fall apart
+	std::vector<std::uint64_t> rest;
+	for (std::uint64_t key : this->blocks[block].edges)
+		if (key != found->first)
+			rest.push_back(key);
+	this->dropBlock(block);
+	for (std::vector<std::uint64_t> &piece : splitBiconnected(rest))
+		this->addBlock(piece);
+}
+
+/************************************************
+ *  GETTER/SETTER PAIRS
+ ***********************************************/
+
+template<class T, class E>
+size_t RingTracker<T, E>::getRingCount() const
+{
+	return this->ringCount;
+}
+
+template<class T, class E>
+std::vector<std::vector<unsigned int>> RingTracker<T, E>::getRings() const
+{
+	std::vector<std::vector<unsigned int>> rings;
+	for (unsigned int b = 0; b < this->blocks.size(); b++)
+		if (this->liveBlocks[b])
+			rings.insert(rings.end(), this->blocks[b].rings.begin(),
+					this->blocks[b].rings.end());
+	return rings;
+}
+
+template<class T, class E>
+unsigned int RingTracker<T, E>::getBlockCount() const
+{
+	return (unsigned int) (this->blocks.size() - this->freeBlocks.size());
+}
+
+template<class T, class E>
+size_t RingTracker<T, E>::getLastTouchedEdges() const
+{
+	return this->lastTouched;
+}
+
+/************************************************
+ *  HELPING FUNCTIONS
+ ***********************************************/
+
+template<class T, class E>
+bool RingTracker<T, E>::trackedIds(std::shared_ptr<Node<E>> nodeA,
+		std::shared_ptr<Node<E>> nodeB, unsigned int &idA, unsigned int &idB)
+{
+	grabIndex wideA = this->graph.getNodeId(nodeA.get());
+	grabIndex wideB = this->graph.getNodeId(nodeB.get());
+	if (wideA == invalidId || wideB == invalidId)
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: both nodes need to be in graph ("
+						+ this->graph.getName() + ") for their rings to be tracked");
+		return false;
+	}
+	idA = (unsigned int) wideA;
+	idB = (unsigned int) wideB;
+	if (this->adjacency.size() < this->graph.getNodeIdBound())
+		this->adjacency.resize(this->graph.getNodeIdBound());
+	return true;
+}
+
+template<class T, class E>
+void RingTracker<T, E>::addBlock(std::vector<std::uint64_t> edges)
+{
+	unsigned int block;
+	if (this->freeBlocks.empty())
+	{
+		block = (unsigned int) this->blocks.size();
+		this->blocks.emplace_back();
+		this->liveBlocks.push_back(1);
+	}
+	else
+	{
+		block = this->freeBlocks.back();
+		this->freeBlocks.pop_back();
+		this->liveBlocks[block] = 1;
+	}
+	for (std::uint64_t key : edges)
+		this->edgeBlock[key] = block;
+	this->blocks[block].rings = smallestRings(edges);
+	this->ringCount += this->blocks[block].rings.size();
+	this->lastTouched += edges.size();
+	this->blocks[block].edges.swap(edges);
+}
+
+template<class T, class E>
+void RingTracker<T, E>::dropBlock(unsigned int block)
+{
+	this->ringCount -= this->blocks[block].rings.size();
+	for (std::uint64_t key : this->blocks[block].edges)
+		this->edgeBlock.erase(key);
+	this->blocks[block] = Block();
+	this->liveBlocks[block] = 0;
+	this->freeBlocks.push_back(block);
+}
+
+//BFS over the bonds we know, path comes back as bond keys
+template<class T, class E>
+bool RingTracker<T, E>::findPath(unsigned int from, unsigned int to,
+		std::vector<std::uint64_t> &path) const
+{
+	std::unordered_map<unsigned int, unsigned int> parent;
+	std::deque<unsigned int> queue(1, from);
+	parent.emplace(from, from);
+	while (!queue.empty())
+	{
+		unsigned int v = queue.front();
+		queue.pop_front();
+		if (v == to)
+		{
+			for (; v != from; v = parent[v])
+				path.push_back(ringEdgeKey(v, parent[v]));
+			return true;
+		}
+		for (unsigned int w : this->adjacency[v])
+			if (parent.emplace(w, v).second)
+				queue.push_back(w);
+	}
+	return false;
+}
+
+#endif /* INC_ALGO_RINGS_H_ */
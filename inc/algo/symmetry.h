@@ -0,0 +1,575 @@
+/**
+ * @file symmetry.h
+ * @brief Automorphism orbits by partition refinement.
+ *
+ *	A C60 has 120 automorphisms, so anything that lists answers (matches, rings)
+ *	lists each of them up to 120 times. automorphisms() finds the symmetry of a
+ *	traversable with colored nodes and edges the usual individualization and
+ *	refinement way: refine the coloring until it is equitable (every node of a
+ *	cell sees the same number of each other cell), pin a node of the first cell
+ *	that is not a singleton, refine again, and so on down to a discrete leaf.
+ *	Other leaves whose path looks the same are tried against the first, each
+ *	match is a generator, and the orbits of the generators are the orbits of the
+ *	whole group.
+ *
+ *	What comes out is the orbits (one representative each), the generators, the
+ *	group size, and the stabilizer chain conditions (orderings) that keep exactly
+ *	one of every set of answers that only differ by an automorphism. Pattern uses
+ *	those to skip symmetric branches (see match.h), cycleClasses() groups rings.
+ *
+ *	Refinement is near linear per level, but the search for other leaves is
+ *	exponential in the worst case (strongly regular graphs and friends), which
+ *	molecule shaped graphs stay well away from.
+ */
+
+#ifndef INC_ALGO_SYMMETRY_H_
+#define INC_ALGO_SYMMETRY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../instrument/counters.h"
+#include "../structure/graph.h"
+#include "../structure/snapshot.h"
+#include "components.h"
+
+//orbit of nodes that are not live
+const unsigned int noOrbit = (unsigned int) -1;
+
+struct Symmetry
+{
+	//per node id, orbits numbered by their smallest node, noOrbit for ids that are not live
+	std::vector<unsigned int> orbitOf;
+	//per orbit
+	std::vector<unsigned int> orbitSizes;
+	//node id -> node id, together they generate every automorphism
+	std::vector<std::vector<unsigned int>> generators;
+	//number of automorphisms, as a double it does not overflow on big symmetric graphs
+	double groupSize = 1;
+	/* (a, b) pairs: of every set of answers that only differ by an automorphism,
+	 * exactly one has image[a] < image[b] for all of them
+	 */
+	std::vector<std::pair<unsigned int, unsigned int>> orderings;
+
+	unsigned int getCount() const
+	{
+		return (unsigned int) this->orbitSizes.size();
+	}
+
+	//the smallest node of its orbit
+	bool isRepresentative(unsigned int node) const
+	{
+		if (this->orbitOf[node] == noOrbit)
+			return false;
+		for (unsigned int v = 0; v < node; v++)
+			if (this->orbitOf[v] == this->orbitOf[node])
+				return false;
+		return true;
+	}
+
+	//smallest node of each orbit, in orbit order
+	std::vector<unsigned int> getRepresentatives() const
+	{
+		std::vector<unsigned int> representatives(this->getCount(), noOrbit);
+		for (unsigned int v = 0; v < this->orbitOf.size(); v++)
+			if (this->orbitOf[v] != noOrbit
+					&& representatives[this->orbitOf[v]] == noOrbit)
+				representatives[this->orbitOf[v]] = v;
+		return representatives;
+	}
+};
+
+/************************************************
+ *  PARTITIONS
+ ***********************************************/
+
+/* Ordered partition of the live nodes, cells are contiguous runs of order.
+ * Everything done to it only looks at colors, counts and cell positions, so two
+ * nodes an automorphism swaps end up in cells at the same positions.
+ */
+class OrderedPartition
+{
+public:
+	std::vector<unsigned int> order;
+	//per node id, where it sits in order
+	std::vector<unsigned int> position;
+	//per node id, where its cell starts
+	std::vector<unsigned int> cellStart;
+	//per cell start, one past its end
+	std::vector<unsigned int> cellEnd;
+	unsigned int cellCount = 0;
+	//hash of every split so far, two paths that split differently differ here
+	std::uint64_t trace = 0;
+	//cells only ever split, so everything before the last open cell found stays singletons
+	mutable unsigned int openFrom = 0;
+
+	bool isDiscrete() const
+	{
+		return this->cellCount == this->order.size();
+	}
+
+	//start of the first cell with more than one node, order.size() when discrete
+	unsigned int firstOpenCell() const
+	{
+		for (; this->openFrom < this->order.size();
+				this->openFrom = this->cellEnd[this->openFrom])
+			if (this->cellEnd[this->openFrom] - this->openFrom > 1)
+				break;
+		return this->openFrom;
+	}
+};
+
+//refinement over one graph, the scratch is kept between calls and left zeroed
+template<class G>
+class PartitionRefiner
+{
+public:
+	//weight[id] is what edge id counts for, empty counts every edge as 1
+	PartitionRefiner(const G &graph, std::vector<std::uint64_t> weight) :
+			graph(graph), weight(std::move(weight)), queued(
+					graph.getNodeCount(), 0), count(graph.getNodeCount(), 0), hits(
+					graph.getNodeCount(), 0), filled(graph.getNodeCount(), 0)
+	{
+	}
+
+	//cells holds the starts of the cells to split by first
+	void refine(OrderedPartition &partition, const std::vector<unsigned int> &cells);
+	void individualize(OrderedPartition &partition, unsigned int node);
+
+private:
+	const G &graph;
+	std::vector<std::uint64_t> weight;
+	std::vector<unsigned char> queued;
+	std::vector<std::uint64_t> count;
+	//per cell start, how many of its nodes the splitter reaches, and how many got moved back
+	std::vector<unsigned int> hits;
+	std::vector<unsigned int> filled;
+	std::vector<unsigned int> touchedNodes;
+	std::vector<unsigned int> touchedCells;
+	std::vector<unsigned int> queue;
+	std::vector<unsigned int> pieces;
+};
+
+/* Refines until every cell queued has been used as a splitter, cells to begin
+ * with and then the pieces of every cell that splits (all but the biggest unless it
+ * was queued already).
+ */
+template<class G>
+void PartitionRefiner<G>::refine(OrderedPartition &partition,
+		const std::vector<unsigned int> &cells)
+{
+	const G &graph = this->graph;
+	const std::vector<std::uint64_t> &weight = this->weight;
+	std::vector<unsigned char> &queued = this->queued;
+	std::vector<std::uint64_t> &count = this->count;
+	std::vector<unsigned int> &hits = this->hits;
+	std::vector<unsigned int> &filled = this->filled;
+	std::vector<unsigned int> &touchedNodes = this->touchedNodes;
+	std::vector<unsigned int> &touchedCells = this->touchedCells;
+	std::vector<unsigned int> &queue = this->queue;
+	std::vector<unsigned int> &pieces = this->pieces;
+	queue.assign(cells.begin(), cells.end());
+	for (unsigned int start : queue)
+		queued[start] = 1;
+	size_t head = 0;
+	while (head < queue.size())
+	{
+		unsigned int splitter = queue[head++];
+		queued[splitter] = 0;
+		unsigned int splitterEnd = partition.cellEnd[splitter];
+		for (unsigned int at = splitter; at < splitterEnd; at++)
+			graph.forEachNeighbor(partition.order[at],
+					[&](unsigned int x, unsigned int edgeId)
+					{
+						if (!graph.isLive(x))
+							return;
+						if (count[x] == 0)
+						{
+							touchedNodes.push_back(x);
+							unsigned int cell = partition.cellStart[x];
+							if (hits[cell]++ == 0)
+								touchedCells.push_back(cell);
+						}
+						count[x] += weight.empty() ? 1 : weight[edgeId];
+					});
+		//reached nodes to the back of their cells, so only they get sorted and renumbered
+		for (unsigned int x : touchedNodes)
+		{
+			unsigned int start = partition.cellStart[x];
+			unsigned int to = partition.cellEnd[start] - 1 - filled[start]++;
+			unsigned int from = partition.position[x];
+			unsigned int other = partition.order[to];
+			partition.order[from] = other;
+			partition.position[other] = from;
+			partition.order[to] = x;
+			partition.position[x] = to;
+		}
+		//cells in order of position, so the pieces come out in the same order on every path
+		std::sort(touchedCells.begin(), touchedCells.end());
+		for (unsigned int start : touchedCells)
+		{
+			unsigned int end = partition.cellEnd[start];
+			unsigned int reached = hits[start];
+			hits[start] = 0;
+			filled[start] = 0;
+			if (end - start == 1)
+				continue;
+			std::sort(partition.order.begin() + (end - reached),
+					partition.order.begin() + end,
+					[&count](unsigned int a, unsigned int b)
+					{	return count[a] < count[b];});
+			for (unsigned int at = end - reached; at < end; at++)
+				partition.position[partition.order[at]] = at;
+			if (count[partition.order[start]] == count[partition.order[end - 1]])
+				continue;
+			//cut into runs of equal counts, what was not reached is one run up front
+			pieces.assign(1, start);
+			for (unsigned int at = std::max(start + 1, end - reached); at < end; at++)
+				if (count[partition.order[at]] != count[partition.order[at - 1]])
+					pieces.push_back(at);
+			pieces.push_back(end);
+			unsigned int biggest = 0;
+			for (unsigned int p = 0; p + 1 < pieces.size(); p++)
+			{
+				unsigned int from = pieces[p], to = pieces[p + 1];
+				partition.cellEnd[from] = to;
+				if (from != start)
+					for (unsigned int at = from; at < to; at++)
+						partition.cellStart[partition.order[at]] = from;
+				partition.trace = partition.trace * 1099511628211ull
+						+ (std::uint64_t(from) << 32) + count[partition.order[from]]
+						+ to;
+				if (to - from > pieces[biggest + 1] - pieces[biggest])
+					biggest = p;
+			}
+			partition.cellCount += (unsigned int) pieces.size() - 2;
+			bool wasQueued = queued[start];
+			for (unsigned int p = 0; p + 1 < pieces.size(); p++)
+				if ((wasQueued || p != biggest) && !queued[pieces[p]])
+				{
+					queued[pieces[p]] = 1;
+					queue.push_back(pieces[p]);
+				}
+		}
+		touchedCells.clear();
+		for (unsigned int x : touchedNodes)
+			count[x] = 0;
+		touchedNodes.clear();
+	}
+}
+
+//node in a cell of its own at the front of its old cell, then refined from there
+template<class G>
+void PartitionRefiner<G>::individualize(OrderedPartition &partition,
+		unsigned int node)
+{
+	unsigned int start = partition.cellStart[node];
+	unsigned int end = partition.cellEnd[start];
+	unsigned int first = partition.order[start];
+	std::swap(partition.order[start], partition.order[partition.position[node]]);
+	partition.position[first] = partition.position[node];
+	partition.position[node] = start;
+	partition.cellEnd[start] = start + 1;
+	partition.cellEnd[start + 1] = end;
+	for (unsigned int at = start + 1; at < end; at++)
+		partition.cellStart[partition.order[at]] = start + 1;
+	partition.cellCount++;
+	partition.trace = partition.trace * 1099511628211ull + start + 1;
+	this->refine(partition, std::vector<unsigned int>(1, start));
+}
+
+/************************************************
+ *  AUTOMORPHISMS
+ ***********************************************/
+
+/* nodeColors per node id and edgeColors per edge id (empty for none) have to
+ * mean the same on any relabeling, i.e. ranks of sorted label sets, not ids
+ * handed out in node order.
+ */
+template<class G>
+Symmetry automorphisms(const G &graph, const std::vector<unsigned int> &nodeColors,
+		const std::vector<unsigned int> &edgeColors =
+				std::vector<unsigned int>())
+{
+	PhaseTimer timer("automorphisms");
+	const unsigned int n = graph.getNodeCount();
+	std::vector<std::uint64_t> weight(edgeColors.size());
+	for (size_t id = 0; id < edgeColors.size(); id++)
+		weight[id] = 1 + edgeColors[id] * 0x9E3779B97F4A7C15ull;
+
+	//the root: live nodes by color
+	OrderedPartition root;
+	root.position.assign(n, 0);
+	root.cellStart.assign(n, 0);
+	root.cellEnd.assign(n + 1, 0);
+	for (unsigned int v = 0; v < n; v++)
+		if (graph.isLive(v))
+			root.order.push_back(v);
+	std::stable_sort(root.order.begin(), root.order.end(),
+			[&nodeColors](unsigned int a, unsigned int b)
+			{	return nodeColors[a] < nodeColors[b];});
+	std::vector<unsigned int> queue;
+	for (unsigned int at = 0; at < root.order.size(); at++)
+	{
+		unsigned int v = root.order[at];
+		root.position[v] = at;
+		if (at == 0 || nodeColors[v] != nodeColors[root.order[at - 1]])
+		{
+			queue.push_back(at);
+			root.cellCount++;
+		}
+		root.cellStart[v] = queue.back();
+		root.cellEnd[queue.back()] = at + 1;
+	}
+	PartitionRefiner<G> refiner(graph, std::move(weight));
+	refiner.refine(root, queue);
+
+	//first path down to a leaf, always pinning the first node of the first open cell.
+	//Every level keeps its shape, only every stride-th keeps its whole partition
+	std::vector<unsigned int> pinned;
+	std::vector<std::pair<unsigned int, std::uint64_t>> shapes(1,
+			std::make_pair(root.cellCount, root.trace));
+	OrderedPartition leafPartition = root;
+	while (!leafPartition.isDiscrete())
+	{
+		pinned.push_back(leafPartition.order[leafPartition.firstOpenCell()]);
+		refiner.individualize(leafPartition, pinned.back());
+		shapes.emplace_back(leafPartition.cellCount, leafPartition.trace);
+	}
+	const std::vector<unsigned int> &leaf = leafPartition.order;
+	size_t stride = 1;
+	while (stride * stride < shapes.size())
+		stride++;
+	std::vector<OrderedPartition> checkpoints(1, root);
+	OrderedPartition walk = root;
+	for (size_t level = 0; level + 1 < pinned.size(); level++)
+	{
+		refiner.individualize(walk, pinned[level]);
+		if ((level + 1) % stride == 0)
+			checkpoints.push_back(walk);
+	}
+	//partitions of the levels from blockStart on, rebuilt off a checkpoint when the loop gets above them
+	std::vector<OrderedPartition> block;
+	size_t blockStart = 0;
+	auto partitionAt = [&](size_t level) -> const OrderedPartition&
+	{
+		if (block.empty() || level < blockStart)
+		{
+			blockStart = level / stride * stride;
+			block.assign(1, checkpoints[level / stride]);
+			while (blockStart + block.size() <= level)
+			{
+				OrderedPartition next = block.back();
+				refiner.individualize(next, pinned[blockStart + block.size() - 1]);
+				block.push_back(std::move(next));
+			}
+		}
+		return block[level - blockStart];
+	};
+	auto looksLike = [&shapes](const OrderedPartition &partition, size_t level)
+	{
+		return partition.cellCount == shapes[level].first
+				&& partition.trace == shapes[level].second;
+	};
+
+	auto edgeColor = [&edgeColors](unsigned int edgeId)
+	{
+		return edgeColors.empty() ? 0u : edgeColors[edgeId];
+	};
+	//leaf order lined up with ours, kept if every colored edge lands on one (rows without parallel edges)
+	std::vector<unsigned int> mark(n, 0);
+	auto tryLeaf = [&](const OrderedPartition &other,
+			std::vector<unsigned int> &perm)
+	{
+		perm.assign(n, noOrbit);
+		for (unsigned int at = 0; at < leaf.size(); at++)
+			perm[leaf[at]] = other.order[at];
+		for (unsigned int v : leaf)
+		{
+			unsigned int image = perm[v];
+			if (nodeColors[v] != nodeColors[image]
+					|| graph.getDegree(v) != graph.getDegree(image))
+				return false;
+			graph.forEachNeighbor(image, [&](unsigned int w, unsigned int edgeId)
+			{	mark[w] = edgeColor(edgeId) + 1;});
+			bool fits = true;
+			graph.forEachNeighbor(v, [&](unsigned int w, unsigned int edgeId)
+			{
+				if (perm[w] == noOrbit || mark[perm[w]] != edgeColor(edgeId) + 1)
+					fits = false;
+			});
+			graph.forEachNeighbor(image, [&](unsigned int w, unsigned int)
+			{	mark[w] = 0;});
+			if (!fits)
+				return false;
+		}
+		return true;
+	};
+	/* Depth first under partition (at path level), only along splits that look
+	 * like the first path's. Most automorphisms only move a little, so first a
+	 * dive pinning what the first path pinned, in place, before anything is copied.
+	 */
+	std::vector<unsigned int> perm;
+	auto search = [&](auto &self, const OrderedPartition &partition,
+			size_t level, bool dived) -> bool
+	{
+		if (!dived)
+		{
+			OrderedPartition dive = partition;
+			for (size_t at = level; !dive.isDiscrete(); at++)
+			{
+				if (dive.cellStart[pinned[at]] != dive.firstOpenCell())
+					break;
+				refiner.individualize(dive, pinned[at]);
+				if (!looksLike(dive, at + 1))
+					break;
+			}
+			if (dive.isDiscrete() && tryLeaf(dive, perm))
+				return true;
+		}
+		if (partition.isDiscrete())
+			return false;
+		unsigned int cell = partition.firstOpenCell();
+		for (unsigned int at = cell; at < partition.cellEnd[cell]; at++)
+		{
+			unsigned int candidate = partition.order[at];
+			OrderedPartition next = partition;
+			refiner.individualize(next, candidate);
+			if (looksLike(next, level + 1)
+					&& self(self, next, level + 1, candidate == pinned[level]))
+				return true;
+		}
+		return false;
+	};
+
+	//bottom up, so whatever is found below already generates the deeper stabilizers
+	Symmetry symmetry;
+	DisjointSets orbits(n);
+	for (size_t level = pinned.size(); level-- > 0;)
+	{
+		const OrderedPartition &above = partitionAt(level);
+		unsigned int base = pinned[level];
+		unsigned int cell = above.cellStart[base];
+		for (unsigned int at = cell; at < above.cellEnd[cell]; at++)
+		{
+			unsigned int other = above.order[at];
+			if (orbits.find(other) == orbits.find(base))
+				continue;
+			OrderedPartition next = above;
+			refiner.individualize(next, other);
+			if (!looksLike(next, level + 1) || !search(search, next, level + 1, false))
+				continue;
+			for (unsigned int v : leaf)
+				orbits.unite(v, perm[v]);
+			symmetry.generators.push_back(perm);
+		}
+		unsigned int orbitSize = 0;
+		for (unsigned int at = cell; at < above.cellEnd[cell]; at++)
+		{
+			unsigned int other = above.order[at];
+			if (orbits.find(other) != orbits.find(base))
+				continue;
+			orbitSize++;
+			if (other != base)
+				symmetry.orderings.emplace_back(base, other);
+		}
+		symmetry.groupSize *= orbitSize;
+	}
+
+	Components numbered = numberComponents(graph, [&orbits](unsigned int v)
+	{	return orbits.find(v);});
+	symmetry.orbitOf.swap(numbered.componentOf);
+	symmetry.orbitSizes.swap(numbered.sizes);
+	return symmetry;
+}
+
+//sorted label sets ranked, so equal label sets get equal colors whatever the ids
+template<class Item>
+std::vector<unsigned int> labelColors(const std::vector<Item> &items)
+{
+	std::vector<std::string> keys(items.size());
+	std::map<std::string, unsigned int> ranks;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		if (!items[i])
+			continue;
+		std::vector<std::string> labels = items[i]->getLabels();
+		std::sort(labels.begin(), labels.end());
+		for (std::string const &label : labels)
+			keys[i] += label + '\0';
+		ranks.emplace(keys[i], 0);
+	}
+	unsigned int rank = 0;
+	for (std::pair<const std::string, unsigned int> &entry : ranks)
+		entry.second = rank++;
+	std::vector<unsigned int> colors(items.size(), 0);
+	for (size_t i = 0; i < items.size(); i++)
+		if (items[i])
+			colors[i] = ranks[keys[i]];
+	return colors;
+}
+
+//node and edge labels as the colors, rows has to be a Snapshot of graph as it is now
+template<class T, class E>
+Symmetry graphAutomorphisms(const Graph<T, E> &graph, const Snapshot<T, E> &rows)
+{
+	std::vector<Node<E>*> nodes(rows.getNodeCount(), nullptr);
+	for (unsigned int v = 0; v < rows.getNodeCount(); v++)
+		if (rows.isLive(v))
+			nodes[v] = graph.getNodeById(v).get();
+	std::vector<Edge<E>*> edges(rows.getEdgeIdBound(), nullptr);
+	for (unsigned int id = 0; id < rows.getEdgeIdBound(); id++)
+		edges[id] = graph.getEdgeById(id);
+	return automorphisms(rows, labelColors(nodes), labelColors(edges));
+}
+
+/************************************************
+ *  SYMMETRIC ANSWERS
+ ***********************************************/
+
+/* Class per cycle (or any node set), two share a class when the automorphisms
+ * map one onto the other. Classes are numbered in order of their first cycle,
+ * which is the one to keep. A set that is not closed under the symmetry (a
+ * smallest ring set can pick one of two equal rings) only links what is there.
+ */
+inline std::vector<unsigned int> cycleClasses(
+		const std::vector<std::vector<unsigned int>> &cycles,
+		const Symmetry &symmetry)
+{
+	std::map<std::vector<unsigned int>, unsigned int> index;
+	for (unsigned int c = 0; c < cycles.size(); c++)
+	{
+		std::vector<unsigned int> key = cycles[c];
+		std::sort(key.begin(), key.end());
+		index.emplace(key, c);
+	}
+	DisjointSets classes((unsigned int) cycles.size());
+	for (const std::vector<unsigned int> &perm : symmetry.generators)
+		for (unsigned int c = 0; c < cycles.size(); c++)
+		{
+			std::vector<unsigned int> image;
+			for (unsigned int v : cycles[c])
+				image.push_back(perm[v]);
+			std::sort(image.begin(), image.end());
+			auto found = index.find(image);
+			if (found != index.end())
+				classes.unite(c, found->second);
+		}
+	std::vector<unsigned int> classOf(cycles.size()), numberOf(cycles.size(),
+			noOrbit);
+	unsigned int count = 0;
+	for (unsigned int c = 0; c < cycles.size(); c++)
+	{
+		unsigned int root = classes.find(c);
+		if (numberOf[root] == noOrbit)
+			numberOf[root] = count++;
+		classOf[c] = numberOf[root];
+	}
+	return classOf;
+}
+
+#endif /* INC_ALGO_SYMMETRY_H_ */
@@ -0,0 +1,444 @@
+/**
+ * @file counters.h
+ * @brief Operation counters and latency histograms for our hot paths.
+ *
+ *	Everything here hides behind instrumentOn, which is a compile time constant.
+ *	When it is false every call below folds away to nothing, so we can leave the
+ *	hooks inside node.h/graph.h/edge.h permanently. Define GRAB_INSTRUMENT true
+ *	before including any of our headers to turn it on.
+ *
+ *	Counts are attributed to the outermost operation currently running on the
+ *	calling thread (i.e. a refresh pass triggered inside Graph::removeNode counts
+ *	towards Graph::removeNode), latencies are kept per operation/phase name.
+ *
+ *	The same PhaseTimer/OpScope markers feed the per thread timeline in trace.h
+ *	(GRAB_TRACE) and its USDT probes (GRAB_USDT), each switch on its own.
+ */
+
+#ifndef INC_INSTRUMENT_COUNTERS_H_
+#define INC_INSTRUMENT_COUNTERS_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "trace.h"
+
+#ifndef GRAB_INSTRUMENT
+#define GRAB_INSTRUMENT false
+#endif
+const bool instrumentOn = GRAB_INSTRUMENT;
+
+//what we count
+enum class OpCounter : unsigned int
+{
+	EdgeInsert, //edge created and linked into both nodes
+	EdgeDelete, //edge unlinked and destroyed
+	NeighborScan, //linear walk over an in/out edge list
+	EdgeVisit, //entries touched by those walks
+	RefcountAccess, //accessors handing out shared_ptr copies (atomic inc/dec each)
+	RefreshPass, //Graph::refreshContaining() sweeps
+	Count
+};
+
+//who we attribute the counts to
+enum class InstrumentedOp : unsigned int
+{
+	Other, //anything outside an instrumented operation, algorithms included
+	NodeAddChild,
+	NodeAddParent,
+	NodeDeleteEdgesToChild,
+	NodeDeleteEdgesToParent,
+	NodeDeleteEdges,
+	NodeGetNeighbors,
+	NodeRelationCheck,
+	GraphAddNode,
+	GraphRemoveNode,
+	GraphDeleteEdges,
+	GraphGetNodes,
+	BatchCommit,
+	BuilderCommit,
+	Count
+};
+
+inline const char* opCounterName(OpCounter counter)
+{
+	static const char *names[] =
+	{ "edge_insert", "edge_delete", "neighbor_scan", "edge_visit",
+			"refcount_access", "refresh_pass" };
+	return names[(unsigned int) counter];
+}
+
+inline const char* instrumentedOpName(InstrumentedOp op)
+{
+	static const char *names[] =
+	{ "Other", "Node::addChild", "Node::addParent", "Node::deleteEdgesToChild",
+			"Node::deleteEdgesToParent", "Node::deleteEdges",
+			"Node::getNeighbors", "Node::relationCheck", "Graph::addNode",
+			"Graph::removeNode", "Graph::deleteEdges", "Graph::getNodes",
+			"Batch::commit", "Builder::commit" };
+	return names[(unsigned int) op];
+}
+
+/************************************************
+ *  HISTOGRAM
+ ***********************************************/
+
+//power of two nanosecond buckets, bucket b holds samples in [2^(b-1), 2^b)
+class LatencyHistogram
+{
+public:
+	static const unsigned int bucketCount = 48;
+
+	void record(unsigned long long nanos)
+	{
+		unsigned int bucket = 0;
+		while (bucket + 1 < bucketCount && (nanos >> bucket) != 0)
+			bucket++;
+		buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		samples.fetch_add(1, std::memory_order_relaxed);
+		totalNanos.fetch_add(nanos, std::memory_order_relaxed);
+		unsigned long long seen = maxNanos.load(std::memory_order_relaxed);
+		while (nanos > seen
+				&& !maxNanos.compare_exchange_weak(seen, nanos,
+						std::memory_order_relaxed))
+			;
+	}
+
+	unsigned long long getCount() const
+	{
+		return samples.load(std::memory_order_relaxed);
+	}
+	unsigned long long getTotalNanos() const
+	{
+		return totalNanos.load(std::memory_order_relaxed);
+	}
+	unsigned long long getMaxNanos() const
+	{
+		return maxNanos.load(std::memory_order_relaxed);
+	}
+	unsigned long long getBucket(unsigned int bucket) const
+	{
+		return buckets[bucket].load(std::memory_order_relaxed);
+	}
+
+	//upper bound of the bucket holding the requested quantile, good enough for dashboards
+	unsigned long long quantileNanos(double quantile) const
+	{
+		unsigned long long wanted = (unsigned long long) (quantile * getCount());
+		unsigned long long seen = 0;
+		for (unsigned int b = 0; b < bucketCount; b++)
+		{
+			seen += getBucket(b);
+			if (seen > wanted)
+				return (b == 0) ? 0 : (1ULL << b);
+		}
+		return getMaxNanos();
+	}
+
+	void reset()
+	{
+		for (auto &bucket : buckets)
+			bucket.store(0, std::memory_order_relaxed);
+		samples.store(0, std::memory_order_relaxed);
+		totalNanos.store(0, std::memory_order_relaxed);
+		maxNanos.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<unsigned long long> buckets[bucketCount] =
+	{ };
+	std::atomic<unsigned long long> samples =
+	{ 0 };
+	std::atomic<unsigned long long> totalNanos =
+	{ 0 };
+	std::atomic<unsigned long long> maxNanos =
+	{ 0 };
+};
+
+/************************************************
+ *  REGISTRY
+ ***********************************************/
+
+class Instrumentation
+{
+public:
+	static Instrumentation& get()
+	{
+		static Instrumentation instance;
+		return instance;
+	}
+
+	void count(InstrumentedOp op, OpCounter counter, unsigned long long amount)
+	{
+		counts[(unsigned int) op][(unsigned int) counter].fetch_add(amount,
+				std::memory_order_relaxed);
+	}
+
+	unsigned long long getCount(InstrumentedOp op, OpCounter counter) const
+	{
+		return counts[(unsigned int) op][(unsigned int) counter].load(
+				std::memory_order_relaxed);
+	}
+
+	unsigned long long getCalls(InstrumentedOp op) const
+	{
+		return calls[(unsigned int) op].load(std::memory_order_relaxed);
+	}
+
+	void countCall(InstrumentedOp op)
+	{
+		calls[(unsigned int) op].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//histograms are never removed, so the returned reference stays valid
+	LatencyHistogram& histogram(const std::string &phase)
+	{
+		std::lock_guard<std::mutex> lock(histogramLock);
+		std::unique_ptr<LatencyHistogram> &slot = histograms[phase];
+		if (!slot)
+			slot = std::make_unique<LatencyHistogram>();
+		return *slot;
+	}
+
+	//the op's histogram() kept in a slot of its own, the lock is only taken to fill it
+	LatencyHistogram& opHistogram(InstrumentedOp op)
+	{
+		std::atomic<LatencyHistogram*> &slot = opHistograms[(unsigned int) op];
+		LatencyHistogram *hist = slot.load(std::memory_order_acquire);
+		if (!hist)
+		{
+			hist = &this->histogram(instrumentedOpName(op));
+			slot.store(hist, std::memory_order_release);
+		}
+		return *hist;
+	}
+
+	/* histogram() behind a per thread cache, so a thread takes the lock once per
+	 * name. Checked by content in case the name's address got reused.
+	 */
+	LatencyHistogram& phaseHistogram(const char *phase)
+	{
+		thread_local std::unordered_map<const char*,
+				std::pair<std::string, LatencyHistogram*>> cached;
+		auto found = cached.find(phase);
+		if (found != cached.end() && found->second.first == phase)
+			return *found->second.second;
+		LatencyHistogram &hist = this->histogram(phase);
+		cached[phase] = std::make_pair(std::string(phase), &hist);
+		return hist;
+	}
+
+	void reset()
+	{
+		for (auto &opCounts : counts)
+			for (auto &count : opCounts)
+				count.store(0, std::memory_order_relaxed);
+		for (auto &call : calls)
+			call.store(0, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(histogramLock);
+		for (auto &entry : histograms)
+			entry.second->reset();
+	}
+
+	/* Flattened metrics for whoever wants to scrape us (i.e. a production metrics
+	 * exporter), names look like "grab.op.Graph::removeNode.refresh_pass" and
+	 * "grab.phase.Graph::removeNode.p99_ns".
+	 */
+	void scrape(
+			const std::function<void(const std::string&, double)> &callback)
+	{
+		for (unsigned int op = 0; op < (unsigned int) InstrumentedOp::Count; op++)
+		{
+			std::string prefix = std::string("grab.op.")
+					+ instrumentedOpName((InstrumentedOp) op) + ".";
+			callback(prefix + "calls", (double) calls[op].load());
+			for (unsigned int c = 0; c < (unsigned int) OpCounter::Count; c++)
+				callback(prefix + opCounterName((OpCounter) c),
+						(double) counts[op][c].load());
+		}
+		std::lock_guard<std::mutex> lock(histogramLock);
+		for (auto &entry : histograms)
+		{
+			std::string prefix = "grab.phase." + entry.first + ".";
+			LatencyHistogram &hist = *entry.second;
+			callback(prefix + "count", (double) hist.getCount());
+			callback(prefix + "sum_ns", (double) hist.getTotalNanos());
+			callback(prefix + "max_ns", (double) hist.getMaxNanos());
+			callback(prefix + "p50_ns", (double) hist.quantileNanos(0.5));
+			callback(prefix + "p99_ns", (double) hist.quantileNanos(0.99));
+		}
+	}
+
+	std::string asJson()
+	{
+		std::ostringstream out;
+		out << "{\n  \"operations\": {";
+		bool first = true;
+		for (unsigned int op = 0; op < (unsigned int) InstrumentedOp::Count; op++)
+		{
+			out << (first ? "\n" : ",\n") << "    \""
+					<< instrumentedOpName((InstrumentedOp) op)
+					<< "\": {\"calls\": " << calls[op].load();
+			for (unsigned int c = 0; c < (unsigned int) OpCounter::Count; c++)
+				out << ", \"" << opCounterName((OpCounter) c) << "\": "
+						<< counts[op][c].load();
+			out << "}";
+			first = false;
+		}
+		out << "\n  },\n  \"phases\": {";
+		first = true;
+		std::lock_guard<std::mutex> lock(histogramLock);
+		for (auto &entry : histograms)
+		{
+			LatencyHistogram &hist = *entry.second;
+			out << (first ? "\n" : ",\n") << "    \"" << entry.first
+					<< "\": {\"count\": " << hist.getCount() << ", \"sum_ns\": "
+					<< hist.getTotalNanos() << ", \"max_ns\": "
+					<< hist.getMaxNanos() << ", \"buckets\": [";
+			bool firstBucket = true;
+			for (unsigned int b = 0; b < LatencyHistogram::bucketCount; b++)
+			{
+				if (hist.getBucket(b) == 0)
+					continue;
+				out << (firstBucket ? "" : ", ") << "[" << ((b == 0) ? 0 : (1ULL << b))
+						<< ", " << hist.getBucket(b) << "]";
+				firstBucket = false;
+			}
+			out << "]}";
+			first = false;
+		}
+		out << "\n  }\n}\n";
+		return out.str();
+	}
+
+private:
+	Instrumentation() = default;
+
+	std::atomic<unsigned long long> counts[(unsigned int) InstrumentedOp::Count][(unsigned int) OpCounter::Count] =
+	{ };
+	std::atomic<unsigned long long> calls[(unsigned int) InstrumentedOp::Count] =
+	{ };
+	std::mutex histogramLock;
+	std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+	std::atomic<LatencyHistogram*> opHistograms[(unsigned int) InstrumentedOp::Count] =
+	{ };
+};
+
+/************************************************
+ *  HOOKS
+ ***********************************************/
+
+//outermost instrumented operation running on this thread
+inline InstrumentedOp& currentInstrumentedOp()
+{
+	thread_local InstrumentedOp current = InstrumentedOp::Other;
+	return current;
+}
+
+inline void countOp(OpCounter counter, unsigned long long amount = 1)
+{
+	if (instrumentOn)
+		Instrumentation::get().count(currentInstrumentedOp(), counter, amount);
+}
+
+//times a named phase (algorithm step, pipeline stage, ...) into its histogram and the trace
+class PhaseTimer
+{
+public:
+	explicit PhaseTimer(const char *phaseName) :
+			phaseName(phaseName)
+	{
+		GRAB_PROBE(phase_begin, phaseName);
+		//the recorder's epoch has to predate the start of the first scope
+		if (traceOn)
+			TraceRecorder::get();
+		if (instrumentOn || traceOn)
+			this->start = std::chrono::steady_clock::now();
+	}
+
+	~PhaseTimer()
+	{
+		GRAB_PROBE(phase_end, this->phaseName);
+		if (instrumentOn || traceOn)
+		{
+			std::chrono::steady_clock::time_point end =
+					std::chrono::steady_clock::now();
+			if (instrumentOn)
+				Instrumentation::get().phaseHistogram(this->phaseName).record(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(
+								end - this->start).count());
+			if (traceOn)
+				TraceRecorder::get().record(this->phaseName, this->start, end);
+		}
+	}
+
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+	const char *phaseName = nullptr;
+	std::chrono::steady_clock::time_point start;
+};
+
+/* Marks a public Graph/Node operation. Only the outermost one on a thread takes
+ * the attribution and gets timed, nested calls (deleteEdges calling
+ * deleteEdgesToChild calling deleteOutEdge) just add to its counts.
+ */
+class OpScope
+{
+public:
+	explicit OpScope(InstrumentedOp op)
+	{
+		if (instrumentOn || traceOn || GRAB_USDT)
+		{
+			InstrumentedOp &current = currentInstrumentedOp();
+			if (current == InstrumentedOp::Other)
+			{
+				this->outermost = true;
+				current = op;
+				GRAB_PROBE(op_begin, instrumentedOpName(op));
+				if (instrumentOn)
+					Instrumentation::get().countCall(op);
+				if (traceOn)
+					TraceRecorder::get();
+				this->start = std::chrono::steady_clock::now();
+			}
+		}
+	}
+
+	~OpScope()
+	{
+		if ((instrumentOn || traceOn || GRAB_USDT) && this->outermost)
+		{
+			InstrumentedOp &current = currentInstrumentedOp();
+			std::chrono::steady_clock::time_point end =
+					std::chrono::steady_clock::now();
+			const char *name = instrumentedOpName(current);
+			GRAB_PROBE(op_end, name);
+			if (instrumentOn)
+				Instrumentation::get().opHistogram(current).record(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(
+								end - this->start).count());
+			if (traceOn)
+				TraceRecorder::get().record(name, this->start, end);
+			current = InstrumentedOp::Other;
+		}
+	}
+
+	OpScope(const OpScope&) = delete;
+	OpScope& operator=(const OpScope&) = delete;
+
+private:
+	bool outermost = false;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif /* INC_INSTRUMENT_COUNTERS_H_ */
@@ -0,0 +1,98 @@
+/**
+ * @file footprint.h
+ * @brief Byte accounting for our structures, see Graph::getFootprint().
+ *
+ *	Counts what our objects hold: the objects themselves, heap buffers behind
+ *	names/labels (short names living in the string's own buffer cost nothing
+ *	extra) and vector capacity, split into used and slack. Allocator headers are
+ *	not ours to see, so they are not included.
+ */
+
+#ifndef INC_INSTRUMENT_FOOTPRINT_H_
+#define INC_INSTRUMENT_FOOTPRINT_H_
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+//make_shared layout: use count, weak count and the control block's vptr
+const size_t sharedControlBytes = 2 * sizeof(long) + sizeof(void*);
+
+struct Footprint
+{
+	size_t nodeCount = 0;
+	size_t edgeCount = 0;
+
+	size_t nodeBytes = 0; //Node objects plus their shared_ptr control blocks
+	size_t edgeBytes = 0; //Edge objects
+	size_t adjacencyBytes = 0; //used part of in/out edge lists
+	size_t nameBytes = 0; //heap held by names
+	size_t labelBytes = 0; //label vectors and the heap held by each label
+	size_t containerBytes = 0; //graph bookkeeping (node set, id tables, name/labels)
+	size_t payloadBytes = 0; //typed node/edge payload columns
+	size_t slackBytes = 0; //reserved but unused vector capacity
+
+	size_t total() const
+	{
+		return nodeBytes + edgeBytes + adjacencyBytes + nameBytes + labelBytes
+				+ containerBytes + payloadBytes + slackBytes;
+	}
+
+	void add(const Footprint &other)
+	{
+		nodeCount += other.nodeCount;
+		edgeCount += other.edgeCount;
+		nodeBytes += other.nodeBytes;
+		edgeBytes += other.edgeBytes;
+		adjacencyBytes += other.adjacencyBytes;
+		nameBytes += other.nameBytes;
+		labelBytes += other.labelBytes;
+		containerBytes += other.containerBytes;
+		payloadBytes += other.payloadBytes;
+		slackBytes += other.slackBytes;
+	}
+
+	std::string asJson() const
+	{
+		std::ostringstream out;
+		out << "{\"nodes\": " << nodeCount << ", \"edges\": " << edgeCount
+				<< ", \"node_bytes\": " << nodeBytes << ", \"edge_bytes\": "
+				<< edgeBytes << ", \"adjacency_bytes\": " << adjacencyBytes
+				<< ", \"name_bytes\": " << nameBytes << ", \"label_bytes\": "
+				<< labelBytes << ", \"container_bytes\": " << containerBytes
+				<< ", \"payload_bytes\": " << payloadBytes << ", \"slack_bytes\": "
+				<< slackBytes << ", \"total_bytes\": " << total() << "}";
+		return out.str();
+	}
+};
+
+/************************************************
+ *  HELPER FUNCTIONS
+ ***********************************************/
+
+//heap bytes behind a string, zero while it fits the small string buffer
+inline size_t stringHeapBytes(const std::string &str)
+{
+	const char *data = str.data();
+	const char *self = reinterpret_cast<const char*>(&str);
+	if (data >= self && data < self + sizeof(std::string))
+		return 0;
+	return str.capacity() + 1;
+}
+
+template<class V>
+void addVectorBytes(const std::vector<V> &vec, size_t &used, size_t &slack)
+{
+	used += vec.size() * sizeof(V);
+	slack += (vec.capacity() - vec.size()) * sizeof(V);
+}
+
+inline void addLabelBytes(const std::vector<std::string> &labels,
+		Footprint &footprint)
+{
+	addVectorBytes(labels, footprint.labelBytes, footprint.slackBytes);
+	for (const std::string &label : labels)
+		footprint.labelBytes += stringHeapBytes(label);
+}
+
+#endif /* INC_INSTRUMENT_FOOTPRINT_H_ */
@@ -0,0 +1,292 @@
+/**
+ * @file trace.h
+ * @brief Per thread timeline of our phases and operations, for chrome://tracing.
+ *
+ *	The histograms in counters.h say how long a phase takes over many calls,
+ *	not whether parsing, building, a refresh pass or an algorithm made this one
+ *	molecule slow, or what the other threads were doing meanwhile. With
+ *	GRAB_TRACE true every PhaseTimer and outermost OpScope also leaves a complete
+ *	event (name, thread, start, duration) in its thread's buffer.
+ *
+ *	A buffer is a chain of fixed size chunks its thread appends to on its own
+ *	and publishes with a release store, so recording takes no lock (only the
+ *	first event of a thread, or of a new phase name on it, does) and export can
+ *	run while threads are still going, it sees what was published so far.
+ *	writeChromeTrace() writes trace event JSON that chrome://tracing and
+ *	Perfetto load; setEnabled(false) pauses recording so only the part of a
+ *	batch run that matters gets kept.
+ *
+ *	With GRAB_USDT true (needs <sys/sdt.h>, i.e. systemtap-sdt-dev) the same
+ *	markers also fire the USDT probes grab:phase_begin/phase_end and
+ *	grab:op_begin/op_end with the name as argument. They are a nop until perf
+ *	(perf probe sdt_grab:phase_begin) or bpftrace attaches to them, and need no
+ *	GRAB_TRACE or GRAB_INSTRUMENT.
+ */
+
+#ifndef INC_INSTRUMENT_TRACE_H_
+#define INC_INSTRUMENT_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+
+#ifndef GRAB_TRACE
+#define GRAB_TRACE false
+#endif
+const bool traceOn = GRAB_TRACE;
+
+#ifndef GRAB_USDT
+#define GRAB_USDT false
+#endif
+#if GRAB_USDT
+#include <sys/sdt.h>
+#define GRAB_PROBE(probe, name) DTRACE_PROBE1(grab, probe, name)
+#else
+#define GRAB_PROBE(probe, name) do { } while (0)
+#endif
+
+class TraceRecorder
+{
+public:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	static TraceRecorder& get()
+	{
+		static TraceRecorder instance;
+		return instance;
+	}
+
+	void setEnabled(bool enabled)
+	{
+		this->enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	bool isEnabled() const
+	{
+		return this->enabled.load(std::memory_order_relaxed);
+	}
+
+	//name has to stay readable until the call returns, we keep our own copy
+	void record(const char *name, TimePoint begin, TimePoint end)
+	{
+		if (!this->isEnabled())
+			return;
+		ThreadBuffer &buffer = this->local();
+		Chunk *tail = buffer.tail;
+		unsigned int used = tail->used.load(std::memory_order_relaxed);
+		if (used == chunkEvents)
+		{
+			Chunk *next = new Chunk();
+			tail->next.store(next, std::memory_order_release);
+			buffer.tail = tail = next;
+			used = 0;
+		}
+		TraceEvent &event = tail->events[used];
+		event.name = this->intern(buffer, name);
+		event.begin = this->sinceEpoch(begin);
+		event.duration = this->sinceEpoch(end) - event.begin;
+		tail->used.store(used + 1, std::memory_order_release);
+	}
+
+	//shows up as the thread's name in the viewer
+	void nameThread(const std::string &name)
+	{
+		ThreadBuffer &buffer = this->local();
+		std::lock_guard<std::mutex> lock(this->registryLock);
+		buffer.name = name;
+	}
+
+	size_t getEventCount()
+	{
+		size_t count = 0;
+		std::lock_guard<std::mutex> lock(this->registryLock);
+		for (const std::unique_ptr<ThreadBuffer> &buffer : this->buffers)
+			for (const Chunk *chunk = &buffer->head; chunk;
+					chunk = chunk->next.load(std::memory_order_acquire))
+				count += chunk->used.load(std::memory_order_acquire);
+		return count;
+	}
+
+	//drops every event, only while no thread is recording (between runs)
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(this->registryLock);
+		for (std::unique_ptr<ThreadBuffer> &buffer : this->buffers)
+		{
+			buffer->head.drop();
+			buffer->tail = &buffer->head;
+		}
+	}
+
+	std::string asChromeJson()
+	{
+		std::ostringstream out;
+		const long pid = (long) getpid();
+		out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+		bool first = true;
+		std::lock_guard<std::mutex> lock(this->registryLock);
+		for (const std::unique_ptr<ThreadBuffer> &buffer : this->buffers)
+		{
+			if (!buffer->name.empty())
+			{
+				out << (first ? "\n" : ",\n")
+						<< "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": "
+						<< pid << ", \"tid\": " << buffer->tid
+						<< ", \"args\": {\"name\": \"" << escaped(buffer->name)
+						<< "\"}}";
+				first = false;
+			}
+			for (const Chunk *chunk = &buffer->head; chunk;
+					chunk = chunk->next.load(std::memory_order_acquire))
+			{
+				unsigned int used = chunk->used.load(std::memory_order_acquire);
+				for (unsigned int e = 0; e < used; e++)
+				{
+					const TraceEvent &event = chunk->events[e];
+					//microseconds are the unit, keep the nanoseconds as decimals
+					out << (first ? "\n" : ",\n") << "{\"name\": \""
+							<< escaped(*event.name)
+							<< "\", \"cat\": \"grab\", \"ph\": \"X\", \"pid\": " << pid
+							<< ", \"tid\": " << buffer->tid << ", \"ts\": "
+							<< microseconds(event.begin) << ", \"dur\": "
+							<< microseconds(event.duration) << "}";
+					first = false;
+				}
+			}
+		}
+		out << "\n]}\n";
+		return out.str();
+	}
+
+	bool writeChromeTrace(const std::string &path)
+	{
+		std::ofstream file(path);
+		file << this->asChromeJson();
+		return (bool) file;
+	}
+
+private:
+	static const unsigned int chunkEvents = 1024;
+
+	struct TraceEvent
+	{
+		const std::string *name;
+		std::uint64_t begin; //ns since the recorder started
+		std::uint64_t duration;
+	};
+	//filled by one thread, next and used are what readers go by
+	struct Chunk
+	{
+		TraceEvent events[chunkEvents];
+		std::atomic<unsigned int> used { 0 };
+		std::atomic<Chunk*> next { nullptr };
+
+		~Chunk()
+		{
+			this->drop();
+		}
+
+		//the rest of the chain, iteratively so long traces do not recurse deep
+		void drop()
+		{
+			Chunk *chunk = this->next.exchange(nullptr);
+			while (chunk)
+			{
+				Chunk *after = chunk->next.exchange(nullptr);
+				delete chunk;
+				chunk = after;
+			}
+			this->used.store(0);
+		}
+	};
+	struct ThreadBuffer
+	{
+		unsigned int tid;
+		std::string name;
+		Chunk head;
+		Chunk *tail = &head;
+		//names this thread has passed, checked by content in case an address got reused
+		std::unordered_map<const char*, const std::string*> names;
+	};
+
+	std::atomic<bool> enabled { true };
+	TimePoint epoch = std::chrono::steady_clock::now();
+	std::mutex registryLock;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	std::set<std::string> names;
+
+	TraceRecorder() = default;
+
+	ThreadBuffer& local()
+	{
+		thread_local ThreadBuffer *mine = nullptr;
+		if (!mine)
+		{
+			std::lock_guard<std::mutex> lock(this->registryLock);
+			this->buffers.emplace_back(new ThreadBuffer());
+			mine = this->buffers.back().get();
+			mine->tid = (unsigned int) this->buffers.size();
+		}
+		return *mine;
+	}
+
+	const std::string* intern(ThreadBuffer &buffer, const char *name)
+	{
+		auto found = buffer.names.find(name);
+		if (found != buffer.names.end() && *found->second == name)
+			return found->second;
+		std::lock_guard<std::mutex> lock(this->registryLock);
+		const std::string *kept = &*this->names.insert(name).first;
+		buffer.names[name] = kept;
+		return kept;
+	}
+
+	//clamped, a time taken before the recorder existed must not wrap around
+	std::uint64_t sinceEpoch(TimePoint point) const
+	{
+		long long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				point - this->epoch).count();
+		return nanos > 0 ? (std::uint64_t) nanos : 0;
+	}
+
+	static std::string microseconds(std::uint64_t nanos)
+	{
+		std::string fraction = std::to_string(nanos % 1000);
+		return std::to_string(nanos / 1000) + "."
+				+ std::string(3 - fraction.size(), '0') + fraction;
+	}
+
+	static std::string escaped(const std::string &text)
+	{
+		std::string out;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				out += '\\';
+			if ((unsigned char) c < 0x20)
+				out += ' ';
+			else
+				out += c;
+		}
+		return out;
+	}
+};
+
+//names the calling thread's row in the trace, a no-op unless GRAB_TRACE
+inline void nameTraceThread(const std::string &name)
+{
+	if (traceOn)
+		TraceRecorder::get().nameThread(name);
+}
+
+#endif /* INC_INSTRUMENT_TRACE_H_ */
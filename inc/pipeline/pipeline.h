@@ -0,0 +1,276 @@
+/**
+ * @file pipeline.h
+ * @brief Multi-threaded stage pipeline for pushing many molecules through grab.
+ *
+ *	Every Graph is only ever touched by one thread at a time, so we get our
+ *	parallelism from many molecules instead: a source produces items, each stage
+ *	runs on its own pool of threads and hands its items to the next stage through a
+ *	bounded queue, a sink consumes whatever comes out. Full queues block the stage
+ *	feeding them, so a slow stage throttles everything upstream instead of letting
+ *	parsed molecules pile up in memory.
+ *
+ *	Each worker thread owns one Scratch for the whole run, stages should keep their
+ *	reusable buffers in there rather than allocating per item. Items are moved
+ *	between stages, so something like std::unique_ptr<Job> keeps that cheap.
+ */
+
+#ifndef INC_PIPELINE_PIPELINE_H_
+#define INC_PIPELINE_PIPELINE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../lazyPrints.h"
+#include "../instrument/counters.h"
+
+/************************************************
+ *  BOUNDED QUEUE
+ ***********************************************/
+
+template<class T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity) :
+			capacity(capacity ? capacity : 1)
+	{
+	}
+
+	//blocks while full, false if the queue was closed
+	bool push(T &&item)
+	{
+		std::unique_lock<std::mutex> lock(this->guard);
+		this->notFull.wait(lock, [this]()
+		{	return this->closed || this->items.size() < this->capacity;});
+		if (this->closed)
+			return false;
+		this->items.push_back(std::move(item));
+		lock.unlock();
+		this->notEmpty.notify_one();
+		return true;
+	}
+
+	//blocks while empty, false once closed and drained
+	bool pop(T &item)
+	{
+		std::unique_lock<std::mutex> lock(this->guard);
+		this->notEmpty.wait(lock, [this]()
+		{	return this->closed || !this->items.empty();});
+		if (this->items.empty())
+			return false;
+		item = std::move(this->items.front());
+		this->items.pop_front();
+		lock.unlock();
+		this->notFull.notify_one();
+		return true;
+	}
+
+	//no more pushes, poppers still get what is left
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->guard);
+			this->closed = true;
+		}
+		this->notEmpty.notify_all();
+		this->notFull.notify_all();
+	}
+
+private:
+	size_t capacity;
+	bool closed = false;
+	std::deque<T> items;
+	std::mutex guard;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+};
+
+/************************************************
+ *  PIPELINE
+ ***********************************************/
+
+//for pipelines whose stages need no per thread state
+struct NoScratch
+{
+};
+
+struct StageStats
+{
+	std::string name;
+	unsigned int threads = 0;
+	size_t processed = 0;
+	size_t dropped = 0;
+};
+
+template<class Item, class Scratch = NoScratch>
+class Pipeline
+{
+public:
+	//false drops the item, it never reaches the later stages
+	typedef std::function<bool(Item&, Scratch&)> StageFunc;
+
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	explicit Pipeline(size_t queueCapacity = 256);
+
+	/************************************************
+	 *  BUILDING
+	 ***********************************************/
+	//threads == 0 means one per hardware thread
+	void addStage(std::string name, unsigned int threads, StageFunc func);
+
+	/************************************************
+	 *  RUNNING
+	 ***********************************************/
+	/* source fills its argument and returns true until it runs dry, it runs on its
+	 * own thread. sink runs on the calling thread in completion order (not input
+	 * order). Returns how many items reached the sink.
+	 */
+	size_t run(std::function<bool(Item&)> source,
+			std::function<void(Item&)> sink);
+
+	std::vector<StageStats> getStageStats() const;
+
+private:
+	struct Stage
+	{
+		std::string name;
+		unsigned int threads;
+		StageFunc func;
+		std::atomic<size_t> processed;
+		std::atomic<size_t> dropped;
+	};
+
+	size_t queueCapacity;
+	std::vector<std::unique_ptr<Stage>> stages;
+};
+
+/************************************************
+ *  CONSTRUCTORS/DESTRUCTORS
+ ***********************************************/
+
+template<class Item, class Scratch>
+Pipeline<Item, Scratch>::Pipeline(size_t queueCapacity) :
+		queueCapacity(queueCapacity)
+{
+}
+
+/************************************************
+ *  BUILDING
+ ***********************************************/
+
+template<class Item, class Scratch>
+void Pipeline<Item, Scratch>::addStage(std::string name, unsigned int threads,
+		StageFunc func)
+{
+	if (!func)
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: stage " + name + " has nothing to run");
+		return;
+	}
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	std::unique_ptr<Stage> stage(new Stage());
+	stage->name = name;
+	stage->threads = threads;
+	stage->func = func;
+	stage->processed = 0;
+	stage->dropped = 0;
+	this->stages.push_back(std::move(stage));
+}
+
+/************************************************
+ *  RUNNING
+ ***********************************************/
+
+template<class Item, class Scratch>
+size_t Pipeline<Item, Scratch>::run(std::function<bool(Item&)> source,
+		std::function<void(Item&)> sink)
+{
+	//queues[i] feeds stage i, the last one feeds the sink
+	std::vector<std::unique_ptr<BoundedQueue<Item>>> queues;
+	for (size_t i = 0; i <= this->stages.size(); i++)
+		queues.emplace_back(new BoundedQueue<Item>(this->queueCapacity));
+
+	std::vector<std::thread> threads;
+	threads.emplace_back([&]()
+	{
+		nameTraceThread("source");
+		Item item;
+		while (source(item))
+			if (!queues[0]->push(std::move(item)))
+				break;
+		queues[0]->close();
+	});
+
+	//the last worker out of a stage closes the queue after it
+	std::vector<std::unique_ptr<std::atomic<unsigned int>>> running;
+	for (const std::unique_ptr<Stage> &stage : this->stages)
+		running.emplace_back(new std::atomic<unsigned int>(stage->threads));
+
+	for (size_t i = 0; i < this->stages.size(); i++)
+	{
+		Stage *stage = this->stages[i].get();
+		for (unsigned int t = 0; t < stage->threads; t++)
+			threads.emplace_back([&, i, stage, t]()
+			{
+				nameTraceThread(stage->name + " " + std::to_string(t));
+				Scratch scratch;
+				Item item;
+				while (queues[i]->pop(item))
+				{
+					bool keep;
+					{
+						PhaseTimer timer(stage->name.c_str());
+						keep = stage->func(item, scratch);
+					}
+					stage->processed++;
+					if (!keep)
+						stage->dropped++;
+					else if (!queues[i + 1]->push(std::move(item)))
+						break;
+				}
+				if (--(*running[i]) == 0)
+					queues[i + 1]->close();
+			});
+	}
+
+	size_t emitted = 0;
+	Item item;
+	while (queues.back()->pop(item))
+	{
+		sink(item);
+		emitted++;
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+	return emitted;
+}
+
+template<class Item, class Scratch>
+std::vector<StageStats> Pipeline<Item, Scratch>::getStageStats() const
+{
+	std::vector<StageStats> stats;
+	for (const std::unique_ptr<Stage> &stage : this->stages)
+	{
+		StageStats entry;
+		entry.name = stage->name;
+		entry.threads = stage->threads;
+		entry.processed = stage->processed;
+		entry.dropped = stage->dropped;
+		stats.push_back(entry);
+	}
+	return stats;
+}
+
+#endif /* INC_PIPELINE_PIPELINE_H_ */
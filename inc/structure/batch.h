@@ -0,0 +1,430 @@
+/**
+ * @file batch.h
+ * @brief Queue up many edge edits on a Graph and apply them in one go.
+ *
+ *	Every Node::deleteEdgesToChild()/deleteEdgesToParent() scans both edge lists,
+ *	erases from them one edge at a time and (with nodeVerbose) cross checks them
+ *	twice. A Batch instead collects the edits, marks every doomed edge first and
+ *	then compacts each touched node's in/out lists once, appends the new edges, and
+ *	(with nodeVerbose) checks the in/out invariants of the touched nodes a single
+ *	time at commit.
+ *
+ *	Removals are applied before additions whatever order they were queued in, so
+ *	deleting and re-adding a bond in one batch replaces it. With a rollback log the
+ *	removed edges are kept (not destroyed) until the next commit or clearLog(), so
+ *	a failed commit, or a later rollback(), can put everything back.
+ */
+
+#ifndef INC_STRUCTURE_BATCH_H_
+#define INC_STRUCTURE_BATCH_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "node.h"
+#include "edge.h"
+#include "graph.h"
+#include "direction.h"
+
+template<class T, class E>
+class Batch
+{
+public:
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	Batch(Graph<T, E> &graph, bool keepRollbackLog = false);
+
+	/************************************************
+	 *  QUEUEING
+	 ***********************************************/
+	//same as parent->addChild(edgeName, child)
+	void addEdge(std::string edgeName, std::shared_ptr<Node<E>> parent,
+			std::shared_ptr<Node<E>> child);
+	//same as parent->deleteEdgesToChild(child)
+	void deleteEdgesToChild(std::shared_ptr<Node<E>> parent,
+			std::shared_ptr<Node<E>> child);
+	//same as nodeA->deleteEdges(nodeB), both directions
+	void deleteEdges(std::shared_ptr<Node<E>> nodeA,
+			std::shared_ptr<Node<E>> nodeB);
+	//same as node->deleteEdges()
+	void deleteEdges(std::shared_ptr<Node<E>> node);
+
+	size_t getQueued() const;
+	void clearQueued();
+
+	/************************************************
+	 *  APPLYING
+	 ***********************************************/
+	/* Applies everything queued and empties the queue. Nothing is touched if a
+	 * queued node is not in our graph. False if the invariant check failed, in which
+	 * case the batch was rolled back when we keep a log.
+	 */
+	bool commit();
+	//undoes the last commit, needs the rollback log
+	bool rollback();
+	//drops the removed edges we were keeping for a rollback
+	void clearLog();
+
+private:
+	enum class Kind
+	{
+		Add, DeleteToChild, DeleteBetween, DeleteAll
+	};
+	struct Pending
+	{
+		Kind kind;
+		std::string edgeName;
+		std::shared_ptr<Node<E>> nodeA;
+		std::shared_ptr<Node<E>> nodeB;
+	};
+
+	Graph<T, E> &graph;
+	bool keepRollbackLog;
+	std::vector<Pending> queued;
+
+	//last commit, for rollback()
+	std::vector<std::unique_ptr<Edge<E>>> removedEdges;
+	std::vector<Edge<E>*> addedEdges;
+
+	/************************************************
+	 *  HELPER FUNCTIONS
+	 ***********************************************/
+	void queue(Kind kind, std::string edgeName, std::shared_ptr<Node<E>> nodeA,
+			std::shared_ptr<Node<E>> nodeB);
+	bool inGraph(const Pending &pending) const;
+	void markDoomed(const Pending &pending, std::unordered_set<Edge<E>*> &doomed,
+			std::unordered_set<Node<E>*> &touched) const;
+	//doomed edges not kept for a rollback end up in dying, the caller drops them last
+	void unlink(const std::unordered_set<Edge<E>*> &doomed,
+			const std::unordered_set<Node<E>*> &touched,
+			std::vector<std::unique_ptr<Edge<E>>> &dying);
+	bool checkInvariants(const std::unordered_set<Node<E>*> &touched) const;
+	//degrees before we touch the lists, handed back to the nodes' watchers after
+	std::vector<std::pair<Node<E>*, size_t>> degreesOf(
+			const std::unordered_set<Node<E>*> &touched) const;
+	void notifyDegrees(const std::vector<std::pair<Node<E>*, size_t>> &oldDegrees);
+};
+
+/************************************************
+ *  CONSTRUCTORS/DESTRUCTORS
+ ***********************************************/
+
+template<class T, class E>
+Batch<T, E>::Batch(Graph<T, E> &graph, bool keepRollbackLog) :
+		graph(graph), keepRollbackLog(keepRollbackLog)
+{
+}
+
+/************************************************
+ *  QUEUEING
+ ***********************************************/
+
+template<class T, class E>
+void Batch<T, E>::addEdge(std::string edgeName,
+		std::shared_ptr<Node<E>> parent, std::shared_ptr<Node<E>> child)
+{
+	if (parent.get() == child.get())
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning, we are trying to add self as a child.");
+		return;
+	}
+	this->queue(Kind::Add, edgeName, parent, child);
+}
+
+template<class T, class E>
+void Batch<T, E>::deleteEdgesToChild(std::shared_ptr<Node<E>> parent,
+		std::shared_ptr<Node<E>> child)
+{
+	this->queue(Kind::DeleteToChild, "", parent, child);
+}
+
+template<class T, class E>
+void Batch<T, E>::deleteEdges(std::shared_ptr<Node<E>> nodeA,
+		std::shared_ptr<Node<E>> nodeB)
+{
+	this->queue(Kind::DeleteBetween, "", nodeA, nodeB);
+}
+
+template<class T, class E>
+void Batch<T, E>::deleteEdges(std::shared_ptr<Node<E>> node)
+{
+	this->queue(Kind::DeleteAll, "", node, nullptr);
+}
+
+template<class T, class E>
+size_t Batch<T, E>::getQueued() const
+{
+	return this->queued.size();
+}
+
+template<class T, class E>
+void Batch<T, E>::clearQueued()
+{
+	this->queued.clear();
+}
+
+/************************************************
+ *  APPLYING
+ ***********************************************/
+
+template<class T, class E>
+bool Batch<T, E>::commit()
+{
+	OpScope scope(InstrumentedOp::BatchCommit);
+	for (const Pending &pending : this->queued)
+	{
+		if (!this->inGraph(pending))
+		{
+			badBehavior(__LINE__, __func__,
+					"Warning: batch names a node not present in graph ("
+							+ this->graph.getName() + "), nothing applied");
+			this->queued.clear();
+			return false;
+		}
+	}
+	this->clearLog();
+
+	std::unordered_set<Edge<E>*> doomed;
+	std::unordered_set<Node<E>*> touched;
+	for (const Pending &pending : this->queued)
+		if (pending.kind != Kind::Add)
+			this->markDoomed(pending, doomed, touched);
+		else
+		{
+			touched.insert(pending.nodeA.get());
+			touched.insert(pending.nodeB.get());
+		}
+	std::vector<std::pair<Node<E>*, size_t>> oldDegrees = this->degreesOf(
+			touched);
+	//a dying edge may be all that holds a touched node, it has to outlive the watchers and checks
+	std::vector<std::unique_ptr<Edge<E>>> dying;
+	this->unlink(doomed, touched, dying);
+
+	std::unordered_map<Node<E>*, size_t> extraOut;
+	for (const Pending &pending : this->queued)
+		if (pending.kind == Kind::Add)
+			extraOut[pending.nodeA.get()]++;
+	for (const std::pair<Node<E>* const, size_t> &extra : extraOut)
+		extra.first->reserveEdges(extra.second, 0);
+	for (const Pending &pending : this->queued)
+	{
+		if (pending.kind != Kind::Add)
+			continue;
+		Edge<E> *added = Node<E>::linkEdge(
+				std::make_unique<Edge<E>>(pending.edgeName, pending.nodeA,
+						pending.nodeB));
+		if (this->keepRollbackLog)
+			this->addedEdges.push_back(added);
+		countOp(OpCounter::EdgeInsert);
+	}
+	this->queued.clear();
+	this->notifyDegrees(oldDegrees);
+
+	if (nodeVerbose && !this->checkInvariants(touched))
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: in and out edges disagree after batch on graph ("
+						+ this->graph.getName() + ")");
+		if (this->keepRollbackLog)
+			this->rollback();
+		return false;
+	}
+	return true;
+}
+
+template<class T, class E>
+bool Batch<T, E>::rollback()
+{
+	if (!this->keepRollbackLog)
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: batch was made without a rollback log");
+		return false;
+	}
+	std::unordered_set<Edge<E>*> doomed(this->addedEdges.begin(),
+			this->addedEdges.end());
+	std::unordered_set<Node<E>*> touched;
+	for (Edge<E> *added : this->addedEdges)
+	{
+		touched.insert(added->sourceNode.get());
+		touched.insert(added->sinkNode.get());
+	}
+	for (std::unique_ptr<Edge<E>> &removed : this->removedEdges)
+	{
+		touched.insert(removed->sourceNode.get());
+		touched.insert(removed->sinkNode.get());
+	}
+	std::vector<std::pair<Node<E>*, size_t>> oldDegrees = this->degreesOf(
+			touched);
+	//the removed edges come back first so unlink() does not log the added ones
+	std::vector<std::unique_ptr<Edge<E>>> restore;
+	restore.swap(this->removedEdges);
+	bool keep = this->keepRollbackLog;
+	this->keepRollbackLog = false;
+	std::vector<std::unique_ptr<Edge<E>>> dying;
+	this->unlink(doomed, touched, dying);
+	this->keepRollbackLog = keep;
+	for (std::unique_ptr<Edge<E>> &edge : restore)
+	{
+		Node<E>::linkEdge(std::move(edge));
+		countOp(OpCounter::EdgeInsert);
+	}
+	this->addedEdges.clear();
+	this->notifyDegrees(oldDegrees);
+	return true;
+}
+
+template<class T, class E>
+void Batch<T, E>::clearLog()
+{
+	this->removedEdges.clear();
+	this->addedEdges.clear();
+}
+
+/************************************************
+ *  HELPER FUNCTIONS
+ ***********************************************/
+
+template<class T, class E>
+void Batch<T, E>::queue(Kind kind, std::string edgeName,
+		std::shared_ptr<Node<E>> nodeA, std::shared_ptr<Node<E>> nodeB)
+{
+	Pending pending;
+	pending.kind = kind;
+	pending.edgeName = edgeName;
+	pending.nodeA = nodeA;
+	pending.nodeB = nodeB;
+	this->queued.push_back(pending);
+}
+
+template<class T, class E>
+bool Batch<T, E>::inGraph(const Pending &pending) const
+{
+	if (this->graph.getNodeId(pending.nodeA.get()) == invalidId)
+		return false;
+	return !pending.nodeB
+			|| this->graph.getNodeId(pending.nodeB.get()) != invalidId;
+}
+
+template<class T, class E>
+void Batch<T, E>::markDoomed(const Pending &pending,
+		std::unordered_set<Edge<E>*> &doomed,
+		std::unordered_set<Node<E>*> &touched) const
+{
+	Node<E> *nodeA = pending.nodeA.get();
+	Node<E> *nodeB = pending.nodeB.get();
+	//undirected there is no parent or child, same as Node::deleteEdgesToChild()
+	Kind kind = pending.kind;
+	if constexpr (isUndirected<E>())
+		if (kind == Kind::DeleteToChild)
+			kind = Kind::DeleteBetween;
+	auto mark = [&](Edge<E> *edge, Node<E> *farEnd)
+	{
+		if (kind == Kind::DeleteAll || farEnd == nodeB)
+		{
+			doomed.insert(edge);
+			touched.insert(farEnd);
+		}
+	};
+	countOp(OpCounter::NeighborScan);
+	//to a child only the edges nodeA owns count
+	if (kind == Kind::DeleteToChild)
+	{
+		countOp(OpCounter::EdgeVisit, nodeA->getOwnedCount());
+		nodeA->forEachOwnedEdge([&](Edge<E> *outEdge)
+		{
+			mark(outEdge, outEdge->sinkNode.get());
+		});
+	}
+	else
+	{
+		countOp(OpCounter::EdgeVisit, nodeA->getDegree());
+		nodeA->forEachEdge([&](Edge<E> *edge, const std::shared_ptr<Node<E>> &farEnd)
+		{
+			mark(edge, farEnd.get());
+		});
+	}
+	touched.insert(nodeA);
+	if (nodeB)
+		touched.insert(nodeB);
+}
+
+/* One compaction pass per touched node: borrowed entries just go, owned edges
+ * move to dying and from there to the log (or get destroyed by the caller) once
+ * no list points at them anymore.
+ */
+template<class T, class E>
+void Batch<T, E>::unlink(const std::unordered_set<Edge<E>*> &doomed,
+		const std::unordered_set<Node<E>*> &touched,
+		std::vector<std::unique_ptr<Edge<E>>> &dying)
+{
+	if (doomed.empty())
+		return;
+	for (Node<E> *node : touched)
+		node->dropEdges([&](Edge<E> *edge, const std::shared_ptr<Node<E>>&)
+		{	return doomed.count(edge) > 0;}, dying);
+	countOp(OpCounter::EdgeDelete, dying.size());
+	if (this->keepRollbackLog)
+	{
+		for (std::unique_ptr<Edge<E>> &edge : dying)
+			this->removedEdges.push_back(std::move(edge));
+		dying.clear();
+	}
+}
+
+//every edge a touched node owns is borrowed by its sink, and the other way round
+template<class T, class E>
+bool Batch<T, E>::checkInvariants(
+		const std::unordered_set<Node<E>*> &touched) const
+{
+	std::unordered_set<const Edge<E>*> owned, incoming;
+	for (Node<E> *node : touched)
+	{
+		bool fine = true;
+		node->forEachOwnedEdge([&](Edge<E> *outEdge)
+		{
+			if (outEdge->sourceNode.get() != node || !owned.insert(outEdge).second)
+				fine = false;
+		});
+		node->forEachBorrowedEdge([&](Edge<E> *inEdge)
+		{
+			if (inEdge->sinkNode.get() != node || !incoming.insert(inEdge).second)
+				fine = false;
+		});
+		if (!fine)
+			return false;
+	}
+	for (const Edge<E> *edge : owned)
+		if (touched.count(edge->sinkNode.get()) && !incoming.count(edge))
+			return false;
+	for (const Edge<E> *edge : incoming)
+		if (touched.count(edge->sourceNode.get()) && !owned.count(edge))
+			return false;
+	return true;
+}
+
+template<class T, class E>
+std::vector<std::pair<Node<E>*, size_t>> Batch<T, E>::degreesOf(
+		const std::unordered_set<Node<E>*> &touched) const
+{
+	std::vector<std::pair<Node<E>*, size_t>> degrees;
+	degrees.reserve(touched.size());
+	for (Node<E> *node : touched)
+		degrees.emplace_back(node, node->getDegree());
+	return degrees;
+}
+
+template<class T, class E>
+void Batch<T, E>::notifyDegrees(
+		const std::vector<std::pair<Node<E>*, size_t>> &oldDegrees)
+{
+	for (std::pair<Node<E>*, size_t> const &old : oldDegrees)
+		old.first->notifyDegree(old.second);
+}
+
+#endif /* INC_STRUCTURE_BATCH_H_ */
@@ -0,0 +1,328 @@
+/**
+ * @file builder.h
+ * @brief Many threads stage nodes and edges for one Graph, one commit links them.
+ *
+ *	Node::addChild() pushes onto both ends' edge lists and tells their watchers,
+ *	so a big polymer or assembly gets loaded one edge at a time. A Builder gives
+ *	every loading thread a shard of its own (padded to a cache line) to stage
+ *	nodes and edges in: no locks, no atomics, and the Edge objects (name, both
+ *	node handles) are made right there in the staging thread.
+ *
+ *	commit() then moves everything into the graph in a single consolidation:
+ *	the staged nodes go in through addNodes(), every edge end is resolved to a
+ *	graph id, and the edge lists are reserved and appended to with the nodes
+ *	split between threads by id, so no two threads ever touch the same list.
+ *	Degree changes go to the nodes' watchers once per node at the end, the
+ *	way Batch does it. Edge ids are handed out lazily as always (syncEdgeIds()).
+ *
+ *	Staging is safe from many threads as long as each sticks to its own shard,
+ *	everything else (commit(), the counts, clearStaged()) is for one thread once
+ *	the stagers are done.
+ */
+
+#ifndef INC_STRUCTURE_BUILDER_H_
+#define INC_STRUCTURE_BUILDER_H_
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "../lazyPrints.h"
+#include "../instrument/counters.h"
+#include "ids.h"
+#include "node.h"
+#include "edge.h"
+#include "graph.h"
+
+template<class T, class E>
+class Builder
+{
+public:
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	//one shard per thread that stages at the same time
+	Builder(Graph<T, E> &graph, unsigned int shardCount);
+	Builder(const Builder&) = delete;
+	Builder& operator=(const Builder&) = delete;
+
+	/************************************************
+	 *  STAGING
+	 ***********************************************/
+	void addNode(unsigned int shard, std::shared_ptr<Node<E>> node);
+	//same as parent->addChild(edgeName, child), either end may still be staged
+	void addEdge(unsigned int shard, std::string edgeName,
+			std::shared_ptr<Node<E>> parent, std::shared_ptr<Node<E>> child);
+
+	unsigned int getShardCount() const;
+	size_t getStagedNodes() const;
+	size_t getStagedEdges() const;
+	void clearStaged();
+
+	/************************************************
+	 *  CONSOLIDATING
+	 ***********************************************/
+	/* Moves everything staged into the graph and empties the shards, threads
+	 * split the edge lists between them. Nothing is applied if an edge names a
+	 * node that is neither in the graph nor staged, or the staged nodes do not
+	 * fit the graph's byte budget.
+	 */
+	bool commit(unsigned int threads = 1);
+
+private:
+	//a line each, so stagers never write next to each other
+	struct alignas(64) Shard
+	{
+		std::vector<std::shared_ptr<Node<E>>> nodes;
+		std::vector<std::unique_ptr<Edge<E>>> edges;
+	};
+	//an edge with both ends resolved, read while the owner moves it out of its shard
+	struct Resolved
+	{
+		Edge<E> *edge;
+		Node<E> *sourceNode;
+		Node<E> *sinkNode;
+		grabIndex source;
+		grabIndex sink;
+	};
+
+	Graph<T, E> &graph;
+	std::vector<Shard> shards;
+
+	/************************************************
+	 *  HELPER FUNCTIONS
+	 ***********************************************/
+	bool validShard(unsigned int shard) const;
+	bool endsKnown() const;
+	template<class F>
+	void inThreads(unsigned int threads, F work) const;
+};
+
+/************************************************
+ *  CONSTRUCTORS/DESTRUCTORS
+ ***********************************************/
+
+template<class T, class E>
+Builder<T, E>::Builder(Graph<T, E> &graph, unsigned int shardCount) :
+		graph(graph), shards(std::max(1u, shardCount))
+{
+}
+
+/************************************************
+ *  STAGING
+ ***********************************************/
+
+template<class T, class E>
+void Builder<T, E>::addNode(unsigned int shard, std::shared_ptr<Node<E>> node)
+{
+	if (this->validShard(shard))
+		this->shards[shard].nodes.push_back(std::move(node));
+}
+
+template<class T, class E>
+void Builder<T, E>::addEdge(unsigned int shard, std::string edgeName,
+		std::shared_ptr<Node<E>> parent, std::shared_ptr<Node<E>> child)
+{
+	if (!this->validShard(shard))
+		return;
+	if (parent.get() == child.get())
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning, we are trying to add self as a child.");
+		return;
+	}
+	this->shards[shard].edges.push_back(
+			std::make_unique<Edge<E>>(edgeName, parent, child));
+}
+
+template<class T, class E>
+unsigned int Builder<T, E>::getShardCount() const
+{
+	return (unsigned int) this->shards.size();
+}
+
+template<class T, class E>
+size_t Builder<T, E>::getStagedNodes() const
+{
+	size_t staged = 0;
+	for (const Shard &shard : this->shards)
+		staged += shard.nodes.size();
+	return staged;
+}
+
+template<class T, class E>
+size_t Builder<T, E>::getStagedEdges() const
+{
+	size_t staged = 0;
+	for (const Shard &shard : this->shards)
+		staged += shard.edges.size();
+	return staged;
+}
+
+//staged edges hold their nodes, dropping them is all it takes
+template<class T, class E>
+void Builder<T, E>::clearStaged()
+{
+	for (Shard &shard : this->shards)
+	{
+		shard.edges.clear();
+		shard.nodes.clear();
+	}
+}
+
+/************************************************
+ *  CONSOLIDATING
+ ***********************************************/
+
+template<class T, class E>
+bool Builder<T, E>::commit(unsigned int threads)
+{
+	OpScope scope(InstrumentedOp::BuilderCommit);
+	if (!this->endsKnown())
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: builder names a node neither staged nor in graph ("
+						+ this->graph.getName() + "), nothing applied");
+		this->clearStaged();
+		return false;
+	}
+	std::vector<std::shared_ptr<Node<E>>> nodes;
+	nodes.reserve(this->getStagedNodes());
+	for (Shard &shard : this->shards)
+	{
+		for (std::shared_ptr<Node<E>> &node : shard.nodes)
+			nodes.push_back(std::move(node));
+		shard.nodes.clear();
+	}
+	if (!nodes.empty() && !this->graph.addNodes(nodes))
+	{
+		this->clearStaged();
+		return false;
+	}
+
+	const size_t total = this->getStagedEdges();
+	threads = std::max(1u,
+			std::min<unsigned int>(threads, (unsigned int) (total / 4096 + 1)));
+	//ends resolved up front, a shard's slots get moved out of while linking
+	std::vector<std::vector<Resolved>> resolved(this->shards.size());
+	this->inThreads(threads, [&](unsigned int t)
+	{
+		for (size_t s = t; s < this->shards.size(); s += threads)
+		{
+			resolved[s].reserve(this->shards[s].edges.size());
+			for (std::unique_ptr<Edge<E>> &edge : this->shards[s].edges)
+			{
+				Node<E> *source = edge->sourceNode.get();
+				Node<E> *sink = edge->sinkNode.get();
+				resolved[s].push_back( { edge.get(), source, sink,
+						this->graph.getNodeId(source), this->graph.getNodeId(sink) });
+			}
+		}
+	});
+
+	//thread t owns the lists of the nodes with id % threads == t
+	const grabIndex bound = this->graph.getNodeIdBound();
+	std::vector<unsigned int> extraOut(bound, 0), extraIn(bound, 0);
+	std::vector<size_t> oldDegrees(bound, 0);
+	std::vector<Node<E>*> touched(bound, nullptr);
+	this->inThreads(threads, [&](unsigned int t)
+	{
+		for (const std::vector<Resolved> &staged : resolved)
+			for (const Resolved &edge : staged)
+			{
+				if (edge.source % threads == t)
+				{
+					extraOut[edge.source]++;
+					touched[edge.source] = edge.sourceNode;
+				}
+				if (edge.sink % threads == t)
+				{
+					extraIn[edge.sink]++;
+					touched[edge.sink] = edge.sinkNode;
+				}
+			}
+		for (grabIndex id = t; id < bound; id += threads)
+		{
+			Node<E> *node = touched[id];
+			if (!node)
+				continue;
+			oldDegrees[id] = node->getDegree();
+			node->reserveEdges(extraOut[id], extraIn[id]);
+		}
+		for (size_t s = 0; s < resolved.size(); s++)
+			for (size_t e = 0; e < resolved[s].size(); e++)
+			{
+				const Resolved &edge = resolved[s][e];
+				if (edge.source % threads == t)
+					edge.sourceNode->attachOwned(
+							std::move(this->shards[s].edges[e]));
+				if (edge.sink % threads == t)
+					edge.sinkNode->attachBorrowed(edge.edge);
+			}
+	});
+	for (Shard &shard : this->shards)
+		shard.edges.clear();
+	countOp(OpCounter::EdgeInsert, total);
+
+	//watchers are not made for many threads, they hear about it one node at a time
+	for (grabIndex id = 0; id < bound; id++)
+		if (touched[id])
+			touched[id]->notifyDegree(oldDegrees[id]);
+	return true;
+}
+
+/************************************************
+ *  HELPER FUNCTIONS
+ ***********************************************/
+
+template<class T, class E>
+bool Builder<T, E>::validShard(unsigned int shard) const
+{
+	if (shard < this->shards.size())
+		return true;
+	badBehavior(__LINE__, __func__,
+			"Warning: shard " + std::to_string(shard) + " of "
+					+ std::to_string(this->shards.size()));
+	return false;
+}
+
+template<class T, class E>
+bool Builder<T, E>::endsKnown() const
+{
+	std::unordered_set<const Node<E>*> staged;
+	staged.reserve(this->getStagedNodes());
+	for (const Shard &shard : this->shards)
+		for (const std::shared_ptr<Node<E>> &node : shard.nodes)
+			staged.insert(node.get());
+	auto known = [&](const Node<E> *node)
+	{
+		return this->graph.getNodeId(node) != invalidId || staged.count(node);
+	};
+	for (const Shard &shard : this->shards)
+		for (const std::unique_ptr<Edge<E>> &edge : shard.edges)
+			if (!known(edge->sourceNode.get()) || !known(edge->sinkNode.get()))
+				return false;
+	return true;
+}
+
+//work(t) for t in [0, threads), on the calling thread when there is just one
+template<class T, class E>
+template<class F>
+void Builder<T, E>::inThreads(unsigned int threads, F work) const
+{
+	if (threads == 1)
+	{
+		work(0);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads; t++)
+		workers.emplace_back(work, t);
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+#endif /* INC_STRUCTURE_BUILDER_H_ */
@@ -0,0 +1,92 @@
+/**
+ * @file direction.h
+ * @brief Compile time edge direction policies.
+ *
+ *	The policy picks how a node keeps its edges and how we read them:
+ *
+ *		Bidirectional	edges have a direction, traversals walk them both ways
+ *						(what we always did, so it stays the default). The source
+ *						owns an edge in its out list, the sink points at it from
+ *						its in list
+ *		Directed		same lists, traversals (Snapshot rows, bfs) only follow
+ *						source -> sink
+ *		Undirected		no direction at all, a node keeps one list of links, owning
+ *						at the edge's source and borrowed at its sink. Neighbor
+ *						queries read that one list, child/parent queries are
+ *						neighbor queries and removals compact it in one pass
+ *
+ *	Pick one by specializing the trait for your tag type, same as payloads:
+ *
+ *		template<> struct EdgeDirection<Molecule>
+ *		{
+ *			typedef Undirected policy;
+ *		};
+ *
+ *	The code that cares branches on it with if constexpr, so the other policies
+ *	cost nothing at runtime.
+ */
+
+#ifndef INC_STRUCTURE_DIRECTION_H_
+#define INC_STRUCTURE_DIRECTION_H_
+
+#include <type_traits>
+
+/************************************************
+ *  POLICIES
+ ***********************************************/
+struct Bidirectional
+{
+};
+
+struct Directed
+{
+};
+
+struct Undirected
+{
+};
+
+/************************************************
+ *  TRAITS
+ ***********************************************/
+template<class T>
+struct EdgeDirection
+{
+	typedef Bidirectional policy;
+};
+
+template<class T>
+constexpr bool isUndirected()
+{
+	return std::is_same<typename EdgeDirection<T>::policy, Undirected>::value;
+}
+
+template<class T>
+constexpr bool isDirected()
+{
+	return std::is_same<typename EdgeDirection<T>::policy, Directed>::value;
+}
+
+/* Traversables (Snapshot and friends) say which way their rows point with a
+ * Direction typedef, anything without one is taken to have symmetric rows.
+ */
+template<class G, class = void>
+struct TraversalDirection
+{
+	typedef Undirected policy;
+};
+
+template<class G>
+struct TraversalDirection<G, std::void_t<typename G::Direction>>
+{
+	typedef typename G::Direction policy;
+};
+
+//every neighbor of v also lists v
+template<class G>
+constexpr bool hasSymmetricRows()
+{
+	return !std::is_same<typename TraversalDirection<G>::policy, Directed>::value;
+}
+
+#endif /* INC_STRUCTURE_DIRECTION_H_ */
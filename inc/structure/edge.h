@@ -5,15 +5,28 @@
 #include <vector>
 
 #include "../lazyPrints.h"
+#include "../instrument/counters.h"
+#include "../instrument/footprint.h"
+#include "ids.h"
 
 template<class T> class Node;
 template<class T, class E> class Graph;
 
-const bool edgeDebug = true;
+//can be overridden before including, see node.h
+#ifndef GRAB_EDGE_DEBUG
+#define GRAB_EDGE_DEBUG true
+#endif
+const bool edgeDebug = GRAB_EDGE_DEBUG;
 
 template<class T>
 class Edge
 {
+	//nodes, graphs, snapshots, batches and builders read our endpoints without the shared_ptr copies
+	friend class Node<T>;
+	template<class G, class N> friend class Graph;
+	template<class G, class N> friend class Snapshot;
+	template<class G, class N> friend class Batch;
+	template<class G, class N> friend class Builder;
 public:
 	/************************************************
 	 *  CONSTRUCTORS/DESTRUCTORS
@@ -28,8 +41,9 @@ public:
 	/************************************************
 	 *  GETTER/SETTER PAIRS
 	 ***********************************************/
-	void setIndex(unsigned short int index);
-	unsigned short int getIndex() const;
+	//dense id stamped by the first graph that numbers us, invalidId until then
+	void setIndex(grabIndex index);
+	grabIndex getIndex() const;
 
 	void setName(std::string name);
 	std::string getName() const;
@@ -62,6 +76,11 @@ public:
 	void addLabel(std::string label);
 	void addLabel(std::vector<std::string> labels);
 
+	/************************************************
+	 *  HELPING FUNCTIONS
+	 ***********************************************/
+	void addFootprint(Footprint &footprint) const;
+
 	/* BELOW ARE FUNCTIONS THAT HAVE BEEN REMOVED BUT MAY BE ADDED AGAIN
 	 *
 	 */
@@ -70,20 +89,23 @@ private:
 	/************************************************
 	 *  IDENTIFIERS
 	 ***********************************************/
-	unsigned short int index;
-	std::string name;
-	std::vector<std::string> labels;
+	grabIndex index;
 
 	/************************************************
 	 *  STRUCTURAL ATTRIBUTES
 	 ***********************************************/
-	bool bridge;
-	bool leaf; //probably not needed but can remove later
+	//packed next to index, together they fill one word
+	bool bridge :1;
+	bool leaf :1; //probably not needed but can remove later
 
 	/************************************************
 	 *  ALGORITHM TRAVERSAL ATTRIBUTES
 	 ***********************************************/
-	bool visited;
+	bool visited :1;
+
+	//rest of our identifiers, after the flags so nothing pads index
+	std::string name;
+	std::vector<std::string> labels;
 
 	/************************************************
 	 *  STRUCTURAL OWNERSHIP
@@ -109,7 +131,7 @@ template<class T>
 Edge<T>::Edge()
 {
 	this->setName("DEFAULT_EDGE_NAME");
-	this->setIndex(1);
+	this->setIndex(invalidId);
 	this->setIsBridge(false);
 	this->setIsLeaf(false);
 	this->setIsVisited(false);
@@ -126,7 +148,7 @@ Edge<T>::Edge(std::string name, std::shared_ptr<Node<T> > sourceNode,
 		std::shared_ptr<Node<T> > sinkNode)
 {
 	this->setName(name);
-	this->setIndex(1);
+	this->setIndex(invalidId);
 	this->setIsBridge(false);
 	this->setIsVisited(false);
 	this->setSourceNode(sourceNode);
@@ -158,13 +180,13 @@ Edge<T>::~Edge()
  ***********************************************/
 
 template<class T>
-void Edge<T>::setIndex(unsigned short int index)
+void Edge<T>::setIndex(grabIndex index)
 {
 	this->index = index;
 }
 
 template<class T>
-unsigned short int Edge<T>::getIndex() const
+grabIndex Edge<T>::getIndex() const
 {
 	return index;
 }
@@ -238,6 +260,7 @@ void Edge<T>::setSourceNode(std::shared_ptr<Node<T> > freshSource)
 template<class T>
 std::shared_ptr<Node<T> > Edge<T>::getSourceNode()
 {
+	countOp(OpCounter::RefcountAccess);
 	return this->sourceNode;
 }
 
@@ -250,6 +273,7 @@ void Edge<T>::setSinkNode(std::shared_ptr<Node<T> > freshSink)
 template<class T>
 std::shared_ptr<Node<T> > Edge<T>::getSinkNode()
 {
+	countOp(OpCounter::RefcountAccess);
 	return this->sinkNode;
 }
 
@@ -270,4 +294,17 @@ void Edge<T>::addLabel(std::vector<std::string> labels)
 		this->addLabel(currLabel);
 }
 
+/************************************************
+ *  HELPING FUNCTIONS
+ ***********************************************/
+
+template<class T>
+void Edge<T>::addFootprint(Footprint &footprint) const
+{
+	footprint.edgeCount++;
+	footprint.edgeBytes += sizeof(Edge<T> );
+	footprint.nameBytes += stringHeapBytes(this->name);
+	addLabelBytes(this->labels, footprint);
+}
+
 #endif /* INC_STRUCTURE_EDGE_H_ */
@@ -11,18 +11,43 @@
 #ifndef INC_STRUCTURE_GRAPH_H_
 #define INC_STRUCTURE_GRAPH_H_
 
+#include <atomic>
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "../lazyPrints.h"
+#include "../instrument/counters.h"
+#include "../instrument/footprint.h"
+#include "ids.h"
+#include "node.h"
+#include "edge.h"
+#include "payload.h"
 
-const bool graphDebug = true;
+//can be overridden before including, see node.h
+#ifndef GRAB_GRAPH_DEBUG
+#define GRAB_GRAPH_DEBUG true
+#endif
+const bool graphDebug = GRAB_GRAPH_DEBUG;
+
+//a hash node in our containing set: the shared_ptr, next pointer and cached hash
+const size_t containingEntryBytes = sizeof(std::shared_ptr<void>)
+		+ sizeof(void*) + sizeof(size_t);
+
+//every graph gets its own number, tells them apart in logs and side tables
+inline grabIndex nextGraphIndex()
+{
+	static std::atomic<grabIndex> next(0);
+	return next++;
+}
 
 template<class E> class Node;
+template<class E> class Edge;
 
 template<class T, class E>
-class Graph
+class Graph: private NodeWatcher<E>
 {
 public:
 	/************************************************
@@ -30,14 +55,17 @@ public:
 	 ***********************************************/
 	Graph();
 	Graph(std::string name);
+	//our nodes hold on to this as their watcher, a copy would go unnoticed
+	Graph(const Graph&) = delete;
+	Graph& operator=(const Graph&) = delete;
 
 	~Graph();
 
 	/************************************************
 	 *  GETTER/SETTER PAIRS
 	 ***********************************************/
-	void setIndex(unsigned short int index);
-	unsigned short int getIndex() const;
+	void setIndex(grabIndex index);
+	grabIndex getIndex() const;
 
 	void setName(std::string name);
 	std::string getName() const;
@@ -47,22 +75,122 @@ public:
 
 	std::vector<std::weak_ptr<Node<E>>> getNodes();
 
+	//0 means no budget, otherwise adding nodes that would push us past it fails
+	void setByteBudget(size_t byteBudget);
+	size_t getByteBudget() const;
+
 	/************************************************
 	 *  MUTATORS
 	 ***********************************************/
 	void addLabel(std::string label);
 	void addLabel(std::vector<std::string> labels);
 
-	void addNode(std::shared_ptr<Node<E>> nodeToAdd);
+	bool addNode(std::shared_ptr<Node<E>> nodeToAdd);
+	//all or nothing, the whole batch is checked against our budget before anything is added
+	bool addNodes(std::vector<std::shared_ptr<Node<E>>> nodesToAdd);
 
 	void deleteEdges(std::shared_ptr<Node<E>> node);
 	void removeNode(std::shared_ptr<Node<E>> node);
+	/* Unlike removeNode() this also breaks every edge touching the nodes, all in one
+	 * pass, so they are freed as soon as the caller lets go of them.
+	 */
+	void removeNodes(std::vector<std::shared_ptr<Node<E>>> nodesToRemove);
 
 	/************************************************
 	 *  STRUCTURAL/RELATIONSHIP CHECKS/CHANGES/GETS
 	 ***********************************************/
 	bool containsNode(std::shared_ptr<Node<E>> possiblenode);
 
+	/************************************************
+	 *  HELPING FUNCTIONS
+	 ***********************************************/
+	//walks every node and owned edge, also resyncs the tally our budget checks use
+	Footprint getFootprint();
+
+	/************************************************
+	 *  DENSE IDS AND PAYLOADS
+	 ***********************************************/
+	/* Every node we contain gets a dense id when added, freed ids are reused. Edges
+	 * between our nodes get one the first time they are asked for (or on
+	 * syncEdgeIds()). Side arrays indexed by these need getNodeIdBound() and
+	 * getEdgeIdBound() slots.
+	 *
+	 * The id is stamped on the node/edge (getIndex()) so looking it up is an array
+	 * check, only something another graph numbered first goes through our maps.
+	 */
+	typedef typename NodePayload<E>::columns NodeColumns;
+	typedef typename EdgePayload<E>::columns EdgeColumns;
+
+	grabIndex getNodeId(const Node<E> *node) const;
+	std::shared_ptr<Node<E>> getNodeById(grabIndex id) const;
+	bool isNodeIdLive(grabIndex id) const;
+	grabIndex getNodeIdBound() const;
+
+	grabIndex getEdgeId(Edge<E> *edge);
+	/* nullptr unless the edge is still linked between the ends it was numbered
+	 * with, edges deleted through Node keep their id until syncEdgeIds() but are
+	 * never handed out. Scans the source's out edges to make sure.
+	 */
+	Edge<E>* getEdgeById(grabIndex id) const;
+	grabIndex getEdgeIdBound() const;
+	//forget ids of edges that are gone, give one to every edge between our nodes
+	void syncEdgeIds();
+	/* Node order[i] (a current id) gets id i, order lists every live id once.
+	 * Free ids go away and edges are renumbered by their new source, payload
+	 * rows and the indexes move along. Ids handed out before (snapshots, views,
+	 * ring trackers, stores) are stale afterwards. algo/order.h has orders that
+	 * put neighbors close together.
+	 */
+	bool renumberNodes(const std::vector<grabIndex> &order);
+
+	NodeColumns& getNodePayload();
+	EdgeColumns& getEdgePayload();
+
+	//ids of our live nodes/edges whose payload row passes the predicate, see selectRows()
+	template<class Predicate>
+	std::vector<grabIndex> selectNodes(Predicate predicate) const;
+	template<class Predicate>
+	std::vector<grabIndex> selectEdges(Predicate predicate) const;
+
+	/************************************************
+	 *  NAME AND LABEL LOOKUP
+	 ***********************************************/
+	/* Hash indexes over our nodes' names and labels, kept current on add/remove
+	 * and by our nodes telling us about setName()/setLabels()/addLabel() (see
+	 * NodeWatcher), so nothing here scans.
+	 */
+	//our node named name with the lowest id, nullptr if there is none
+	std::shared_ptr<Node<E>> getNodeByName(std::string name) const;
+	//ids of every node of ours named name, ascending
+	std::vector<grabIndex> selectNodesByName(std::string name) const;
+	//ids of our nodes carrying label, ascending
+	std::vector<grabIndex> selectNodesByLabel(std::string label) const;
+	//how many of our nodes carry label, i.e. to seed a match with the rarest one
+	size_t countNodesByLabel(std::string label) const;
+	//how many of our nodes have each degree (see Node::getDegree()), kept current the same way
+	const std::vector<grabIndex>& getDegreeCounts() const;
+
+	/************************************************
+	 *  CLONES
+	 ***********************************************/
+	/* Both keep our ids, payloads and indexes as they are and only copy what is
+	 * between our nodes, edges leaving the graph are not part of a clone. Same as
+	 * after addNode(), a copy nothing else holds (no edges, no handle) is dropped
+	 * on the clone's next refresh.
+	 */
+	//fresh copies of every node and edge, one pass
+	std::unique_ptr<Graph<T, E>> clone(std::string name);
+	/* Copy on write: the clone holds our very nodes until ownNode() asks for one,
+	 * then the whole fragment (connected component) that node is in gets copied,
+	 * the other fragments stay shared. Edits through the shared nodes show up in
+	 * both graphs, so edit only what ownNode() hands back and own both ends
+	 * before linking two nodes.
+	 */
+	std::unique_ptr<Graph<T, E>> shareClone(std::string name);
+	//our private copy of node, node itself if it was never shared
+	std::shared_ptr<Node<E>> ownNode(std::shared_ptr<Node<E>> node);
+	bool isShared(std::shared_ptr<Node<E>> node) const;
+
 	/* BELOW ARE FUNCTIONS THAT HAVE BEEN REMOVED BUT MAY BE ADDED AGAIN
 	 *
 	 */
@@ -71,7 +199,7 @@ private:
 	/************************************************
 	 *  IDENTIFIERS
 	 ***********************************************/
-	unsigned short int index;
+	grabIndex index;
 	std::string name;
 	std::vector<std::string> labels;
 
@@ -80,6 +208,42 @@ private:
 	 ***********************************************/
 	std::unordered_set<std::shared_ptr<Node<E>>> containingNodes;
 
+	/************************************************
+	 *  MEMORY ACCOUNTING
+	 ***********************************************/
+	size_t byteBudget = 0;
+	size_t accountedBytes = 0; //exact after getFootprint(), grows with each add in between
+
+	/************************************************
+	 *  DENSE IDS AND PAYLOADS
+	 ***********************************************/
+	//only nodes/edges that were already stamped by another graph
+	std::unordered_map<const Node<E>*, grabIndex> nodeIds;
+	std::vector<Node<E>*> nodesById; //nullptr for free ids
+	std::vector<unsigned char> liveNodes;
+	std::vector<grabIndex> freeNodeIds;
+	NodeColumns nodeColumns;
+
+	std::unordered_map<const Edge<E>*, grabIndex> edgeIds;
+	std::vector<Edge<E>*> edgesById;
+	//endpoint ids at assignment, tells a recycled edge address from the edge we knew
+	std::vector<std::pair<grabIndex, grabIndex>> edgeEnds;
+	std::vector<unsigned char> liveEdges;
+	std::vector<grabIndex> freeEdgeIds;
+	EdgeColumns edgeColumns;
+
+	/************************************************
+	 *  NAME AND LABEL INDEXES
+	 ***********************************************/
+	//keyed by the name's hash, the name itself is only kept on the node
+	std::unordered_multimap<size_t, grabIndex> nameIndex;
+	std::unordered_map<std::string, std::unordered_set<grabIndex>> labelIndex;
+	//trailing zeros trimmed, so the last entry is our highest degree
+	std::vector<grabIndex> degreeCounts;
+
+	//per node id, 1 while a share clone still holds the node of the graph it came from
+	std::vector<unsigned char> sharedNodes;
+
 	/************************************************
 	 *  HELPER FUNCTIONS
 	 ***********************************************/
@@ -90,6 +254,39 @@ private:
 	 * Eventually, our node destructor will take care of deleting self from this list.
 	 */
 	void refreshContaining();
+
+	//drops every edge with an end in nodes, compacting the lists of their other ends
+	void breakEdges(const std::unordered_set<Node<E>*> &nodes);
+	//tears down what nobody outside of us and our nodes' edges can reach anymore
+	void collectUnreachable();
+
+	size_t nodeBytes(std::shared_ptr<Node<E>> node) const;
+	bool fitsBudget(size_t extraBytes) const;
+
+	void assignNodeId(Node<E> *node);
+	void releaseNodeId(Node<E> *node);
+	grabIndex assignEdgeId(Edge<E> *edge, grabIndex sourceId, grabIndex sinkId);
+	void releaseEdgeId(grabIndex id);
+	//stops watching our nodes and hands our stamps back so the next graph to number them can use the fast path
+	void detachNodes();
+
+	void indexNode(grabIndex id, const Node<E> *node);
+	void unindexNode(grabIndex id, const Node<E> *node);
+	void unindexName(grabIndex id, const std::string &name);
+	void unindexLabel(grabIndex id, const std::string &label);
+	void countDegree(size_t degree);
+	void uncountDegree(size_t degree);
+
+	//everything but the nodes themselves, into's nodesById ends up pointing at ours
+	void copyTables(Graph<T, E> &into) const;
+	//swaps the nodes with these ascending ids (and the edges between them) for fresh copies
+	void copyNodes(const std::vector<grabIndex> &ids);
+
+	void nodeRenamed(Node<E> *node, const std::string &oldName) override;
+	void labelAdded(Node<E> *node, const std::string &label) override;
+	void labelsReplaced(Node<E> *node,
+			const std::vector<std::string> &oldLabels) override;
+	void degreeChanged(Node<E> *node, size_t oldDegree) override;
 };
 
 /************************************************
@@ -100,7 +297,7 @@ template<class T, class E>
 Graph<T, E>::Graph()
 {
 	this->setName("DEFAULT_GRAPH_NAME");
-	this->setIndex(1);
+	this->setIndex(nextGraphIndex());
 	if (graphDebug)
 	{
 		std::string conMsg = "Warning, created a graph with the default name";
@@ -112,7 +309,7 @@ template<class T, class E>
 Graph<T, E>::Graph(std::string name)
 {
 	this->setName(name);
-	this->setIndex(1);
+	this->setIndex(nextGraphIndex());
 	if (graphDebug)
 	{
 		std::string conMsg = "Constructed graph with name: " + this->getName();
@@ -129,6 +326,9 @@ Graph<T, E>::~Graph()
 		std::string desMsg = "Deleting graph with name of: " + this->getName();
 		lazyInfo(__LINE__, __func__, desMsg);
 	}
+	this->detachNodes();
+	//nodes in a ring keep each other alive through their edges, we may be the last way to them
+	this->collectUnreachable();
 }
 
 /************************************************
@@ -136,13 +336,13 @@ Graph<T, E>::~Graph()
  ***********************************************/
 
 template<class T, class E>
-void Graph<T, E>::setIndex(unsigned short int index)
+void Graph<T, E>::setIndex(grabIndex index)
 {
 	this->index = index;
 }
 
 template<class T, class E>
-unsigned short int Graph<T, E>::getIndex() const
+grabIndex Graph<T, E>::getIndex() const
 {
 	return this->index;
 }
@@ -174,6 +374,7 @@ std::vector<std::string> Graph<T, E>::getLabels() const
 template<class T, class E>
 std::vector<std::weak_ptr<Node<E> > > Graph<T, E>::getNodes()
 {
+	OpScope scope(InstrumentedOp::GraphGetNodes);
 	this->refreshContaining();
 	std::vector<std::weak_ptr<Node<E>>> nodes;
 	nodes.insert(nodes.end(), this->containingNodes.begin(),
@@ -181,6 +382,18 @@ std::vector<std::weak_ptr<Node<E> > > Graph<T, E>::getNodes()
 	return nodes;
 }
 
+template<class T, class E>
+void Graph<T, E>::setByteBudget(size_t byteBudget)
+{
+	this->byteBudget = byteBudget;
+}
+
+template<class T, class E>
+size_t Graph<T, E>::getByteBudget() const
+{
+	return this->byteBudget;
+}
+
 /************************************************
  *  MUTATORS
  ***********************************************/
@@ -199,24 +412,80 @@ void Graph<T, E>::addLabel(std::vector<std::string> labels)
 }
 
 template<class T, class E>
-void Graph<T, E>::addNode(std::shared_ptr<Node<E> > nodeToAdd)
+bool Graph<T, E>::addNode(std::shared_ptr<Node<E> > nodeToAdd)
 {
+	OpScope scope(InstrumentedOp::GraphAddNode);
 	this->refreshContaining();
 	if (this->containsNode(nodeToAdd))
 	{
 		badBehavior(__LINE__, __func__, "Warning: node already present");
+		return false;
 	}
-	else
+	size_t addedBytes = this->nodeBytes(nodeToAdd);
+	if (!this->fitsBudget(addedBytes))
+	{
+		std::string badMsg = "Warning: adding node (" + nodeToAdd.get()->getName()
+				+ ") would exceed the byte budget of graph (" + this->getName()
+				+ ")";
+		badBehavior(__LINE__, __func__, badMsg);
+		return false;
+	}
+	//How does our node know of our graph
+	this->containingNodes.insert(nodeToAdd);
+	this->assignNodeId(nodeToAdd.get());
+	this->accountedBytes += addedBytes;
+	return true;
+}
+
+template<class T, class E>
+bool Graph<T, E>::addNodes(std::vector<std::shared_ptr<Node<E> > > nodesToAdd)
+{
+	OpScope scope(InstrumentedOp::GraphAddNode);
+	this->refreshContaining();
+	std::unordered_set<Node<E>*> batch;
+	std::vector<std::shared_ptr<Node<E>>> fresh;
+	size_t addedBytes = 0;
+	for (std::shared_ptr<Node<E>> &node : nodesToAdd)
+	{
+		if (this->containsNode(node) || !batch.insert(node.get()).second)
+			continue;
+		fresh.push_back(node);
+		if (this->byteBudget)
+			addedBytes += this->nodeBytes(node);
+	}
+	if (this->byteBudget)
+	{
+		//fail fast on the exact numbers instead of our running tally
+		this->accountedBytes = this->getFootprint().total();
+		if (!this->fitsBudget(addedBytes))
+		{
+			std::string badMsg = "Warning: batch of "
+					+ std::to_string(fresh.size()) + " nodes ("
+					+ std::to_string(addedBytes)
+					+ " bytes) would exceed the byte budget of graph ("
+					+ this->getName() + ")";
+			badBehavior(__LINE__, __func__, badMsg);
+			return false;
+		}
+	}
+	if (fresh.size() != nodesToAdd.size())
+		badBehavior(__LINE__, __func__,
+				"Warning: skipped nodes already present in batch or graph");
+	this->containingNodes.reserve(this->containingNodes.size() + fresh.size());
+	for (std::shared_ptr<Node<E>> &node : fresh)
 	{
-		//How does our node know of our graph
-		this->containingNodes.insert(nodeToAdd);
+		this->containingNodes.insert(node);
+		this->assignNodeId(node.get());
 	}
+	this->accountedBytes += addedBytes;
+	return true;
 }
 
 // Deletes all edges to and from the node, yet keeps the node in the graph
 template<class T, class E>
 void Graph<T, E>::deleteEdges(std::shared_ptr<Node<E> > node)
 {
+	OpScope scope(InstrumentedOp::GraphDeleteEdges);
 //eventually call in our value to pass in the hash of the graph, as of now just delete all our edges of the node and also make sure it be a part of the graph
 	this->refreshContaining();
 	if (this->containsNode(node))
@@ -234,6 +503,7 @@ void Graph<T, E>::deleteEdges(std::shared_ptr<Node<E> > node)
 template<class T, class E>
 void Graph<T, E>::removeNode(std::shared_ptr<Node<E> > node)
 {
+	OpScope scope(InstrumentedOp::GraphRemoveNode);
 	this->refreshContaining();
 	if (this->containsNode(node))
 	{
@@ -243,6 +513,9 @@ void Graph<T, E>::removeNode(std::shared_ptr<Node<E> > node)
 					+ ") from graph (" + this->getName() + ")";
 			lazyInfo(__LINE__, __func__, remMsg);
 		}
+		size_t removedBytes = this->nodeBytes(node);
+		this->accountedBytes -= std::min(this->accountedBytes, removedBytes);
+		this->releaseNodeId(node.get());
 		this->containingNodes.erase(node);
 	}
 	else
@@ -253,6 +526,37 @@ void Graph<T, E>::removeNode(std::shared_ptr<Node<E> > node)
 	}
 }
 
+template<class T, class E>
+void Graph<T, E>::removeNodes(
+		std::vector<std::shared_ptr<Node<E> > > nodesToRemove)
+{
+	OpScope scope(InstrumentedOp::GraphRemoveNode);
+	this->refreshContaining();
+	std::unordered_set<Node<E>*> removing;
+	for (std::shared_ptr<Node<E>> &node : nodesToRemove)
+	{
+		if (!this->containsNode(node))
+		{
+			badBehavior(__LINE__, __func__,
+					"Warning: node not present in graph (" + this->getName()
+							+ ")");
+			continue;
+		}
+		if (!removing.insert(node.get()).second)
+			continue;
+		size_t removedBytes = this->nodeBytes(node);
+		this->accountedBytes -= std::min(this->accountedBytes, removedBytes);
+		this->releaseNodeId(node.get());
+	}
+	if (graphDebug)
+		lazyInfo(__LINE__, __func__,
+				"Removing " + std::to_string(removing.size())
+						+ " nodes from graph (" + this->getName() + ")");
+	this->breakEdges(removing);
+	for (std::shared_ptr<Node<E>> &node : nodesToRemove)
+		this->containingNodes.erase(node);
+}
+
 /************************************************
  *  STRUCTURAL/RELATIONSHIP CHECKS/CHANGES/GETS
  ***********************************************/
@@ -262,6 +566,407 @@ bool Graph<T, E>::containsNode(std::shared_ptr<Node<E> > possiblenode)
 	return this->containingNodes.count(possiblenode);
 }
 
+/************************************************
+ *  HELPING FUNCTIONS
+ ***********************************************/
+template<class T, class E>
+Footprint Graph<T, E>::getFootprint()
+{
+	this->refreshContaining();
+	Footprint footprint;
+	for (std::shared_ptr<Node<E>> const &node : this->containingNodes)
+		node.get()->addFootprint(footprint);
+	footprint.containerBytes += sizeof(Graph<T, E> )
+			+ this->containingNodes.bucket_count() * sizeof(void*)
+			+ this->containingNodes.size() * containingEntryBytes
+			+ stringHeapBytes(this->name);
+	//id maps cost about what the containing set does per entry
+	footprint.containerBytes += this->nodeIds.bucket_count() * sizeof(void*)
+			+ this->nodeIds.size() * containingEntryBytes
+			+ this->edgeIds.bucket_count() * sizeof(void*)
+			+ this->edgeIds.size() * containingEntryBytes;
+	footprint.containerBytes += this->nameIndex.bucket_count() * sizeof(void*)
+			+ this->labelIndex.bucket_count() * sizeof(void*);
+	footprint.containerBytes += this->nameIndex.size()
+			* (sizeof(void*) + sizeof(std::pair<size_t, grabIndex>));
+	addVectorBytes(this->degreeCounts, footprint.containerBytes,
+			footprint.slackBytes);
+	for (auto const &entry : this->labelIndex)
+		footprint.containerBytes += containingEntryBytes + sizeof(entry)
+				+ stringHeapBytes(entry.first)
+				+ entry.second.bucket_count() * sizeof(void*)
+				+ entry.second.size() * (sizeof(void*) + sizeof(grabIndex));
+	addVectorBytes(this->nodesById, footprint.containerBytes,
+			footprint.slackBytes);
+	addVectorBytes(this->liveNodes, footprint.containerBytes,
+			footprint.slackBytes);
+	addVectorBytes(this->freeNodeIds, footprint.containerBytes,
+			footprint.slackBytes);
+	addVectorBytes(this->edgesById, footprint.containerBytes,
+			footprint.slackBytes);
+	addVectorBytes(this->edgeEnds, footprint.containerBytes,
+			footprint.slackBytes);
+	addVectorBytes(this->liveEdges, footprint.containerBytes,
+			footprint.slackBytes);
+	addVectorBytes(this->freeEdgeIds, footprint.containerBytes,
+			footprint.slackBytes);
+	this->nodeColumns.addFootprint(footprint);
+	this->edgeColumns.addFootprint(footprint);
+	addLabelBytes(this->labels, footprint);
+	this->accountedBytes = footprint.total();
+	return footprint;
+}
+
+/************************************************
+ *  DENSE IDS AND PAYLOADS
+ ***********************************************/
+template<class T, class E>
+grabIndex Graph<T, E>::getNodeId(const Node<E> *node) const
+{
+	grabIndex id = node->getIndex();
+	if (id < this->nodesById.size() && this->nodesById[id] == node)
+		return id;
+	if (this->nodeIds.empty())
+		return invalidId;
+	auto found = this->nodeIds.find(node);
+	return (found == this->nodeIds.end()) ? invalidId : found->second;
+}
+
+template<class T, class E>
+std::shared_ptr<Node<E> > Graph<T, E>::getNodeById(grabIndex id) const
+{
+	if (id >= this->nodesById.size() || !this->nodesById[id])
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: no node with id " + std::to_string(id));
+		return nullptr;
+	}
+	return this->nodesById[id]->shared_from_this();
+}
+
+template<class T, class E>
+bool Graph<T, E>::isNodeIdLive(grabIndex id) const
+{
+	return id < this->liveNodes.size() && this->liveNodes[id];
+}
+
+template<class T, class E>
+grabIndex Graph<T, E>::getNodeIdBound() const
+{
+	return (grabIndex) this->nodesById.size();
+}
+
+template<class T, class E>
+grabIndex Graph<T, E>::getEdgeId(Edge<E> *edge)
+{
+	grabIndex sourceId = this->getNodeId(edge->getSourceNode().get());
+	grabIndex sinkId = this->getNodeId(edge->getSinkNode().get());
+	if (sourceId == invalidId || sinkId == invalidId)
+	{
+		std::string badMsg = "Warning: edge (" + edge->getName()
+				+ ") does not connect two nodes of graph (" + this->getName()
+				+ ")";
+		badBehavior(__LINE__, __func__, badMsg);
+		return invalidId;
+	}
+	return this->assignEdgeId(edge, sourceId, sinkId);
+}
+
+//only compares addresses until the edge is found, a deleted one is never touched
+template<class T, class E>
+Edge<E>* Graph<T, E>::getEdgeById(grabIndex id) const
+{
+	if (id >= this->edgesById.size() || !this->liveEdges[id])
+		return nullptr;
+	Edge<E> *edge = this->edgesById[id];
+	Node<E> *source = this->nodesById[this->edgeEnds[id].first];
+	if (!source)
+		return nullptr;
+	if (!source->ownsEdge(edge))
+		return nullptr;
+	//a new edge at a recycled address only counts if it has the same ends
+	return (this->getNodeId(edge->sinkNode.get()) == this->edgeEnds[id].second) ?
+			edge : nullptr;
+}
+
+template<class T, class E>
+grabIndex Graph<T, E>::getEdgeIdBound() const
+{
+	return (grabIndex) this->edgesById.size();
+}
+
+template<class T, class E>
+void Graph<T, E>::syncEdgeIds()
+{
+	PhaseTimer timer("syncEdgeIds");
+	this->refreshContaining();
+	std::vector<unsigned char> seen(this->edgesById.size(), 0);
+	for (grabIndex sourceId = 0; sourceId < this->nodesById.size(); sourceId++)
+	{
+		Node<E> *node = this->nodesById[sourceId];
+		if (!node)
+			continue;
+		node->forEachOwnedEdge([&](Edge<E> *outEdge)
+		{
+			grabIndex sinkId = this->getNodeId(outEdge->sinkNode.get());
+			if (sinkId == invalidId)
+				return;
+			grabIndex id = this->assignEdgeId(outEdge, sourceId, sinkId);
+			if (id >= seen.size())
+				seen.resize(id + 1, 0);
+			seen[id] = 1;
+		});
+	}
+	for (grabIndex id = 0; id < this->edgesById.size(); id++)
+	{
+		if (this->liveEdges[id] && (id >= seen.size() || !seen[id]))
+			this->releaseEdgeId(id);
+	}
+}
+
+//stamps we own are rewritten, anything another graph stamped first is in our maps
+template<class T, class E>
+bool Graph<T, E>::renumberNodes(const std::vector<grabIndex> &order)
+{
+	PhaseTimer timer("renumberNodes");
+	this->syncEdgeIds();
+	const grabIndex bound = (grabIndex) this->nodesById.size();
+	std::vector<grabIndex> newIds(bound, invalidId);
+	for (grabIndex i = 0; i < order.size(); i++)
+	{
+		grabIndex id = order[i];
+		if (id >= bound || !this->nodesById[id] || newIds[id] != invalidId)
+		{
+			badBehavior(__LINE__, __func__,
+					"Warning: order names id " + std::to_string(id)
+							+ " that is not live or named twice, graph ("
+							+ this->getName() + ") left as is");
+			return false;
+		}
+		newIds[id] = i;
+	}
+	if (order.size() != this->containingNodes.size())
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: order misses live nodes of graph (" + this->getName()
+						+ "), left as is");
+		return false;
+	}
+
+	//edges in the order of their new source, each list as it is
+	std::vector<grabIndex> edgeOrder;
+	edgeOrder.reserve(this->edgesById.size() - this->freeEdgeIds.size());
+	for (grabIndex id : order)
+		this->nodesById[id]->forEachOwnedEdge([&](Edge<E> *outEdge)
+		{
+			grabIndex sinkId = this->getNodeId(outEdge->sinkNode.get());
+			if (sinkId != invalidId)
+				edgeOrder.push_back(this->assignEdgeId(outEdge, id, sinkId));
+		});
+
+	std::vector<Node<E>*> nodes(order.size());
+	std::vector<unsigned char> shared(
+			this->sharedNodes.empty() ? 0 : order.size(), 0);
+	for (grabIndex i = 0; i < order.size(); i++)
+	{
+		nodes[i] = this->nodesById[order[i]];
+		auto found = this->nodeIds.find(nodes[i]);
+		if (found != this->nodeIds.end())
+			found->second = i;
+		else
+			nodes[i]->setIndex(i);
+		if (!shared.empty() && order[i] < this->sharedNodes.size())
+			shared[i] = this->sharedNodes[order[i]];
+	}
+	this->nodesById.swap(nodes);
+	this->liveNodes.assign(order.size(), 1);
+	this->freeNodeIds.clear();
+	this->sharedNodes.swap(shared);
+	this->nodeColumns.permuteRows(order);
+	this->nameIndex.clear();
+	this->labelIndex.clear();
+	for (grabIndex i = 0; i < order.size(); i++)
+		this->indexNode(i, this->nodesById[i]);
+
+	std::vector<Edge<E>*> edges(edgeOrder.size());
+	std::vector<std::pair<grabIndex, grabIndex>> ends(edgeOrder.size());
+	for (grabIndex i = 0; i < edgeOrder.size(); i++)
+	{
+		grabIndex id = edgeOrder[i];
+		edges[i] = this->edgesById[id];
+		ends[i] = std::make_pair(newIds[this->edgeEnds[id].first],
+				newIds[this->edgeEnds[id].second]);
+		auto found = this->edgeIds.find(edges[i]);
+		if (found != this->edgeIds.end())
+			found->second = i;
+		else
+			edges[i]->setIndex(i);
+	}
+	this->edgesById.swap(edges);
+	this->edgeEnds.swap(ends);
+	this->liveEdges.assign(edgeOrder.size(), 1);
+	this->freeEdgeIds.clear();
+	this->edgeColumns.permuteRows(edgeOrder);
+	return true;
+}
+
+template<class T, class E>
+typename Graph<T, E>::NodeColumns& Graph<T, E>::getNodePayload()
+{
+	return this->nodeColumns;
+}
+
+template<class T, class E>
+typename Graph<T, E>::EdgeColumns& Graph<T, E>::getEdgePayload()
+{
+	return this->edgeColumns;
+}
+
+template<class T, class E>
+template<class Predicate>
+std::vector<grabIndex> Graph<T, E>::selectNodes(Predicate predicate) const
+{
+	return selectRows(this->liveNodes, predicate);
+}
+
+template<class T, class E>
+template<class Predicate>
+std::vector<grabIndex> Graph<T, E>::selectEdges(Predicate predicate) const
+{
+	return selectRows(this->liveEdges, predicate);
+}
+
+template<class T, class E>
+std::shared_ptr<Node<E> > Graph<T, E>::getNodeByName(std::string name) const
+{
+	std::vector<grabIndex> named = this->selectNodesByName(name);
+	return named.empty() ? nullptr : this->nodesById[named[0]]->shared_from_this();
+}
+
+template<class T, class E>
+std::vector<grabIndex> Graph<T, E>::selectNodesByName(std::string name) const
+{
+	std::vector<grabIndex> selected;
+	auto range = this->nameIndex.equal_range(std::hash<std::string>()(name));
+	for (auto entry = range.first; entry != range.second; entry++)
+		if (this->nodesById[entry->second]->name == name)
+			selected.push_back(entry->second);
+	std::sort(selected.begin(), selected.end());
+	return selected;
+}
+
+template<class T, class E>
+std::vector<grabIndex> Graph<T, E>::selectNodesByLabel(
+		std::string label) const
+{
+	auto found = this->labelIndex.find(label);
+	if (found == this->labelIndex.end())
+		return std::vector<grabIndex>();
+	std::vector<grabIndex> selected(found->second.begin(), found->second.end());
+	std::sort(selected.begin(), selected.end());
+	return selected;
+}
+
+template<class T, class E>
+size_t Graph<T, E>::countNodesByLabel(std::string label) const
+{
+	auto found = this->labelIndex.find(label);
+	return (found == this->labelIndex.end()) ? 0 : found->second.size();
+}
+
+template<class T, class E>
+const std::vector<grabIndex>& Graph<T, E>::getDegreeCounts() const
+{
+	return this->degreeCounts;
+}
+
+/************************************************
+ *  CLONES
+ ***********************************************/
+
+template<class T, class E>
+std::unique_ptr<Graph<T, E>> Graph<T, E>::clone(std::string name)
+{
+	PhaseTimer timer("clone");
+	this->syncEdgeIds();
+	std::unique_ptr<Graph<T, E>> copy(new Graph<T, E>(name));
+	this->copyTables(*copy);
+	std::vector<grabIndex> ids;
+	ids.reserve(this->containingNodes.size());
+	for (grabIndex id = 0; id < this->nodesById.size(); id++)
+		if (this->nodesById[id])
+			ids.push_back(id);
+	copy->containingNodes.reserve(ids.size());
+	copy->copyNodes(ids);
+	return copy;
+}
+
+template<class T, class E>
+std::unique_ptr<Graph<T, E>> Graph<T, E>::shareClone(std::string name)
+{
+	PhaseTimer timer("shareClone");
+	this->syncEdgeIds();
+	std::unique_ptr<Graph<T, E>> copy(new Graph<T, E>(name));
+	this->copyTables(*copy);
+	copy->containingNodes = this->containingNodes;
+	copy->sharedNodes = this->liveNodes;
+	//our stamps stay ours, the copy finds every node and edge through its maps
+	copy->nodeIds.reserve(this->containingNodes.size());
+	for (grabIndex id = 0; id < this->nodesById.size(); id++)
+		if (this->nodesById[id])
+		{
+			copy->nodeIds[this->nodesById[id]] = id;
+			this->nodesById[id]->watch(copy.get());
+		}
+	for (grabIndex id = 0; id < this->edgesById.size(); id++)
+		if (this->edgesById[id])
+			copy->edgeIds[this->edgesById[id]] = id;
+	return copy;
+}
+
+template<class T, class E>
+std::shared_ptr<Node<E> > Graph<T, E>::ownNode(std::shared_ptr<Node<E> > node)
+{
+	grabIndex id = this->getNodeId(node.get());
+	if (id == invalidId)
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: node (" + node->getName() + ") not present in graph ("
+						+ this->getName() + ")");
+		return nullptr;
+	}
+	if (!this->isShared(node))
+		return node;
+	//shared fragments only ever touch shared nodes, so we stop at anything we own
+	std::vector<grabIndex> fragment(1, id);
+	std::unordered_set<grabIndex> seen(fragment.begin(), fragment.end());
+	for (size_t next = 0; next < fragment.size(); next++)
+	{
+		Node<E> *member = this->nodesById[fragment[next]];
+		auto reach = [&](Node<E> *other)
+		{
+			grabIndex otherId = this->getNodeId(other);
+			if (otherId != invalidId && this->sharedNodes[otherId]
+					&& seen.insert(otherId).second)
+				fragment.push_back(otherId);
+		};
+		member->forEachEdge([&](Edge<E>*, const std::shared_ptr<Node<E>> &farEnd)
+		{
+			reach(farEnd.get());
+		});
+	}
+	std::sort(fragment.begin(), fragment.end());
+	this->copyNodes(fragment);
+	return this->nodesById[id]->shared_from_this();
+}
+
+template<class T, class E>
+bool Graph<T, E>::isShared(std::shared_ptr<Node<E> > node) const
+{
+	grabIndex id = this->getNodeId(node.get());
+	return id < this->sharedNodes.size() && this->sharedNodes[id];
+}
+
 /************************************************
  *  HELPER FUNCTIONS
  ***********************************************/
@@ -269,6 +974,8 @@ bool Graph<T, E>::containsNode(std::shared_ptr<Node<E> > possiblenode)
 template<class T, class E>
 inline void Graph<T, E>::refreshContaining()
 {
+	PhaseTimer timer("refreshContaining");
+	countOp(OpCounter::RefreshPass);
 //tl:dr this keeps us happy since our nodes cant do any deleting of self from graph structures
 	if (graphDebug)
 		lazyInfo(__LINE__, __func__);
@@ -289,7 +996,483 @@ inline void Graph<T, E>::refreshContaining()
 		}
 	}
 	for (auto &node : dirt)
+	{
+		this->releaseNodeId(node.get());
 		this->containingNodes.erase(node);
+	}
+}
+
+/* Every edge holds both of its nodes, so the lists get emptied before any edge is
+ * destroyed. That way no node dies while an edge it owns is still linked anywhere
+ * and ~Node never has anything left to walk.
+ */
+template<class T, class E>
+void Graph<T, E>::breakEdges(const std::unordered_set<Node<E>*> &nodes)
+{
+	std::vector<std::unique_ptr<Edge<E>>> dying;
+	std::unordered_set<Node<E>*> outside;
+	//other graphs holding the nodes still count their degrees
+	std::vector<std::pair<Node<E>*, size_t>> oldDegrees;
+	for (Node<E> *node : nodes)
+	{
+		oldDegrees.emplace_back(node, node->getDegree());
+		node->dropEdges([&](Edge<E>*, const std::shared_ptr<Node<E>> &farEnd)
+		{
+			if (!nodes.count(farEnd.get()))
+				outside.insert(farEnd.get());
+			return true;
+		}, dying);
+	}
+	//neighbors we keep only lose their entries for edges into the set
+	for (Node<E> *node : outside)
+	{
+		size_t oldDegree = node->getDegree();
+		node->dropEdges([&](Edge<E>*, const std::shared_ptr<Node<E>> &farEnd)
+		{	return nodes.count(farEnd.get()) > 0;}, dying);
+		node->notifyDegree(oldDegree);
+	}
+	for (std::pair<Node<E>*, size_t> const &old : oldDegrees)
+		old.first->notifyDegree(old.second);
+	countOp(OpCounter::EdgeDelete, dying.size());
+	dying.clear();
+}
+
+/* Mark and sweep over everything our nodes' edges reach. A node's expected
+ * owners are us plus one per edge in its lists (edges hold both ends), anyone
+ * past that (a handle, another graph, a batch log) makes it a root. Whatever no
+ * root reaches is only alive through cycles of edges and gets torn down.
+ */
+template<class T, class E>
+void Graph<T, E>::collectUnreachable()
+{
+	std::unordered_map<Node<E>*, size_t> slots;
+	std::vector<Node<E>*> reached;
+	std::vector<long> spare;
+	auto discover = [&](const std::shared_ptr<Node<E>> &node, long ours)
+	{
+		auto found = slots.find(node.get());
+		if (found != slots.end())
+		{
+			spare[found->second] -= ours;
+			return;
+		}
+		slots.emplace(node.get(), reached.size());
+		reached.push_back(node.get());
+		spare.push_back(node.use_count() - ours);
+	};
+	for (std::shared_ptr<Node<E>> const &node : this->containingNodes)
+		discover(node, 1);
+	for (size_t i = 0; i < reached.size(); i++)
+	{
+		Node<E> *node = reached[i];
+		spare[i] -= node->getDegree();
+		node->forEachEdge([&](Edge<E>*, const std::shared_ptr<Node<E>> &farEnd)
+		{
+			discover(farEnd, 0);
+		});
+	}
+
+	std::vector<unsigned char> live(reached.size(), 0);
+	std::vector<size_t> stack;
+	for (size_t i = 0; i < reached.size(); i++)
+	{
+		if (spare[i] <= 0 || live[i])
+			continue;
+		live[i] = 1;
+		stack.assign(1, i);
+		while (!stack.empty())
+		{
+			Node<E> *node = reached[stack.back()];
+			stack.pop_back();
+			auto visit = [&](Node<E> *next)
+			{
+				size_t slot = slots[next];
+				if (!live[slot])
+				{
+					live[slot] = 1;
+					stack.push_back(slot);
+				}
+			};
+			node->forEachEdge([&](Edge<E>*, const std::shared_ptr<Node<E>> &farEnd)
+			{
+				visit(farEnd.get());
+			});
+		}
+	}
+
+	std::unordered_set<Node<E>*> garbage;
+	for (size_t i = 0; i < reached.size(); i++)
+		if (!live[i])
+			garbage.insert(reached[i]);
+	if (graphDebug && !garbage.empty())
+		lazyInfo(__LINE__, __func__,
+				"Tearing down " + std::to_string(garbage.size())
+						+ " unreachable nodes of graph (" + this->getName() + ")");
+	this->breakEdges(garbage);
+}
+
+template<class T, class E>
+size_t Graph<T, E>::nodeBytes(std::shared_ptr<Node<E> > node) const
+{
+	Footprint footprint;
+	node.get()->addFootprint(footprint);
+	return footprint.total() + containingEntryBytes;
+}
+
+template<class T, class E>
+bool Graph<T, E>::fitsBudget(size_t extraBytes) const
+{
+	return (this->byteBudget == 0)
+			|| (this->accountedBytes + extraBytes <= this->byteBudget);
+}
+
+//stamp the node unless another graph got to it first, then it goes in our map
+template<class T, class E>
+void Graph<T, E>::assignNodeId(Node<E> *node)
+{
+	grabIndex id;
+	if (this->freeNodeIds.empty())
+	{
+		id = (grabIndex) this->nodesById.size();
+		this->nodesById.push_back(node);
+		this->liveNodes.push_back(1);
+		this->nodeColumns.resize(id + 1);
+	}
+	else
+	{
+		id = this->freeNodeIds.back();
+		this->freeNodeIds.pop_back();
+		this->nodesById[id] = node;
+		this->liveNodes[id] = 1;
+	}
+	if (node->getIndex() == invalidId)
+		node->setIndex(id);
+	else
+		this->nodeIds[node] = id;
+	if (id < this->sharedNodes.size())
+		this->sharedNodes[id] = 0;
+	this->indexNode(id, node);
+	this->countDegree(node->getDegree());
+	node->watch(this);
+}
+
+//payload row goes back to defaults so whoever gets the id next starts clean
+template<class T, class E>
+void Graph<T, E>::releaseNodeId(Node<E> *node)
+{
+	//a stamp that matches may still be another graph's that numbered it the same
+	grabIndex id;
+	auto found = this->nodeIds.empty() ? this->nodeIds.end() : this->nodeIds.find(node);
+	if (found != this->nodeIds.end())
+	{
+		id = found->second;
+		this->nodeIds.erase(found);
+	}
+	else
+	{
+		id = node->getIndex();
+		if (id >= this->nodesById.size() || this->nodesById[id] != node)
+			return;
+		node->setIndex(invalidId);
+	}
+	if (id < this->sharedNodes.size())
+		this->sharedNodes[id] = 0;
+	node->unwatch(this);
+	this->unindexNode(id, node);
+	this->uncountDegree(node->getDegree());
+	this->nodesById[id] = nullptr;
+	this->liveNodes[id] = 0;
+	this->nodeColumns.resetRow(id);
+	this->freeNodeIds.push_back(id);
+}
+
+template<class T, class E>
+grabIndex Graph<T, E>::assignEdgeId(Edge<E> *edge, grabIndex sourceId,
+		grabIndex sinkId)
+{
+	grabIndex id = edge->getIndex();
+	if (id >= this->edgesById.size() || this->edgesById[id] != edge)
+	{
+		auto found = this->edgeIds.find(edge);
+		id = (found == this->edgeIds.end()) ? invalidId : found->second;
+	}
+	if (id != invalidId)
+	{
+		if (this->edgeEnds[id] == std::make_pair(sourceId, sinkId))
+			return id;
+		//the edge we knew died and a new one took its address
+		this->releaseEdgeId(id);
+	}
+	if (this->freeEdgeIds.empty())
+	{
+		id = (grabIndex) this->edgesById.size();
+		this->edgesById.push_back(edge);
+		this->edgeEnds.push_back( { sourceId, sinkId });
+		this->liveEdges.push_back(1);
+		this->edgeColumns.resize(id + 1);
+	}
+	else
+	{
+		id = this->freeEdgeIds.back();
+		this->freeEdgeIds.pop_back();
+		this->edgesById[id] = edge;
+		this->edgeEnds[id] = std::make_pair(sourceId, sinkId);
+		this->liveEdges[id] = 1;
+	}
+	if (edge->getIndex() == invalidId)
+		edge->setIndex(id);
+	else
+		this->edgeIds[edge] = id;
+	return id;
+}
+
+//the edge may be gone already, so only our own tables are touched
+template<class T, class E>
+void Graph<T, E>::releaseEdgeId(grabIndex id)
+{
+	auto found = this->edgeIds.find(this->edgesById[id]);
+	if (found != this->edgeIds.end() && found->second == id)
+		this->edgeIds.erase(found);
+	this->edgesById[id] = nullptr;
+	this->edgeEnds[id] = std::make_pair(invalidId, invalidId);
+	this->liveEdges[id] = 0;
+	this->edgeColumns.resetRow(id);
+	this->freeEdgeIds.push_back(id);
+}
+
+//our nodes are all still alive here, edges between them are reached through their sources
+template<class T, class E>
+void Graph<T, E>::detachNodes()
+{
+	for (grabIndex id = 0; id < this->nodesById.size(); id++)
+	{
+		Node<E> *node = this->nodesById[id];
+		if (!node)
+			continue;
+		node->unwatch(this);
+		//whatever is in our maps carries someone else's stamp
+		if (node->getIndex() == id && !this->nodeIds.count(node))
+			node->setIndex(invalidId);
+		node->forEachOwnedEdge([&](Edge<E> *outEdge)
+		{
+			grabIndex edgeId = outEdge->getIndex();
+			if (edgeId < this->edgesById.size()
+					&& this->edgesById[edgeId] == outEdge
+					&& !this->edgeIds.count(outEdge))
+				outEdge->setIndex(invalidId);
+		});
+	}
+}
+
+template<class T, class E>
+void Graph<T, E>::indexNode(grabIndex id, const Node<E> *node)
+{
+	this->nameIndex.emplace(std::hash<std::string>()(node->name), id);
+	for (std::string const &label : node->labels)
+		this->labelIndex[label].insert(id);
+}
+
+template<class T, class E>
+void Graph<T, E>::unindexNode(grabIndex id, const Node<E> *node)
+{
+	this->unindexName(id, node->name);
+	for (std::string const &label : node->labels)
+		this->unindexLabel(id, label);
+}
+
+template<class T, class E>
+void Graph<T, E>::unindexName(grabIndex id, const std::string &name)
+{
+	auto range = this->nameIndex.equal_range(std::hash<std::string>()(name));
+	for (auto entry = range.first; entry != range.second; entry++)
+		if (entry->second == id)
+		{
+			this->nameIndex.erase(entry);
+			return;
+		}
+}
+
+template<class T, class E>
+void Graph<T, E>::countDegree(size_t degree)
+{
+	if (degree >= this->degreeCounts.size())
+		this->degreeCounts.resize(degree + 1, 0);
+	this->degreeCounts[degree]++;
+}
+
+template<class T, class E>
+void Graph<T, E>::uncountDegree(size_t degree)
+{
+	if (degree >= this->degreeCounts.size() || this->degreeCounts[degree] == 0)
+		return;
+	this->degreeCounts[degree]--;
+	while (!this->degreeCounts.empty() && this->degreeCounts.back() == 0)
+		this->degreeCounts.pop_back();
+}
+
+//a node listing label twice is still one entry, so a second unindex finds nothing
+template<class T, class E>
+void Graph<T, E>::unindexLabel(grabIndex id, const std::string &label)
+{
+	auto found = this->labelIndex.find(label);
+	if (found == this->labelIndex.end())
+		return;
+	found->second.erase(id);
+	if (found->second.empty())
+		this->labelIndex.erase(found);
+}
+
+template<class T, class E>
+void Graph<T, E>::copyTables(Graph<T, E> &into) const
+{
+	into.labels = this->labels;
+	into.byteBudget = this->byteBudget;
+	into.accountedBytes = this->accountedBytes;
+	into.nodeIds = this->nodeIds;
+	into.nodesById = this->nodesById;
+	into.liveNodes = this->liveNodes;
+	into.freeNodeIds = this->freeNodeIds;
+	into.nodeColumns = this->nodeColumns;
+	into.edgeIds = this->edgeIds;
+	into.edgesById = this->edgesById;
+	into.edgeEnds = this->edgeEnds;
+	into.liveEdges = this->liveEdges;
+	into.freeEdgeIds = this->freeEdgeIds;
+	into.edgeColumns = this->edgeColumns;
+	into.nameIndex = this->nameIndex;
+	into.labelIndex = this->labelIndex;
+	into.degreeCounts = this->degreeCounts;
+}
+
+/* Copies are made first, then wired with the old nodes' edge ids, and only then
+ * swapped in, lookups need the old nodes in our tables until the end.
+ */
+template<class T, class E>
+void Graph<T, E>::copyNodes(const std::vector<grabIndex> &ids)
+{
+	//the whole graph gets a slot per id, a fragment searches its sorted ids
+	const bool dense = ids.size() * 4 >= this->nodesById.size();
+	auto slotOf = [&](grabIndex id) -> size_t
+	{
+		if (dense)
+			return id;
+		auto at = std::lower_bound(ids.begin(), ids.end(), id);
+		return (at != ids.end() && *at == id) ? size_t(at - ids.begin()) : ids.size();
+	};
+	std::vector<std::shared_ptr<Node<E>>> copies(
+			dense ? this->nodesById.size() : ids.size());
+	for (grabIndex id : ids)
+	{
+		Node<E> *old = this->nodesById[id];
+		std::shared_ptr<Node<E>> copy = std::make_shared<Node<E>>(old->name);
+		copy->labels = old->labels;
+		copy->leaf = old->leaf;
+		copy->bridge = old->bridge;
+		copy->visited = old->visited;
+		size_t owned = old->getOwnedCount();
+		copy->reserveEdges(owned, old->getDegree() - owned);
+		copies[slotOf(id)] = copy;
+	}
+
+	std::vector<std::pair<grabIndex, Edge<E>*>> freshEdges;
+	for (grabIndex id : ids)
+	{
+		Node<E> *old = this->nodesById[id];
+		std::shared_ptr<Node<E>> &source = copies[slotOf(id)];
+		old->forEachOwnedEdge([&](Edge<E> *outEdge)
+		{
+			grabIndex sinkId = this->getNodeId(outEdge->sinkNode.get());
+			size_t sinkSlot = (sinkId == invalidId) ? copies.size() : slotOf(sinkId);
+			if (sinkSlot >= copies.size() || !copies[sinkSlot])
+				return;
+			std::shared_ptr<Node<E>> &sink = copies[sinkSlot];
+			Edge<E> *edge = Node<E>::linkEdge(
+					std::make_unique<Edge<E>>(outEdge->name, source, sink));
+			edge->labels = outEdge->labels;
+			edge->leaf = outEdge->leaf;
+			edge->bridge = outEdge->bridge;
+			edge->visited = outEdge->visited;
+			countOp(OpCounter::EdgeInsert);
+			freshEdges.emplace_back(
+					this->assignEdgeId(outEdge, id, sinkId), edge);
+		});
+	}
+
+	for (std::pair<grabIndex, Edge<E>*> &fresh : freshEdges)
+	{
+		auto found = this->edgeIds.find(this->edgesById[fresh.first]);
+		if (found != this->edgeIds.end() && found->second == fresh.first)
+			this->edgeIds.erase(found);
+		this->edgesById[fresh.first] = fresh.second;
+		fresh.second->setIndex(fresh.first);
+	}
+	for (grabIndex id : ids)
+	{
+		Node<E> *old = this->nodesById[id];
+		std::shared_ptr<Node<E>> &copy = copies[slotOf(id)];
+		auto found = this->nodeIds.find(old);
+		if (found != this->nodeIds.end() && found->second == id)
+			this->nodeIds.erase(found);
+		//a clone() never held the old nodes, these are no-ops there
+		old->unwatch(this);
+		this->containingNodes.erase(old->shared_from_this());
+		this->containingNodes.insert(copy);
+		this->nodesById[id] = copy.get();
+		copy->setIndex(id);
+		//edges out of the graph were not copied
+		if (copy->getDegree() != old->getDegree())
+		{
+			this->uncountDegree(old->getDegree());
+			this->countDegree(copy->getDegree());
+		}
+		copy->watch(this);
+		if (id < this->sharedNodes.size())
+			this->sharedNodes[id] = 0;
+	}
+}
+
+/************************************************
+ *  NODE WATCHER
+ ***********************************************/
+
+template<class T, class E>
+void Graph<T, E>::nodeRenamed(Node<E> *node, const std::string &oldName)
+{
+	grabIndex id = this->getNodeId(node);
+	if (id == invalidId)
+		return;
+	this->unindexName(id, oldName);
+	this->nameIndex.emplace(std::hash<std::string>()(node->name), id);
+}
+
+template<class T, class E>
+void Graph<T, E>::labelAdded(Node<E> *node, const std::string &label)
+{
+	grabIndex id = this->getNodeId(node);
+	if (id != invalidId)
+		this->labelIndex[label].insert(id);
+}
+
+template<class T, class E>
+void Graph<T, E>::labelsReplaced(Node<E> *node,
+		const std::vector<std::string> &oldLabels)
+{
+	grabIndex id = this->getNodeId(node);
+	if (id == invalidId)
+		return;
+	for (std::string const &label : oldLabels)
+		this->unindexLabel(id, label);
+	for (std::string const &label : node->labels)
+		this->labelIndex[label].insert(id);
+}
+
+template<class T, class E>
+void Graph<T, E>::degreeChanged(Node<E> *node, size_t oldDegree)
+{
+	if (this->getNodeId(node) == invalidId)
+		return;
+	this->uncountDegree(oldDegree);
+	this->countDegree(node->getDegree());
 }
 
 #endif /* INC_STRUCTURE_GRAPH_H_ */
@@ -0,0 +1,28 @@
+/**
+ * @file ids.h
+ * @brief Width of the dense ids graphs hand out.
+ *
+ *	Graphs number their nodes and edges 0 .. bound - 1 (see Graph::getNodeId())
+ *	and stamp the number on the node/edge itself, so side arrays, bitmaps and
+ *	snapshots index straight by it. 32 bits covers about four billion entities,
+ *	define GRAB_WIDE_IDS before including anything to get 64 bit ids instead.
+ *
+ *	Snapshots and the algorithms on top of them stay 32 bit either way, their
+ *	per node rows would not fit in memory long before that runs out.
+ */
+
+#ifndef INC_STRUCTURE_IDS_H_
+#define INC_STRUCTURE_IDS_H_
+
+#include <cstdint>
+
+#ifdef GRAB_WIDE_IDS
+typedef std::uint64_t grabIndex;
+#else
+typedef std::uint32_t grabIndex;
+#endif
+
+//what getNodeId()/getEdgeId() hand back for things that are not ours, and the stamp of unnumbered nodes/edges
+const grabIndex invalidId = (grabIndex) -1;
+
+#endif /* INC_STRUCTURE_IDS_H_ */
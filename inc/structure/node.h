@@ -10,25 +10,138 @@
 #include <memory>
 #include <unordered_map>
 #include <algorithm>
+#include <cstdint>
+#include <type_traits>
 
 #include "../lazyPrints.h"
+#include "../instrument/counters.h"
+#include "../instrument/footprint.h"
+#include "direction.h"
+#include "ids.h"
+#include "smallVector.h"
 
 //probably gonna need to full include
 template<class T> class Edge;
 template<class T, class E> class Graph;
+template<class T, class E> class Batch;
+template<class T> class Node;
 
-const bool nodeDebug = true;
+//can be overridden before including (i.e. benchmarks define GRAB_NODE_DEBUG false)
+#ifndef GRAB_NODE_DEBUG
+#define GRAB_NODE_DEBUG true
+#endif
+const bool nodeDebug = GRAB_NODE_DEBUG;
 
 //switching that will let us use more verbose checks to ensure our structure is maintained
-const bool nodeVerbose = true;
+#ifndef GRAB_NODE_VERBOSE
+#define GRAB_NODE_VERBOSE true
+#endif
+const bool nodeVerbose = GRAB_NODE_VERBOSE;
 
 //TODO: Figure out how to proper and quickly do our hashing
 int graphHash = 100;
 
+/* Told about name/label/degree changes of the nodes it watches, graphs use this
+ * to keep their name and label indexes and degree counts current. Called after
+ * the change went through.
+ */
+template<class T>
+class NodeWatcher
+{
+public:
+	virtual ~NodeWatcher()
+	{
+	}
+
+	virtual void nodeRenamed(Node<T> *node, const std::string &oldName) = 0;
+	virtual void labelAdded(Node<T> *node, const std::string &label) = 0;
+	virtual void labelsReplaced(Node<T> *node,
+			const std::vector<std::string> &oldLabels) = 0;
+	virtual void degreeChanged(Node<T> *node, size_t oldDegree) = 0;
+};
+
+/* One entry of an Undirected node's edge list. An edge sits in the lists of both
+ * its ends, owned by the entry at its source and borrowed by the one at its sink,
+ * the low bit of the pointer says which (edges are word aligned).
+ */
+template<class T>
+class EdgeLink
+{
+public:
+	EdgeLink() = default;
+	explicit EdgeLink(std::unique_ptr<Edge<T>> owned) :
+			bits(reinterpret_cast<std::uintptr_t>(owned.release()) | 1)
+	{
+	}
+	explicit EdgeLink(Edge<T> *borrowed) :
+			bits(reinterpret_cast<std::uintptr_t>(borrowed))
+	{
+	}
+	EdgeLink(EdgeLink &&other) noexcept :
+			bits(other.bits)
+	{
+		other.bits = 0;
+	}
+	EdgeLink& operator=(EdgeLink &&other) noexcept
+	{
+		if (this != &other)
+		{
+			this->reset();
+			this->bits = other.bits;
+			other.bits = 0;
+		}
+		return *this;
+	}
+	EdgeLink(const EdgeLink&) = delete;
+	EdgeLink& operator=(const EdgeLink&) = delete;
+
+	~EdgeLink()
+	{
+		this->reset();
+	}
+
+	Edge<T>* get() const
+	{
+		return reinterpret_cast<Edge<T>*>(this->bits & ~std::uintptr_t(1));
+	}
+
+	bool isOwned() const
+	{
+		return this->bits & 1;
+	}
+
+	//hands an owned edge over (nullptr for a borrowed one), the entry is empty after
+	std::unique_ptr<Edge<T>> release()
+	{
+		std::unique_ptr<Edge<T>> owned(this->isOwned() ? this->get() : nullptr);
+		this->bits = 0;
+		return owned;
+	}
+
+private:
+	std::uintptr_t bits = 0;
+
+	void reset()
+	{
+		if (this->isOwned())
+			delete this->get();
+		this->bits = 0;
+	}
+};
+
 template<class T>
 class Node: public std::enable_shared_from_this<Node<T>>
 {
+	//graphs walk our edge lists directly when building dense ids/snapshots
+	template<class G, class N> friend class Graph;
+	//batches compact our edge lists in one pass instead of an erase per edge
+	template<class G, class N> friend class Batch;
+	//builders append to our edge lists from many threads, each list from one
+	template<class G, class N> friend class Builder;
 public:
+	//how our edges are read, see direction.h
+	typedef typename EdgeDirection<T>::policy Direction;
+
 	/************************************************
 	 *  CONSTRUCTORS/DESTRUCTORS
 	 ***********************************************/
@@ -40,8 +153,9 @@ public:
 	/************************************************
 	 *  GETTER/SETTER PAIRS
 	 ***********************************************/
-	void setIndex(unsigned short int index);
-	unsigned short int getIndex() const;
+	//dense id stamped by the first graph that numbers us, invalidId until then
+	void setIndex(grabIndex index);
+	grabIndex getIndex() const;
 
 	void setName(std::string name);
 	std::string getName() const;
@@ -61,6 +175,8 @@ public:
 	std::vector<std::weak_ptr<Node<T>>> getNeighbors();
 	std::vector<std::weak_ptr<Node<T>>> getChildren();
 	std::vector<std::weak_ptr<Node<T>>> getParents();
+	//edges touching us either way, parallel edges each count
+	size_t getDegree() const;
 
 	/************************************************
 	 *  MUTATORS
@@ -87,6 +203,13 @@ public:
 	bool containsLabel(std::string labelToCheck);
 	bool containsLabel(std::vector<std::string> labelToCheck); //Do we need?
 
+	/************************************************
+	 *  WATCHERS
+	 ***********************************************/
+	//watcher has to unwatch before it goes away, watching twice is a no-op
+	void watch(NodeWatcher<T> *watcher);
+	void unwatch(NodeWatcher<T> *watcher);
+
 	//POSSIBLY CHANGE THIS TO PRIVATE HELPER FUNCTIONS. AS OF NOW KEEP PUBLIC AND TRY NOT TO USE OUTSIDE
 	std::vector<Edge<T>*> getConnectingEdges(std::shared_ptr<Node<T>> nodeB);
 	std::vector<Edge<T>*> getInConnectingEdges(std::shared_ptr<Node<T>> nodeB);
@@ -96,6 +219,8 @@ public:
 	 *  HELPING FUNCTIONS
 	 ***********************************************/
 	std::string edgesAsString();
+	//adds ourself and the out edges we own, in edges are counted by their owners
+	void addFootprint(Footprint &footprint) const;
 
 	/* BELOW ARE FUNCTIONS THAT HAVE BEEN REMOVED BUT MAY BE ADDED AGAIN
 	 *
@@ -107,26 +232,47 @@ private:
 	/************************************************
 	 *  IDENTIFIERS/INFORMATION
 	 ***********************************************/
-	unsigned short int index;
-	std::string name;
-	std::vector<std::string> labels;
+	grabIndex index;
 
 	/************************************************
 	 *  STRUCTURAL ATTRIBUTES
 	 ***********************************************/
-	bool leaf;
-	bool bridge;
+	//packed next to index, together they fill one word
+	bool leaf :1;
+	bool bridge :1;
 
 	/************************************************
 	 *  ALGORITHM TRAVERSAL ATTRIBUTES
 	 ***********************************************/
-	bool visited;
+	bool visited :1;
+
+	//rest of our identifiers, after the flags so nothing pads index
+	std::string name;
+	std::vector<std::string> labels;
 
 	/************************************************
 	 *  STRUCTURAL OWNERSHIP
 	 ***********************************************/
-	std::vector<std::unique_ptr<Edge<T>>> outEdges;
-	std::vector<Edge<T>*> inEdges;
+	//Undirected keeps one list of links, the others an owning out and a borrowing in list
+	static constexpr bool oneList = std::is_same<Direction, Undirected>::value;
+	/* Stands in for the lists a policy does not keep, so touching one does not
+	 * compile, and takes no room (gcc and clang honor no_unique_address in C++17).
+	 */
+	struct NoList
+	{
+	};
+	//room for the usual 4 bonds inline, hubs spill to the heap
+	typedef std::conditional_t<oneList, NoList,
+			SmallVector<std::unique_ptr<Edge<T>>, 4>> OutEdgeList;
+	typedef std::conditional_t<oneList, NoList, SmallVector<Edge<T>*, 4>> InEdgeList;
+	typedef std::conditional_t<oneList, SmallVector<EdgeLink<T>, 4>, NoList> LinkList;
+
+	[[no_unique_address]] OutEdgeList outEdges;
+	[[no_unique_address]] InEdgeList inEdges;
+	[[no_unique_address]] LinkList links;
+
+	//usually just the one graph we are in
+	SmallVector<NodeWatcher<T>*, 1> watchers;
 
 	/* TODO: How do we know about our owning graph? The issue
 	 * 			is I do not want to have to deal with a template
@@ -150,6 +296,40 @@ private:
 	bool hasInEdge(Edge<T> *possibleInEdge);
 	bool hasOutEdge(Edge<T> *possibleOutEdge);
 
+	//Undirected only, drops every edge between us and nodeB whichever way it points
+	void unlinkNeighbor(Node<T> *nodeB);
+
+	/* The lists as graphs, batches and builders see them, whatever the policy keeps:
+	 * edges we own (at their source), edges we borrow (at their sink) and both with
+	 * the node at the far end, the latter in one pass over one list when Undirected.
+	 */
+	template<class F>
+	void forEachOwnedEdge(F visit) const;
+	template<class F>
+	void forEachBorrowedEdge(F visit) const;
+	template<class F>
+	void forEachEdge(F visit) const;
+	bool ownsEdge(const Edge<T> *edge) const;
+	size_t getOwnedCount() const;
+
+	//room for that many more entries
+	void reserveEdges(size_t owned, size_t borrowed);
+	//the edge's source takes it over and its sink gets a borrowed entry
+	static Edge<T>* linkEdge(std::unique_ptr<Edge<T>> edge);
+	//one end at a time, for builders filling every node's list from one thread
+	void attachOwned(std::unique_ptr<Edge<T>> edge);
+	void attachBorrowed(Edge<T> *edge);
+
+	/* Drops every entry doomed(edge, farEnd) picks in one compaction. Edges we own
+	 * move to dying, so the far end's entry stays readable until the caller is
+	 * done. Returns the entries dropped, watchers are left to the caller.
+	 */
+	template<class F>
+	size_t dropEdges(F doomed, std::vector<std::unique_ptr<Edge<T>>> &dying);
+
+	//tells our watchers, for whoever changed our edge lists
+	void notifyDegree(size_t oldDegree);
+
 	//Currently testing in order to ensure efficacy
 	bool equalEdgeContents(std::vector<Edge<T>*> vec1,
 			std::vector<Edge<T>*> vec2)
@@ -168,7 +348,7 @@ template<class T>
 Node<T>::Node()
 {
 	this->setName("DEFAULT_NODE_NAME");
-	this->setIndex(1);
+	this->setIndex(invalidId);
 	this->setIsLeaf(false);
 	this->setIsBridge(false);
 	this->setIsVisited(false);
@@ -184,7 +364,7 @@ template<class T>
 Node<T>::Node(std::string name)
 {
 	this->setName(name);
-	this->setIndex(1);
+	this->setIndex(invalidId);
 	this->setIsLeaf(false);
 	this->setIsBridge(false);
 	this->setIsVisited(false);
@@ -204,7 +384,9 @@ Node<T>::~Node()
 		lazyInfo(__LINE__, __func__, delMsg);
 	}
 	//We will have to delete ourself from all of the graphs we are contained within if we are explicitly deleted, this will come in future
-	this->deleteEdges();
+	//a bulk teardown (Graph::breakEdges()) already emptied our lists
+	if (this->getDegree() != 0)
+		this->deleteEdges();
 }
 
 /************************************************
@@ -212,13 +394,13 @@ Node<T>::~Node()
  ***********************************************/
 
 template<class T>
-void Node<T>::setIndex(unsigned short int index)
+void Node<T>::setIndex(grabIndex index)
 {
 	this->index = index;
 }
 
 template<class T>
-unsigned short int Node<T>::getIndex() const
+grabIndex Node<T>::getIndex() const
 {
 	return index;
 }
@@ -226,7 +408,15 @@ unsigned short int Node<T>::getIndex() const
 template<class T>
 void Node<T>::setName(std::string name)
 {
+	if (this->watchers.empty())
+	{
+		this->name = name;
+		return;
+	}
+	std::string oldName = this->name;
 	this->name = name;
+	for (NodeWatcher<T> *watcher : this->watchers)
+		watcher->nodeRenamed(this, oldName);
 }
 
 template<class T>
@@ -238,7 +428,15 @@ std::string Node<T>::getName() const
 template<class T>
 void Node<T>::setLabels(std::vector<std::string> labels)
 {
+	if (this->watchers.empty())
+	{
+		this->labels = labels;
+		return;
+	}
+	std::vector<std::string> oldLabels = this->labels;
 	this->labels = labels;
+	for (NodeWatcher<T> *watcher : this->watchers)
+		watcher->labelsReplaced(this, oldLabels);
 }
 
 template<class T>
@@ -286,36 +484,80 @@ bool Node<T>::getIsVisited() const
 template<class T>
 std::vector<std::weak_ptr<Node<T> > > Node<T>::getNeighbors()
 {
-	std::vector<std::weak_ptr<Node<T>>> children = this->getChildren();
-	std::vector<std::weak_ptr<Node<T>>> parents = this->getParents();
-	children.insert(children.end(), parents.begin(), parents.end());
-	if (nodeDebug && (children.size() == 0))
-		lazyInfo(__LINE__, __func__,
-				"Returned vector of neighbors is of size 0");
-	return children;
+	OpScope scope(InstrumentedOp::NodeGetNeighbors);
+	if constexpr (std::is_same<Direction, Undirected>::value)
+	{
+		//one list, no child/parent split to merge afterwards
+		countOp(OpCounter::NeighborScan);
+		countOp(OpCounter::EdgeVisit, this->links.size());
+		countOp(OpCounter::RefcountAccess, this->links.size());
+		std::vector<std::weak_ptr<Node<T>>> neighbors;
+		neighbors.reserve(this->links.size());
+		this->forEachEdge([&](Edge<T>*, const std::shared_ptr<Node<T>> &farEnd)
+		{
+			neighbors.push_back(farEnd);
+		});
+		if (nodeDebug && (neighbors.size() == 0))
+			lazyInfo(__LINE__, __func__,
+					"Returned vector of neighbors is of size 0");
+		return neighbors;
+	}
+	else
+	{
+		std::vector<std::weak_ptr<Node<T>>> children = this->getChildren();
+		std::vector<std::weak_ptr<Node<T>>> parents = this->getParents();
+		children.insert(children.end(), parents.begin(), parents.end());
+		if (nodeDebug && (children.size() == 0))
+			lazyInfo(__LINE__, __func__,
+					"Returned vector of neighbors is of size 0");
+		return children;
+	}
 }
 
 template<class T>
 std::vector<std::weak_ptr<Node<T> > > Node<T>::getChildren()
 {
-	std::vector<std::weak_ptr<Node<T>>> children;
-	for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
-		children.push_back(outEdge->getSinkNode());
-	if (nodeDebug && (children.size() == 0))
-		lazyInfo(__LINE__, __func__,
-				"Returned vector of children is of size 0");
-	return children;
+	if constexpr (std::is_same<Direction, Undirected>::value)
+		return this->getNeighbors();
+	else
+	{
+		countOp(OpCounter::NeighborScan);
+		countOp(OpCounter::EdgeVisit, this->outEdges.size());
+		std::vector<std::weak_ptr<Node<T>>> children;
+		for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
+			children.push_back(outEdge->getSinkNode());
+		if (nodeDebug && (children.size() == 0))
+			lazyInfo(__LINE__, __func__,
+					"Returned vector of children is of size 0");
+		return children;
+	}
 }
 
 template<class T>
 std::vector<std::weak_ptr<Node<T> > > Node<T>::getParents()
 {
-	std::vector<std::weak_ptr<Node<T>>> parents;
-	for (Edge<T> *inEdge : this->inEdges)
-		parents.push_back(inEdge->getSourceNode());
-	if (nodeDebug && (parents.size() == 0))
-		lazyInfo(__LINE__, __func__, "Returned vector of parents is of size 0");
-	return parents;
+	if constexpr (std::is_same<Direction, Undirected>::value)
+		return this->getNeighbors();
+	else
+	{
+		countOp(OpCounter::NeighborScan);
+		countOp(OpCounter::EdgeVisit, this->inEdges.size());
+		std::vector<std::weak_ptr<Node<T>>> parents;
+		for (Edge<T> *inEdge : this->inEdges)
+			parents.push_back(inEdge->getSourceNode());
+		if (nodeDebug && (parents.size() == 0))
+			lazyInfo(__LINE__, __func__, "Returned vector of parents is of size 0");
+		return parents;
+	}
+}
+
+template<class T>
+size_t Node<T>::getDegree() const
+{
+	if constexpr (oneList)
+		return this->links.size();
+	else
+		return this->outEdges.size() + this->inEdges.size();
 }
 
 /************************************************
@@ -326,6 +568,8 @@ template<class T>
 void Node<T>::addLabel(std::string label)
 {
 	this->labels.push_back(label);
+	for (NodeWatcher<T> *watcher : this->watchers)
+		watcher->labelAdded(this, label);
 }
 
 template<class T>
@@ -339,6 +583,7 @@ template<class T>
 void Node<T>::addChild(std::string edgeName,
 		std::shared_ptr<Node<T> > freshChild)
 {
+	OpScope scope(InstrumentedOp::NodeAddChild);
 	if (nodeDebug)
 	{
 		std::string tempMsg = "Adding (" + freshChild.get()->getName()
@@ -352,11 +597,13 @@ void Node<T>::addChild(std::string edgeName,
 		badBehavior(__LINE__, __func__, badMsg);
 		return;
 	}
-	this->outEdges.push_back(
+	linkEdge(
 			std::make_unique<Edge<T>>(edgeName, this->shared_from_this(),
 					freshChild));
-	//probably should worry about popping last out, most likely should use a temp then move it
-	freshChild.get()->inEdges.push_back(this->outEdges.back().get());
+	this->notifyDegree(this->getDegree() - 1);
+	freshChild->notifyDegree(freshChild->getDegree() - 1);
+	countOp(OpCounter::EdgeInsert);
+	countOp(OpCounter::RefcountAccess); //shared_from_this
 	if (nodeDebug)
 	{
 		std::string tempMsg = "Added (" + freshChild.get()->getName()
@@ -370,6 +617,7 @@ template<class T>
 void Node<T>::addParent(std::string edgeName,
 		std::shared_ptr<Node<T> > freshParent)
 {
+	OpScope scope(InstrumentedOp::NodeAddParent);
 	if (nodeDebug)
 	{
 		std::string tempMsg = "Adding (" + freshParent.get()->getName()
@@ -383,10 +631,13 @@ void Node<T>::addParent(std::string edgeName,
 		badBehavior(__LINE__, __func__, badMsg);
 		return;
 	}
-	freshParent.get()->outEdges.push_back(
+	linkEdge(
 			std::make_unique<Edge<T>>(edgeName, freshParent,
 					this->shared_from_this()));
-	this->inEdges.push_back(freshParent.get()->outEdges.back().get());
+	this->notifyDegree(this->getDegree() - 1);
+	freshParent->notifyDegree(freshParent->getDegree() - 1);
+	countOp(OpCounter::EdgeInsert);
+	countOp(OpCounter::RefcountAccess); //shared_from_this
 	if (nodeDebug)
 	{
 		std::string tempMsg = "Added (" + freshParent.get()->getName()
@@ -400,52 +651,58 @@ void Node<T>::addParent(std::string edgeName,
 template<class T>
 void Node<T>::deleteEdgesToChild(std::shared_ptr<Node<T> > child)
 {
-	if (nodeVerbose)
+	if constexpr (std::is_same<Direction, Undirected>::value)
+		this->deleteEdges(child);
+	else
 	{
-		std::vector<Edge<T>*> outConEdges = this->getOutConnectingEdges(child);
-		std::vector<Edge<T>*> inConnodeB = child.get()->getInConnectingEdges(
-				this->shared_from_this());
-		bool niceOne = true;
-		//one way of checking our vecs are equal
-		for (Edge<T> *const outEdge : outConEdges)
+		OpScope scope(InstrumentedOp::NodeDeleteEdgesToChild);
+		if (nodeVerbose)
 		{
-			if (std::find(inConnodeB.begin(), inConnodeB.end(), outEdge)
-					== inConnodeB.end())
-				niceOne = false;
-		}
-		//another way of checking vecs are equal
-		bool nice1 = this->equalEdgeContents(inConnodeB, outConEdges);
-		if (niceOne == nice1) //ensure 2 methods constantly put out same
-		{
-			if (niceOne)
+			std::vector<Edge<T>*> outConEdges = this->getOutConnectingEdges(child);
+			std::vector<Edge<T>*> inConnodeB = child.get()->getInConnectingEdges(
+					this->shared_from_this());
+			bool niceOne = true;
+			//one way of checking our vecs are equal
+			for (Edge<T> *const outEdge : outConEdges)
+			{
+				if (std::find(inConnodeB.begin(), inConnodeB.end(), outEdge)
+						== inConnodeB.end())
+					niceOne = false;
+			}
+			//another way of checking vecs are equal
+			bool nice1 = this->equalEdgeContents(inConnodeB, outConEdges);
+			if (niceOne == nice1) //ensure 2 methods constantly put out same
 			{
-				for (Edge<T> *const toDelete : outConEdges)
+				if (niceOne)
 				{
-					child.get()->deleteInEdge(toDelete);
-					this->deleteOutEdge(toDelete);
+					for (Edge<T> *const toDelete : outConEdges)
+					{
+						child.get()->deleteInEdge(toDelete);
+						this->deleteOutEdge(toDelete);
+					}
+				}
+				else
+				{
+					std::string badMsg =
+							"Our connecting out and in edges don't match!";
+					badBehavior(__LINE__, __func__, badMsg);
 				}
 			}
 			else
 			{
 				std::string badMsg =
-						"Our connecting out and in edges don't match!";
+						"Warning: Our 2 equality methods did not return same value!";
 				badBehavior(__LINE__, __func__, badMsg);
 			}
 		}
 		else
 		{
-			std::string badMsg =
-					"Warning: Our 2 equality methods did not return same value!";
-			badBehavior(__LINE__, __func__, badMsg);
-		}
-	}
-	else
-	{
-		std::vector<Edge<T>*> outConEdges = this->getOutConnectingEdges(child);
-		for (Edge<T> *const toDelete : outConEdges)
-		{
-			child.get()->deleteInEdge(toDelete);
-			this->deleteOutEdge(toDelete);
+			std::vector<Edge<T>*> outConEdges = this->getOutConnectingEdges(child);
+			for (Edge<T> *const toDelete : outConEdges)
+			{
+				child.get()->deleteInEdge(toDelete);
+				this->deleteOutEdge(toDelete);
+			}
 		}
 	}
 }
@@ -453,53 +710,59 @@ void Node<T>::deleteEdgesToChild(std::shared_ptr<Node<T> > child)
 template<class T>
 void Node<T>::deleteEdgesToParent(std::shared_ptr<Node<T> > parent)
 {
-	if (nodeVerbose)
+	if constexpr (std::is_same<Direction, Undirected>::value)
+		this->deleteEdges(parent);
+	else
 	{
-		std::vector<Edge<T>*> inConEdges = this->getInConnectingEdges(parent);
-		std::vector<Edge<T>*> outConnodeB = parent.get()->getOutConnectingEdges(
-				this->shared_from_this());
-		bool niceOne = true;
-		for (auto const &inEdge : inConEdges)
+		OpScope scope(InstrumentedOp::NodeDeleteEdgesToParent);
+		if (nodeVerbose)
 		{
-			if (std::find(outConnodeB.begin(), outConnodeB.end(), inEdge)
-					== outConnodeB.end())
-				niceOne = false;
-		}
-		//another way of checking vecs are equal
-		bool nice1 = this->equalEdgeContents(outConnodeB, inConEdges);
-		if (niceOne == nice1) //ensure 2 methods constantly put out same
-		{
-			if (niceOne)
+			std::vector<Edge<T>*> inConEdges = this->getInConnectingEdges(parent);
+			std::vector<Edge<T>*> outConnodeB = parent.get()->getOutConnectingEdges(
+					this->shared_from_this());
+			bool niceOne = true;
+			for (auto const &inEdge : inConEdges)
+			{
+				if (std::find(outConnodeB.begin(), outConnodeB.end(), inEdge)
+						== outConnodeB.end())
+					niceOne = false;
+			}
+			//another way of checking vecs are equal
+			bool nice1 = this->equalEdgeContents(outConnodeB, inConEdges);
+			if (niceOne == nice1) //ensure 2 methods constantly put out same
 			{
-				for (Edge<T> *const toDelete : outConnodeB)
+				if (niceOne)
 				{
-					this->deleteInEdge(toDelete);
-					parent.get()->deleteOutEdge(toDelete);
+					for (Edge<T> *const toDelete : outConnodeB)
+					{
+						this->deleteInEdge(toDelete);
+						parent.get()->deleteOutEdge(toDelete);
+					}
+				}
+				else
+				{
+					std::string badMsg =
+							"Our connecting out and in edges don't match!";
+					badBehavior(__LINE__, __func__, badMsg);
 				}
 			}
 			else
 			{
 				std::string badMsg =
-						"Our connecting out and in edges don't match!";
+						"Warning: Our 2 equality methods did not return same value!";
 				badBehavior(__LINE__, __func__, badMsg);
 			}
+
 		}
 		else
 		{
-			std::string badMsg =
-					"Warning: Our 2 equality methods did not return same value!";
-			badBehavior(__LINE__, __func__, badMsg);
-		}
-
-	}
-	else
-	{
-		std::vector<Edge<T>*> outConnodeB = parent.get()->getOutConnectingEdges(
-				this->shared_from_this());
-		for (Edge<T> *const toDelete : outConnodeB)
-		{
-			this->deleteInEdge(toDelete);
-			parent.get()->deleteOutEdge(toDelete);
+			std::vector<Edge<T>*> outConnodeB = parent.get()->getOutConnectingEdges(
+					this->shared_from_this());
+			for (Edge<T> *const toDelete : outConnodeB)
+			{
+				this->deleteInEdge(toDelete);
+				parent.get()->deleteOutEdge(toDelete);
+			}
 		}
 	}
 }
@@ -507,6 +770,7 @@ void Node<T>::deleteEdgesToParent(std::shared_ptr<Node<T> > parent)
 template<class T>
 void Node<T>::deleteEdges(std::shared_ptr<Node<T> > nodeB)
 {
+	OpScope scope(InstrumentedOp::NodeDeleteEdges);
 	if (nodeDebug)
 	{
 		std::string cEdgesS = this->edgesAsString();
@@ -518,8 +782,13 @@ void Node<T>::deleteEdges(std::shared_ptr<Node<T> > nodeB)
 	}
 	if (this->isNeighbor(nodeB))
 	{
-		this->deleteEdgesToChild(nodeB);
-		this->deleteEdgesToParent(nodeB);
+		if constexpr (std::is_same<Direction, Undirected>::value)
+			this->unlinkNeighbor(nodeB.get());
+		else
+		{
+			this->deleteEdgesToChild(nodeB);
+			this->deleteEdgesToParent(nodeB);
+		}
 	}
 	else
 	{
@@ -550,6 +819,7 @@ void Node<T>::deleteEdges(std::shared_ptr<Node<T> > nodeB)
 template<class T>
 void Node<T>::deleteEdges()
 {
+	OpScope scope(InstrumentedOp::NodeDeleteEdges);
 	if (nodeDebug)
 	{
 		std::string edgesS = this->edgesAsString();
@@ -579,7 +849,9 @@ void Node<T>::deleteEdges()
 	}
 	else
 	{
-		badBehavior(__LINE__, __func__, "Neighbors vector has size < 0");
+		//a floating node is fine, happens every time an edge-less node destructs
+		if (nodeDebug)
+			lazyInfo(__LINE__, __func__, "Node has no neighbors, nothing to remove");
 		return;
 	}
 	if (nodeDebug)
@@ -598,30 +870,62 @@ void Node<T>::deleteEdges()
 template<class T>
 bool Node<T>::isChild(std::shared_ptr<Node<T> > possibleParent)
 {
-	for (Edge<T> *const inEdge : this->inEdges)
+	if constexpr (std::is_same<Direction, Undirected>::value)
+		return this->isNeighbor(possibleParent);
+	else
 	{
-		if (inEdge->getSourceNode().get() == possibleParent.get())
-			return true;
+		OpScope scope(InstrumentedOp::NodeRelationCheck);
+		countOp(OpCounter::NeighborScan);
+		countOp(OpCounter::EdgeVisit, this->inEdges.size());
+		for (Edge<T> *const inEdge : this->inEdges)
+		{
+			if (inEdge->getSourceNode().get() == possibleParent.get())
+				return true;
+		}
+		return false;
 	}
-	return false;
 }
 
 template<class T>
 bool Node<T>::isParent(std::shared_ptr<Node<T> > possibleChild)
 {
-	for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
+	if constexpr (std::is_same<Direction, Undirected>::value)
+		return this->isNeighbor(possibleChild);
+	else
 	{
-		if (outEdge.get()->getSinkNode().get() == possibleChild.get())
-			return true;
+		OpScope scope(InstrumentedOp::NodeRelationCheck);
+		countOp(OpCounter::NeighborScan);
+		countOp(OpCounter::EdgeVisit, this->outEdges.size());
+		for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
+		{
+			if (outEdge.get()->getSinkNode().get() == possibleChild.get())
+				return true;
+		}
+		return false;
 	}
-	return false;
 }
 
 template<class T>
 bool Node<T>::isNeighbor(std::shared_ptr<Node<T> > possibleNeighbor)
 {
-	//Do we want to worry about granularity? Something can be both parent and child if either a cycle of a self-pointing edge
-	return (this->isChild(possibleNeighbor) || this->isParent(possibleNeighbor));
+	OpScope scope(InstrumentedOp::NodeRelationCheck);
+	if constexpr (std::is_same<Direction, Undirected>::value)
+	{
+		countOp(OpCounter::NeighborScan);
+		for (EdgeLink<T> const &link : this->links)
+		{
+			countOp(OpCounter::EdgeVisit);
+			Edge<T> *edge = link.get();
+			Node<T> *farEnd = link.isOwned() ?
+					edge->sinkNode.get() : edge->sourceNode.get();
+			if (farEnd == possibleNeighbor.get())
+				return true;
+		}
+		return false;
+	}
+	else
+		//Do we want to worry about granularity? Something can be both parent and child if either a cycle of a self-pointing edge
+		return (this->isChild(possibleNeighbor) || this->isParent(possibleNeighbor));
 }
 
 template<class T>
@@ -639,6 +943,26 @@ bool Node<T>::containsLabel(std::vector<std::string> labelsToCheck)
 	return false;
 }
 
+/************************************************
+ *  WATCHERS
+ ***********************************************/
+
+template<class T>
+void Node<T>::watch(NodeWatcher<T> *watcher)
+{
+	if (std::find(this->watchers.begin(), this->watchers.end(), watcher)
+			== this->watchers.end())
+		this->watchers.push_back(watcher);
+}
+
+template<class T>
+void Node<T>::unwatch(NodeWatcher<T> *watcher)
+{
+	this->watchers.erase(
+			std::remove(this->watchers.begin(), this->watchers.end(), watcher),
+			this->watchers.end());
+}
+
 /* NOTE: WOULD WE LIKE TO EVENTUALLY HIDE THESE AWAY AS HELPER FUNCTIONS?
  *			TODO: finish it
  */
@@ -666,12 +990,14 @@ template<class T>
 std::vector<Edge<T>*> Node<T>::getInConnectingEdges(
 		std::shared_ptr<Node<T> > nodeB)
 {
+	countOp(OpCounter::NeighborScan);
+	countOp(OpCounter::EdgeVisit, this->getDegree() - this->getOwnedCount());
 	std::vector<Edge<T>*> inConEdges;
-	for (Edge<T>* const inEdge : this->inEdges)
+	this->forEachBorrowedEdge([&](Edge<T> *inEdge)
 	{
-		if (inEdge->getSourceNode().get() == nodeB.get())
+		if (inEdge->sourceNode.get() == nodeB.get())
 			inConEdges.push_back(inEdge);
-	}
+	});
 	return inConEdges;
 }
 
@@ -679,12 +1005,14 @@ template<class T>
 std::vector<Edge<T>*> Node<T>::getOutConnectingEdges(
 		std::shared_ptr<Node<T> > nodeB)
 {
+	countOp(OpCounter::NeighborScan);
+	countOp(OpCounter::EdgeVisit, this->getOwnedCount());
 	std::vector<Edge<T>*> outConEdges;
-	for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
+	this->forEachOwnedEdge([&](Edge<T> *outEdge)
 	{
-		if (outEdge.get()->getSinkNode().get() == nodeB.get())
-			outConEdges.push_back(outEdge.get());
-	}
+		if (outEdge->sinkNode.get() == nodeB.get())
+			outConEdges.push_back(outEdge);
+	});
 	return outConEdges;
 }
 
@@ -694,20 +1022,52 @@ std::vector<Edge<T>*> Node<T>::getOutConnectingEdges(
 template<class T>
 std::string Node<T>::edgesAsString()
 {
+	//Undirected links are split the same way, borrowed ones are the in edges
+	std::string inNames, outNames;
+	this->forEachBorrowedEdge([&](Edge<T> *inEdge)
+	{
+		inNames += inEdge->getName() + ", ";
+	});
+	this->forEachOwnedEdge([&](Edge<T> *outEdge)
+	{
+		outNames += outEdge->getName() + ", ";
+	});
 	std::string edgesString = "";
 	edgesString = "========= EDGE CHECK: " + this->getName()
 			+ " =========\n\tIn Edges Size: "
-			+ std::to_string(this->inEdges.size()) + "\n\t";
-	for (Edge<T> *const inEdge : this->inEdges)
-		edgesString += inEdge->getName() + ", ";
+			+ std::to_string(this->getDegree() - this->getOwnedCount()) + "\n\t"
+			+ inNames;
 	edgesString += "\n\tOut Edges Size: "
-			+ std::to_string(this->outEdges.size()) + "\n\t";
-	for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
-		edgesString += outEdge.get()->getName() + ", ";
+			+ std::to_string(this->getOwnedCount()) + "\n\t" + outNames;
 	edgesString += "\n";
 	return edgesString;
 }
 
+template<class T>
+void Node<T>::addFootprint(Footprint &footprint) const
+{
+	footprint.nodeCount++;
+	footprint.nodeBytes += sizeof(Node<T> ) + sharedControlBytes;
+	footprint.nameBytes += stringHeapBytes(this->name);
+	addLabelBytes(this->labels, footprint);
+	if constexpr (oneList)
+		addVectorBytes(this->links, footprint.adjacencyBytes,
+				footprint.slackBytes);
+	else
+	{
+		addVectorBytes(this->outEdges, footprint.adjacencyBytes,
+				footprint.slackBytes);
+		addVectorBytes(this->inEdges, footprint.adjacencyBytes,
+				footprint.slackBytes);
+	}
+	addVectorBytes(this->watchers, footprint.containerBytes,
+			footprint.slackBytes);
+	this->forEachOwnedEdge([&](Edge<T> *outEdge)
+	{
+		outEdge->addFootprint(footprint);
+	});
+}
+
 /************************************************
  *  HELPER FUNCTIONS
  ***********************************************/
@@ -724,6 +1084,7 @@ void Node<T>::deleteInEdge(Edge<T> *inEdgeToDelete)
 		this->inEdges.erase(
 				std::remove(this->inEdges.begin(), this->inEdges.end(),
 						inEdgeToDelete), this->inEdges.end());
+		this->notifyDegree(this->getDegree() + 1);
 	}
 	else
 	{
@@ -754,9 +1115,11 @@ void Node<T>::deleteOutEdge(Edge<T> *outEdgeToDelete)
 			if (outEdge.get() == outEdgeToDelete)
 				outEdge.reset();
 		}
+		countOp(OpCounter::EdgeDelete);
 		this->outEdges.erase(
 				std::remove(this->outEdges.begin(), this->outEdges.end(),
 						nullptr), this->outEdges.end());
+		this->notifyDegree(this->getDegree() + 1);
 	}
 	else
 	{
@@ -774,6 +1137,8 @@ void Node<T>::deleteOutEdge(Edge<T> *outEdgeToDelete)
 template<class T>
 bool Node<T>::hasInEdge(Edge<T> *possibleInEdge)
 {
+	countOp(OpCounter::NeighborScan);
+	countOp(OpCounter::EdgeVisit, this->inEdges.size());
 	int count = 0;
 	for (Edge<T> *const inEdge : this->inEdges)
 	{
@@ -793,6 +1158,8 @@ bool Node<T>::hasInEdge(Edge<T> *possibleInEdge)
 template<class T>
 bool Node<T>::hasOutEdge(Edge<T> *possibleOutEdge)
 {
+	countOp(OpCounter::NeighborScan);
+	countOp(OpCounter::EdgeVisit, this->outEdges.size());
 	int count = 0;
 	for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
 	{
@@ -809,4 +1176,213 @@ bool Node<T>::hasOutEdge(Edge<T> *possibleOutEdge)
 	return (count == 1) ? true : false;
 }
 
+/* Every edge between the two of us goes in one compaction of each of our lists
+ * instead of a find and erase per edge. Without a direction there is no out/in
+ * pairing to cross check, so verbose mode just checks both sides lost the same
+ * number.
+ */
+template<class T>
+void Node<T>::unlinkNeighbor(Node<T> *nodeB)
+{
+	//dropping the last edges between us may drop the last owners of either node
+	std::shared_ptr<Node<T>> keepThis = this->weak_from_this().lock();
+	std::shared_ptr<Node<T>> keepB = nodeB->weak_from_this().lock();
+	countOp(OpCounter::NeighborScan, 2);
+	countOp(OpCounter::EdgeVisit, this->getDegree() + nodeB->getDegree());
+
+	size_t oldDegree = this->getDegree();
+	size_t oldDegreeB = nodeB->getDegree();
+	std::vector<std::unique_ptr<Edge<T>>> dying;
+	size_t dropped = this->dropEdges(
+			[nodeB](Edge<T>*, const std::shared_ptr<Node<T>> &farEnd)
+			{	return farEnd.get() == nodeB;}, dying);
+	size_t droppedB = nodeB->dropEdges(
+			[this](Edge<T>*, const std::shared_ptr<Node<T>> &farEnd)
+			{	return farEnd.get() == this;}, dying);
+
+	countOp(OpCounter::EdgeDelete, dying.size());
+	if (nodeVerbose && (dropped != droppedB || dropped != dying.size()))
+		badBehavior(__LINE__, __func__,
+				"Our connecting out and in edges don't match!");
+	dying.clear();
+	this->notifyDegree(oldDegree);
+	nodeB->notifyDegree(oldDegreeB);
+}
+
+template<class T>
+template<class F>
+void Node<T>::forEachOwnedEdge(F visit) const
+{
+	if constexpr (oneList)
+	{
+		for (EdgeLink<T> const &link : this->links)
+			if (link.isOwned())
+				visit(link.get());
+	}
+	else
+		for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
+			visit(outEdge.get());
+}
+
+template<class T>
+template<class F>
+void Node<T>::forEachBorrowedEdge(F visit) const
+{
+	if constexpr (oneList)
+	{
+		for (EdgeLink<T> const &link : this->links)
+			if (!link.isOwned())
+				visit(link.get());
+	}
+	else
+		for (Edge<T> *inEdge : this->inEdges)
+			visit(inEdge);
+}
+
+template<class T>
+template<class F>
+void Node<T>::forEachEdge(F visit) const
+{
+	if constexpr (oneList)
+		for (EdgeLink<T> const &link : this->links)
+		{
+			Edge<T> *edge = link.get();
+			visit(edge, link.isOwned() ? edge->sinkNode : edge->sourceNode);
+		}
+	else
+	{
+		for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
+			visit(outEdge.get(), outEdge->sinkNode);
+		for (Edge<T> *inEdge : this->inEdges)
+			visit(inEdge, inEdge->sourceNode);
+	}
+}
+
+//compares addresses only, edge may be gone already
+template<class T>
+bool Node<T>::ownsEdge(const Edge<T> *edge) const
+{
+	if constexpr (oneList)
+	{
+		for (EdgeLink<T> const &link : this->links)
+			if (link.isOwned() && link.get() == edge)
+				return true;
+	}
+	else
+		for (std::unique_ptr<Edge<T>> const &outEdge : this->outEdges)
+			if (outEdge.get() == edge)
+				return true;
+	return false;
+}
+
+template<class T>
+size_t Node<T>::getOwnedCount() const
+{
+	if constexpr (oneList)
+		return std::count_if(this->links.begin(), this->links.end(),
+				[](EdgeLink<T> const &link)
+				{	return link.isOwned();});
+	else
+		return this->outEdges.size();
+}
+
+template<class T>
+void Node<T>::reserveEdges(size_t owned, size_t borrowed)
+{
+	if constexpr (oneList)
+		this->links.reserve(this->links.size() + owned + borrowed);
+	else
+	{
+		this->outEdges.reserve(this->outEdges.size() + owned);
+		this->inEdges.reserve(this->inEdges.size() + borrowed);
+	}
+}
+
+template<class T>
+Edge<T>* Node<T>::linkEdge(std::unique_ptr<Edge<T>> edge)
+{
+	Edge<T> *linked = edge.get();
+	linked->sourceNode->attachOwned(std::move(edge));
+	linked->sinkNode->attachBorrowed(linked);
+	return linked;
+}
+
+template<class T>
+void Node<T>::attachOwned(std::unique_ptr<Edge<T>> edge)
+{
+	if constexpr (oneList)
+		this->links.push_back(EdgeLink<T>(std::move(edge)));
+	else
+		this->outEdges.push_back(std::move(edge));
+}
+
+template<class T>
+void Node<T>::attachBorrowed(Edge<T> *edge)
+{
+	if constexpr (oneList)
+		this->links.push_back(EdgeLink<T>(edge));
+	else
+		this->inEdges.push_back(edge);
+}
+
+template<class T>
+template<class F>
+size_t Node<T>::dropEdges(F doomed, std::vector<std::unique_ptr<Edge<T>>> &dying)
+{
+	const size_t oldDegree = this->getDegree();
+	if constexpr (oneList)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < this->links.size(); i++)
+		{
+			EdgeLink<T> &link = this->links[i];
+			Edge<T> *edge = link.get();
+			if (doomed(edge, link.isOwned() ? edge->sinkNode : edge->sourceNode))
+			{
+				if (link.isOwned())
+					dying.push_back(link.release());
+			}
+			else
+			{
+				if (kept != i)
+					this->links[kept] = std::move(link);
+				kept++;
+			}
+		}
+		this->links.resize(kept);
+	}
+	else
+	{
+		this->inEdges.erase(
+				std::remove_if(this->inEdges.begin(), this->inEdges.end(),
+						[&](Edge<T> *inEdge)
+						{	return doomed(inEdge, inEdge->sourceNode);}),
+				this->inEdges.end());
+		size_t kept = 0;
+		for (size_t i = 0; i < this->outEdges.size(); i++)
+		{
+			std::unique_ptr<Edge<T>> &outEdge = this->outEdges[i];
+			if (doomed(outEdge.get(), outEdge->sinkNode))
+				dying.push_back(std::move(outEdge));
+			else
+			{
+				if (kept != i)
+					this->outEdges[kept] = std::move(outEdge);
+				kept++;
+			}
+		}
+		this->outEdges.resize(kept);
+	}
+	return oldDegree - this->getDegree();
+}
+
+template<class T>
+void Node<T>::notifyDegree(size_t oldDegree)
+{
+	if (this->watchers.empty() || this->getDegree() == oldDegree)
+		return;
+	for (NodeWatcher<T> *watcher : this->watchers)
+		watcher->degreeChanged(this, oldDegree);
+}
+
 #endif /* INC_STRUCTURE_NODE_H_ */
@@ -0,0 +1,185 @@
+/**
+ * @file payload.h
+ * @brief Typed node/edge payloads kept struct-of-arrays inside each Graph.
+ *
+ *	Our Node<T>/Edge<T> only carry a name and string labels. Anything a chemist
+ *	wants to attach (element, charge, coordinates, bond order) lives in columns
+ *	owned by the graph, one std::vector per field, indexed by the graph's dense
+ *	node/edge id. Scans over a field are then plain loops over contiguous memory.
+ *
+ *	Pick the fields by specializing the traits for your tag type:
+ *
+ *		template<> struct NodePayload<Molecule>
+ *		{
+ *			typedef ColumnStore<unsigned char, signed char, float, float, float> columns;
+ *		};
+ *
+ *	Avoid bool fields (std::vector<bool> is packed, not contiguous), use unsigned char.
+ */
+
+#ifndef INC_STRUCTURE_PAYLOAD_H_
+#define INC_STRUCTURE_PAYLOAD_H_
+
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "../instrument/footprint.h"
+#include "ids.h"
+
+template<class ... Fields>
+class ColumnStore
+{
+public:
+	static const size_t fieldCount = sizeof...(Fields);
+
+	template<size_t I>
+	using FieldType = typename std::tuple_element<I, std::tuple<Fields...>>::type;
+
+	/************************************************
+	 *  GETTER/SETTER PAIRS
+	 ***********************************************/
+	template<size_t I>
+	void set(size_t row, FieldType<I> value)
+	{
+		std::get<I>(this->columns)[row] = value;
+	}
+
+	template<size_t I>
+	const FieldType<I>& get(size_t row) const
+	{
+		return std::get<I>(this->columns)[row];
+	}
+
+	void setRow(size_t row, Fields ... values)
+	{
+		this->setRow(row, std::index_sequence_for<Fields...>(), values...);
+	}
+
+	//whole field as one contiguous array, what scans should loop over
+	template<size_t I>
+	std::vector<FieldType<I>>& column()
+	{
+		return std::get<I>(this->columns);
+	}
+
+	template<size_t I>
+	const std::vector<FieldType<I>>& column() const
+	{
+		return std::get<I>(this->columns);
+	}
+
+	size_t size() const
+	{
+		return this->rows;
+	}
+
+	/************************************************
+	 *  MUTATORS
+	 ***********************************************/
+	//new rows are value initialized
+	void resize(size_t rows)
+	{
+		this->rows = rows;
+		this->forEachColumn([rows](auto &col)
+		{	col.resize(rows);});
+	}
+
+	void reserve(size_t rows)
+	{
+		this->forEachColumn([rows](auto &col)
+		{	col.reserve(rows);});
+	}
+
+	void resetRow(size_t row)
+	{
+		this->forEachColumn([row](auto &col)
+		{	col[row] = typename std::decay<decltype(col)>::type::value_type();});
+	}
+
+	void copyRow(size_t from, size_t to)
+	{
+		this->forEachColumn([from, to](auto &col)
+		{	col[to] = col[from];});
+	}
+
+	//row i becomes what row order[i] was, rows order does not list are dropped
+	void permuteRows(const std::vector<grabIndex> &order)
+	{
+		this->rows = order.size();
+		this->forEachColumn([&order](auto &col)
+		{
+			typename std::decay<decltype(col)>::type moved(order.size());
+			for (size_t i = 0; i < order.size(); i++)
+				moved[i] = std::move(col[order[i]]);
+			col.swap(moved);
+		});
+	}
+
+	/************************************************
+	 *  HELPING FUNCTIONS
+	 ***********************************************/
+	void addFootprint(Footprint &footprint) const
+	{
+		const_cast<ColumnStore*>(this)->forEachColumn([&footprint](auto &col)
+		{	addVectorBytes(col, footprint.payloadBytes, footprint.slackBytes);});
+	}
+
+private:
+	size_t rows = 0;
+	std::tuple<std::vector<Fields>...> columns;
+
+	template<class F>
+	void forEachColumn(F func)
+	{
+		std::apply([&func](auto &... cols)
+		{	(func(cols), ...);}, this->columns);
+	}
+
+	template<size_t ... I>
+	void setRow(size_t row, std::index_sequence<I...>, Fields ... values)
+	{
+		((std::get<I>(this->columns)[row] = values), ...);
+	}
+};
+
+/************************************************
+ *  TRAITS
+ ***********************************************/
+//no payload unless someone asks for one
+template<class T>
+struct NodePayload
+{
+	typedef ColumnStore<> columns;
+};
+
+template<class T>
+struct EdgePayload
+{
+	typedef ColumnStore<> columns;
+};
+
+/************************************************
+ *  SCANS
+ ***********************************************/
+
+/* Rows where both live[row] and predicate(row) hold. The predicate should only
+ * index into columns it captured, then the first loop is branch free and the
+ * compiler can vectorize it, the second one just compacts the hits.
+ */
+template<class Predicate>
+std::vector<grabIndex> selectRows(const std::vector<unsigned char> &live,
+		Predicate predicate)
+{
+	const size_t rowCount = live.size();
+	std::vector<unsigned char> hits(rowCount);
+	for (size_t row = 0; row < rowCount; row++)
+		hits[row] = live[row] & (unsigned char) (predicate(row) ? 1 : 0);
+	std::vector<grabIndex> selected;
+	for (size_t row = 0; row < rowCount; row++)
+		if (hits[row])
+			selected.push_back((grabIndex) row);
+	return selected;
+}
+
+#endif /* INC_STRUCTURE_PAYLOAD_H_ */
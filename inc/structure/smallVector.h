@@ -0,0 +1,296 @@
+/**
+ * @file smallVector.h
+ * @brief Vector that keeps its first few elements inside itself.
+ *
+ *	Almost every atom has four bonds or fewer, so a Node's edge lists stay in the
+ *	inline buffer and never touch the heap, hubs spill over to a heap block like a
+ *	std::vector would. Only the parts of the std::vector interface our edge lists
+ *	use are here. Iterators are plain pointers and, same as std::vector, any
+ *	insertion may invalidate them (including going from inline to heap).
+ */
+
+#ifndef INC_STRUCTURE_SMALLVECTOR_H_
+#define INC_STRUCTURE_SMALLVECTOR_H_
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include "../instrument/footprint.h"
+
+template<class V, unsigned int N>
+class SmallVector
+{
+	static_assert(N > 0, "use std::vector when nothing should be inline");
+public:
+	typedef V value_type;
+	typedef V* iterator;
+	typedef const V* const_iterator;
+
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	SmallVector() :
+			items(this->inlineItems()), count(0), room(N)
+	{
+	}
+
+	SmallVector(const SmallVector &other) :
+			SmallVector()
+	{
+		this->reserve(other.count);
+		for (const V &item : other)
+			this->push_back(item);
+	}
+
+	//a heap block is handed over, inline items have to be moved one by one
+	SmallVector(SmallVector &&other) :
+			SmallVector()
+	{
+		this->take(std::move(other));
+	}
+
+	~SmallVector()
+	{
+		this->clear();
+		this->release();
+	}
+
+	SmallVector& operator=(const SmallVector &other)
+	{
+		if (this != &other)
+		{
+			this->clear();
+			this->reserve(other.count);
+			for (const V &item : other)
+				this->push_back(item);
+		}
+		return *this;
+	}
+
+	SmallVector& operator=(SmallVector &&other)
+	{
+		if (this != &other)
+		{
+			this->clear();
+			this->release();
+			this->take(std::move(other));
+		}
+		return *this;
+	}
+
+	/************************************************
+	 *  GETTER/SETTER PAIRS
+	 ***********************************************/
+	size_t size() const
+	{
+		return this->count;
+	}
+
+	size_t capacity() const
+	{
+		return this->room;
+	}
+
+	bool empty() const
+	{
+		return this->count == 0;
+	}
+
+	//false once we spilled to the heap
+	bool isInline() const
+	{
+		return this->items == this->inlineItems();
+	}
+
+	V& operator[](size_t i)
+	{
+		return this->items[i];
+	}
+
+	const V& operator[](size_t i) const
+	{
+		return this->items[i];
+	}
+
+	V& back()
+	{
+		return this->items[this->count - 1];
+	}
+
+	const V& back() const
+	{
+		return this->items[this->count - 1];
+	}
+
+	V* data()
+	{
+		return this->items;
+	}
+
+	const V* data() const
+	{
+		return this->items;
+	}
+
+	iterator begin()
+	{
+		return this->items;
+	}
+
+	iterator end()
+	{
+		return this->items + this->count;
+	}
+
+	const_iterator begin() const
+	{
+		return this->items;
+	}
+
+	const_iterator end() const
+	{
+		return this->items + this->count;
+	}
+
+	/************************************************
+	 *  MUTATORS
+	 ***********************************************/
+	void push_back(const V &item)
+	{
+		this->emplace_back(item);
+	}
+
+	void push_back(V &&item)
+	{
+		this->emplace_back(std::move(item));
+	}
+
+	template<class ... Args>
+	V& emplace_back(Args &&... args)
+	{
+		if (this->count == this->room)
+		{
+			//build it first, args may point into our own storage
+			V fresh(std::forward<Args>(args)...);
+			this->grow(this->room * 2);
+			new (this->items + this->count) V(std::move(fresh));
+		}
+		else
+			new (this->items + this->count) V(std::forward<Args>(args)...);
+		return this->items[this->count++];
+	}
+
+	iterator erase(iterator first, iterator last)
+	{
+		if (first == last)
+			return first;
+		iterator to = first;
+		for (iterator from = last; from != this->end(); from++, to++)
+			*to = std::move(*from);
+		for (iterator dead = to; dead != this->end(); dead++)
+			dead->~V();
+		this->count = (unsigned int) (to - this->items);
+		return first;
+	}
+
+	iterator erase(iterator position)
+	{
+		return this->erase(position, position + 1);
+	}
+
+	//new slots are value initialized
+	void resize(size_t size)
+	{
+		if (size > this->room)
+			this->grow(size);
+		while (this->count > size)
+			this->items[--this->count].~V();
+		while (this->count < size)
+			new (this->items + this->count++) V();
+	}
+
+	void reserve(size_t size)
+	{
+		if (size > this->room)
+			this->grow(size);
+	}
+
+	void clear()
+	{
+		while (this->count > 0)
+			this->items[--this->count].~V();
+	}
+
+private:
+	alignas(V) unsigned char buffer[N * sizeof(V)];
+	V *items;
+	unsigned int count;
+	unsigned int room;
+
+	V* inlineItems()
+	{
+		return reinterpret_cast<V*>(this->buffer);
+	}
+
+	const V* inlineItems() const
+	{
+		return reinterpret_cast<const V*>(this->buffer);
+	}
+
+	void grow(size_t size)
+	{
+		V *fresh = static_cast<V*>(::operator new(size * sizeof(V)));
+		for (unsigned int i = 0; i < this->count; i++)
+		{
+			new (fresh + i) V(std::move(this->items[i]));
+			this->items[i].~V();
+		}
+		this->release();
+		this->items = fresh;
+		this->room = (unsigned int) size;
+	}
+
+	//frees a heap block, elements must already be gone or moved out
+	void release()
+	{
+		if (!this->isInline())
+			::operator delete(this->items);
+		this->items = this->inlineItems();
+		this->room = N;
+	}
+
+	//we must be empty and back on our inline buffer
+	void take(SmallVector &&other)
+	{
+		if (other.isInline())
+		{
+			for (unsigned int i = 0; i < other.count; i++)
+				new (this->items + i) V(std::move(other.items[i]));
+			this->count = other.count;
+			other.clear();
+			return;
+		}
+		this->items = other.items;
+		this->count = other.count;
+		this->room = other.room;
+		other.items = other.inlineItems();
+		other.count = 0;
+		other.room = N;
+	}
+};
+
+/************************************************
+ *  FOOTPRINT
+ ***********************************************/
+//inline items live in the owning object (already counted there), only a spilled block is extra
+template<class V, unsigned int N>
+void addVectorBytes(const SmallVector<V, N> &vec, size_t &used, size_t &slack)
+{
+	if (vec.isInline())
+		return;
+	used += vec.size() * sizeof(V);
+	slack += (vec.capacity() - vec.size()) * sizeof(V);
+}
+
+#endif /* INC_STRUCTURE_SMALLVECTOR_H_ */
@@ -0,0 +1,320 @@
+/**
+ * @file snapshot.h
+ * @brief Read-only dense (CSR) adjacency of a Graph for our algorithms to run on.
+ *
+ *	Walking shared_ptr/unique_ptr edge lists is fine for editing but slow for
+ *	anything that touches every edge many times. A Snapshot copies the structure
+ *	once into flat arrays indexed by the graph's dense node ids: for node v its
+ *	neighbors are targets[offsets[v] .. offsets[v + 1]), sorted ascending with
+ *	duplicates (parallel edges) folded, and the graph's edge id next to each one.
+ *
+ *	Unless the tag type is Directed (see direction.h) children and parents are
+ *	both neighbors, same as Node::getNeighbors(). Directed snapshots only list a
+ *	node's children, so traversals follow edges from source to sink. A snapshot
+ *	does not follow later edits, take a new one.
+ *
+ *	Anything with getNodeCount(), isLive() and forEachNeighbor() can be traversed
+ *	by our algorithms, a Snapshot is the reference implementation of that. The
+ *	Direction typedef tells algorithms whether rows are symmetric.
+ */
+
+#ifndef INC_STRUCTURE_SNAPSHOT_H_
+#define INC_STRUCTURE_SNAPSHOT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "node.h"
+#include "edge.h"
+#include "graph.h"
+#include "direction.h"
+
+template<class T, class E>
+class Snapshot
+{
+public:
+	typedef typename EdgeDirection<E>::policy Direction;
+
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	Snapshot();
+	explicit Snapshot(Graph<T, E> &graph);
+
+	/************************************************
+	 *  GETTER/SETTER PAIRS
+	 ***********************************************/
+	//one past the largest node id, free ids are present but not live and have no neighbors
+	unsigned int getNodeCount() const;
+	unsigned int getLiveCount() const;
+	bool isLive(unsigned int node) const;
+
+	//distinct edges, parallel edges count once (per direction when Directed)
+	size_t getEdgeCount() const;
+	unsigned int getEdgeIdBound() const;
+
+	unsigned int getDegree(unsigned int node) const;
+	const unsigned int* neighborsBegin(unsigned int node) const;
+	const unsigned int* neighborsEnd(unsigned int node) const;
+	const unsigned int* edgeIdsBegin(unsigned int node) const;
+
+	/************************************************
+	 *  TRAVERSAL
+	 ***********************************************/
+	/* func(neighbor, edgeId) for every neighbor in ascending id order. If func
+	 * returns bool, returning false stops the walk early.
+	 */
+	template<class F>
+	void forEachNeighbor(unsigned int node, F func) const
+	{
+		for (unsigned int i = this->offsets[node]; i < this->offsets[node + 1]; i++)
+		{
+			if constexpr (std::is_same<decltype(func(0u, 0u)), bool>::value)
+			{
+				if (!func(this->targets[i], this->edgeIds[i]))
+					return;
+			}
+			else
+				func(this->targets[i], this->edgeIds[i]);
+		}
+	}
+
+	bool isNeighbor(unsigned int nodeA, unsigned int nodeB) const;
+
+	/************************************************
+	 *  BITMAP ROWS
+	 ***********************************************/
+	/* One bit per node per row (n^2 / 8 bytes), worth it for dense queries on
+	 * graphs up to a few thousand nodes. Refuses (and returns false) past maxNodes.
+	 */
+	bool buildBitmapRows(unsigned int maxNodes = 8192);
+	bool hasBitmapRows() const;
+	unsigned int getWordsPerRow() const;
+	const std::uint64_t* bitmapRow(unsigned int node) const;
+
+private:
+	/************************************************
+	 *  STRUCTURE
+	 ***********************************************/
+	unsigned int nodeCount = 0;
+	unsigned int liveCount = 0;
+	unsigned int edgeIdBound = 0;
+	std::vector<unsigned char> live;
+	std::vector<unsigned int> offsets;
+	std::vector<unsigned int> targets;
+	std::vector<unsigned int> edgeIds;
+
+	unsigned int wordsPerRow = 0;
+	std::vector<std::uint64_t> bitmap;
+};
+
+/************************************************
+ *  CONSTRUCTORS/DESTRUCTORS
+ ***********************************************/
+
+template<class T, class E>
+Snapshot<T, E>::Snapshot()
+{
+	this->offsets.push_back(0);
+}
+
+template<class T, class E>
+Snapshot<T, E>::Snapshot(Graph<T, E> &graph)
+{
+	PhaseTimer timer("snapshot");
+	graph.syncEdgeIds();
+	//our rows are 32 bit, wide graph ids (see ids.h) have to fit them
+	if constexpr (sizeof(grabIndex) > sizeof(unsigned int))
+		if (graph.getNodeIdBound() > std::numeric_limits<unsigned int>::max()
+				|| graph.getEdgeIdBound() > std::numeric_limits<unsigned int>::max())
+		{
+			badBehavior(__LINE__, __func__,
+					"Warning: graph (" + graph.getName()
+							+ ") has too many ids for a snapshot");
+			this->offsets.push_back(0);
+			return;
+		}
+	this->nodeCount = (unsigned int) graph.getNodeIdBound();
+	this->edgeIdBound = (unsigned int) graph.getEdgeIdBound();
+	this->live.assign(this->nodeCount, 0);
+
+	//each edge shows up in the rows of both of its ends, only its source's when Directed
+	std::vector<unsigned int> degree(this->nodeCount + 1, 0);
+	for (unsigned int id = 0; id < this->edgeIdBound; id++)
+	{
+		Edge<E> *edge = graph.getEdgeById(id);
+		if (!edge)
+			continue;
+		degree[graph.getNodeId(edge->sourceNode.get())]++;
+		if constexpr (!std::is_same<Direction, Directed>::value)
+			degree[graph.getNodeId(edge->sinkNode.get())]++;
+	}
+	this->offsets.assign(this->nodeCount + 1, 0);
+	for (unsigned int v = 0; v < this->nodeCount; v++)
+		this->offsets[v + 1] = this->offsets[v] + degree[v];
+
+	std::vector<std::pair<unsigned int, unsigned int>> entries(
+			this->offsets[this->nodeCount]);
+	std::vector<unsigned int> fill(this->offsets.begin(), this->offsets.end() - 1);
+	for (unsigned int id = 0; id < this->edgeIdBound; id++)
+	{
+		Edge<E> *edge = graph.getEdgeById(id);
+		if (!edge)
+			continue;
+		unsigned int source = (unsigned int) graph.getNodeId(
+				edge->sourceNode.get());
+		unsigned int sink = (unsigned int) graph.getNodeId(edge->sinkNode.get());
+		entries[fill[source]++] = std::make_pair(sink, id);
+		if constexpr (!std::is_same<Direction, Directed>::value)
+			entries[fill[sink]++] = std::make_pair(source, id);
+	}
+
+	//sort each row, fold parallel edges and compact in place
+	unsigned int written = 0;
+	for (unsigned int v = 0; v < this->nodeCount; v++)
+	{
+		this->live[v] = graph.isNodeIdLive(v);
+		this->liveCount += this->live[v];
+		unsigned int begin = this->offsets[v], end = this->offsets[v + 1];
+		std::sort(entries.begin() + begin, entries.begin() + end);
+		this->offsets[v] = written;
+		for (unsigned int i = begin; i < end; i++)
+		{
+			if (i > begin && entries[i].first == entries[i - 1].first)
+				continue;
+			entries[written++] = entries[i];
+		}
+	}
+	this->offsets[this->nodeCount] = written;
+	this->targets.resize(written);
+	this->edgeIds.resize(written);
+	for (unsigned int i = 0; i < written; i++)
+	{
+		this->targets[i] = entries[i].first;
+		this->edgeIds[i] = entries[i].second;
+	}
+}
+
+/************************************************
+ *  GETTER/SETTER PAIRS
+ ***********************************************/
+
+template<class T, class E>
+unsigned int Snapshot<T, E>::getNodeCount() const
+{
+	return this->nodeCount;
+}
+
+template<class T, class E>
+unsigned int Snapshot<T, E>::getLiveCount() const
+{
+	return this->liveCount;
+}
+
+template<class T, class E>
+bool Snapshot<T, E>::isLive(unsigned int node) const
+{
+	return this->live[node];
+}
+
+template<class T, class E>
+size_t Snapshot<T, E>::getEdgeCount() const
+{
+	if constexpr (std::is_same<Direction, Directed>::value)
+		return this->targets.size();
+	return this->targets.size() / 2;
+}
+
+template<class T, class E>
+unsigned int Snapshot<T, E>::getEdgeIdBound() const
+{
+	return this->edgeIdBound;
+}
+
+template<class T, class E>
+unsigned int Snapshot<T, E>::getDegree(unsigned int node) const
+{
+	return this->offsets[node + 1] - this->offsets[node];
+}
+
+template<class T, class E>
+const unsigned int* Snapshot<T, E>::neighborsBegin(unsigned int node) const
+{
+	return this->targets.data() + this->offsets[node];
+}
+
+template<class T, class E>
+const unsigned int* Snapshot<T, E>::neighborsEnd(unsigned int node) const
+{
+	return this->targets.data() + this->offsets[node + 1];
+}
+
+template<class T, class E>
+const unsigned int* Snapshot<T, E>::edgeIdsBegin(unsigned int node) const
+{
+	return this->edgeIds.data() + this->offsets[node];
+}
+
+/************************************************
+ *  TRAVERSAL
+ ***********************************************/
+
+template<class T, class E>
+bool Snapshot<T, E>::isNeighbor(unsigned int nodeA, unsigned int nodeB) const
+{
+	if (this->hasBitmapRows())
+		return (this->bitmapRow(nodeA)[nodeB / 64] >> (nodeB % 64)) & 1;
+	return std::binary_search(this->neighborsBegin(nodeA),
+			this->neighborsEnd(nodeA), nodeB);
+}
+
+/************************************************
+ *  BITMAP ROWS
+ ***********************************************/
+
+template<class T, class E>
+bool Snapshot<T, E>::buildBitmapRows(unsigned int maxNodes)
+{
+	if (this->nodeCount > maxNodes)
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: too many nodes for bitmap rows ("
+						+ std::to_string(this->nodeCount) + ")");
+		return false;
+	}
+	//rounded up to 4 words so the AVX2 kernels never need a tail
+	this->wordsPerRow = ((this->nodeCount + 255) / 256) * 4;
+	this->bitmap.assign((size_t) this->wordsPerRow * this->nodeCount, 0);
+	for (unsigned int v = 0; v < this->nodeCount; v++)
+	{
+		std::uint64_t *row = this->bitmap.data() + (size_t) v * this->wordsPerRow;
+		for (const unsigned int *w = this->neighborsBegin(v);
+				w != this->neighborsEnd(v); w++)
+			row[*w / 64] |= std::uint64_t(1) << (*w % 64);
+	}
+	return true;
+}
+
+template<class T, class E>
+bool Snapshot<T, E>::hasBitmapRows() const
+{
+	return !this->bitmap.empty();
+}
+
+template<class T, class E>
+unsigned int Snapshot<T, E>::getWordsPerRow() const
+{
+	return this->wordsPerRow;
+}
+
+template<class T, class E>
+const std::uint64_t* Snapshot<T, E>::bitmapRow(unsigned int node) const
+{
+	return this->bitmap.data() + (size_t) node * this->wordsPerRow;
+}
+
+#endif /* INC_STRUCTURE_SNAPSHOT_H_ */
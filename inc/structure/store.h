@@ -0,0 +1,915 @@
+/**
+ * @file store.h
+ * @brief Read-only graph library in shared memory (or a mapped file).
+ *
+ *	Workers on one host that each load the same reference library pay for it
+ *	once per process. Here one loader puts the graphs into a StoreWriter (each is
+ *	flattened the way a Snapshot is, plus its node names and labels) and writes
+ *	them out once, into a file or a POSIX shared memory object. Every worker
+ *	then attaches a GraphStore, which maps it read-only: nothing is parsed or
+ *	copied, the pages are the same physical memory in every process, so
+ *	attaching is instant and the library is in RAM once per host.
+ *
+ *	A StoredGraph is traversable like a Snapshot (same ids, same rows), so bfs,
+ *	components, blocks and friends run on it directly. Bitmap rows are not
+ *	stored. Strings (graph names, node names, labels) are interned into one
+ *	sorted table, a worker looks a label up once (findString()) and compares
+ *	ids from then on. StoredLabels answers the label queries of a Graph's label
+ *	index that way, so pattern matching (match.h) runs on stored graphs too.
+ *
+ *	The layout is flat arrays at 8 byte aligned offsets from the start of the
+ *	mapping, no pointers, so it maps anywhere. It is in host byte order and
+ *	only meant for the host that wrote it.
+ */
+
+#ifndef INC_STRUCTURE_STORE_H_
+#define INC_STRUCTURE_STORE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../lazyPrints.h"
+#include "../instrument/counters.h"
+#include "direction.h"
+#include "graph.h"
+#include "snapshot.h"
+
+static_assert(sizeof(unsigned int) == 4, "stored rows are 32 bit");
+
+//findString() of a string that is not in the store
+const std::uint32_t noString = (std::uint32_t) -1;
+
+/************************************************
+ *  LAYOUT
+ ***********************************************/
+const char storeMagic[8] = { 'G', 'R', 'A', 'B', 'S', 'T', 'O', 'R' };
+const std::uint32_t storeVersion = 1;
+
+//offsets are bytes from the start of the mapping
+struct StoreHeader
+{
+	char magic[8]; //written last, a half written store does not attach
+	std::uint32_t version;
+	std::uint32_t graphCount;
+	std::uint64_t totalBytes;
+	std::uint64_t graphsAt; //StoredGraphRecord per graph
+	std::uint64_t graphsByNameAt; //graph indexes sorted by name
+	std::uint64_t stringCount;
+	std::uint64_t stringOffsetsAt; //stringCount + 1 offsets into the chars
+	std::uint64_t charsAt;
+};
+
+struct StoredGraphRecord
+{
+	std::uint32_t name;
+	std::uint32_t directed;
+	std::uint32_t nodeCount;
+	std::uint32_t liveCount;
+	std::uint32_t edgeIdBound;
+	std::uint32_t entryCount; //row entries, targets and edge ids each have this many
+	std::uint32_t labelCount; //label entries over all nodes
+	std::uint32_t unused;
+	std::uint64_t liveAt; //unsigned char per node
+	std::uint64_t offsetsAt; //nodeCount + 1
+	std::uint64_t targetsAt;
+	std::uint64_t edgeIdsAt;
+	std::uint64_t nodeNamesAt; //string id per node, noString for ids that are not live
+	std::uint64_t labelOffsetsAt; //nodeCount + 1
+	std::uint64_t labelsAt; //string ids, ascending per node
+};
+
+inline std::uint64_t storeAlign(std::uint64_t offset)
+{
+	return (offset + 7) & ~std::uint64_t(7);
+}
+
+class GraphStore;
+
+/************************************************
+ *  STORED GRAPH
+ ***********************************************/
+//a view into a GraphStore, cheap to copy, only valid while the store stays attached
+template<class E>
+class StoredGraph
+{
+	friend class GraphStore;
+public:
+	typedef typename EdgeDirection<E>::policy Direction;
+
+	//empty, what GraphStore::getGraph() hands back when it refuses
+	StoredGraph()
+	{
+	}
+
+	/************************************************
+	 *  GETTER/SETTER PAIRS
+	 ***********************************************/
+	std::string_view getName() const;
+
+	unsigned int getNodeCount() const;
+	unsigned int getLiveCount() const;
+	bool isLive(unsigned int node) const;
+
+	size_t getEdgeCount() const;
+	unsigned int getEdgeIdBound() const;
+
+	unsigned int getDegree(unsigned int node) const;
+	const unsigned int* neighborsBegin(unsigned int node) const;
+	const unsigned int* neighborsEnd(unsigned int node) const;
+	const unsigned int* edgeIdsBegin(unsigned int node) const;
+
+	std::string_view getNodeName(unsigned int node) const;
+	//string ids, ascending, see GraphStore::findString()
+	const std::uint32_t* labelsBegin(unsigned int node) const;
+	const std::uint32_t* labelsEnd(unsigned int node) const;
+	bool hasLabel(unsigned int node, std::uint32_t label) const;
+	//findString() of our store, noString when no node can have it
+	std::uint32_t findLabel(std::string_view label) const;
+
+	/************************************************
+	 *  TRAVERSAL
+	 ***********************************************/
+	//same contract as Snapshot::forEachNeighbor()
+	template<class F>
+	void forEachNeighbor(unsigned int node, F func) const
+	{
+		for (unsigned int i = this->offsets[node]; i < this->offsets[node + 1]; i++)
+		{
+			if constexpr (std::is_same<decltype(func(0u, 0u)), bool>::value)
+			{
+				if (!func(this->targets[i], this->edgeIds[i]))
+					return;
+			}
+			else
+				func(this->targets[i], this->edgeIds[i]);
+		}
+	}
+
+	bool isNeighbor(unsigned int nodeA, unsigned int nodeB) const;
+
+private:
+	/************************************************
+	 *  STRUCTURE
+	 ***********************************************/
+	const GraphStore *store = nullptr;
+	const StoredGraphRecord *record = nullptr;
+	const unsigned char *live = nullptr;
+	const unsigned int *offsets = nullptr;
+	const unsigned int *targets = nullptr;
+	const unsigned int *edgeIds = nullptr;
+	const std::uint32_t *nodeNames = nullptr;
+	const std::uint32_t *labelOffsets = nullptr;
+	const std::uint32_t *labels = nullptr;
+};
+
+/************************************************
+ *  STORE
+ ***********************************************/
+class GraphStore
+{
+public:
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	GraphStore()
+	{
+	}
+
+	//the mapping is ours alone, StoredGraphs point into it
+	GraphStore(const GraphStore&) = delete;
+	GraphStore& operator=(const GraphStore&) = delete;
+
+	~GraphStore()
+	{
+		this->detach();
+	}
+
+	/************************************************
+	 *  ATTACHING
+	 ***********************************************/
+	bool attachFile(const std::string &path)
+	{
+		return this->attach(open(path.c_str(), O_RDONLY), path);
+	}
+
+	//name as for shm_open(), i.e. "/grab_library"
+	bool attachShared(const std::string &name)
+	{
+		return this->attach(shm_open(name.c_str(), O_RDONLY, 0), name);
+	}
+
+	void detach()
+	{
+		if (this->base)
+			munmap((void*) this->base, this->bytes);
+		this->base = nullptr;
+		this->bytes = 0;
+	}
+
+	bool isAttached() const
+	{
+		return this->base != nullptr;
+	}
+
+	//the object goes once the last process detaches, attached workers keep their mapping
+	static bool removeShared(const std::string &name)
+	{
+		return shm_unlink(name.c_str()) == 0;
+	}
+
+	/************************************************
+	 *  GETTER/SETTER PAIRS
+	 ***********************************************/
+	size_t getBytes() const
+	{
+		return this->bytes;
+	}
+
+	unsigned int getGraphCount() const
+	{
+		return this->base ? this->header()->graphCount : 0;
+	}
+
+	//E has to have the direction the graph was written with
+	template<class E>
+	StoredGraph<E> getGraph(unsigned int index) const;
+
+	//index of the graph named name, getGraphCount() if there is none
+	unsigned int findGraph(const std::string &name) const
+	{
+		std::uint32_t id = this->findString(name);
+		if (id == noString)
+			return this->getGraphCount();
+		const std::uint32_t *byName = this->at<std::uint32_t>(
+				this->header()->graphsByNameAt);
+		const std::uint32_t *end = byName + this->getGraphCount();
+		const std::uint32_t *found = std::lower_bound(byName, end, id,
+				[this](std::uint32_t graph, std::uint32_t name)
+				{	return this->record(graph)->name < name;});
+		return (found != end && this->record(*found)->name == id) ?
+				*found : this->getGraphCount();
+	}
+
+	//the table is sorted, so this is a binary search over the mapping
+	std::uint32_t findString(std::string_view text) const
+	{
+		if (!this->base)
+			return noString;
+		std::uint32_t low = 0, high = (std::uint32_t) this->header()->stringCount;
+		while (low < high)
+		{
+			std::uint32_t middle = low + (high - low) / 2;
+			if (this->getString(middle) < text)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+		return (low < this->header()->stringCount && this->getString(low) == text) ?
+				low : noString;
+	}
+
+	std::string_view getString(std::uint32_t id) const
+	{
+		if (id == noString)
+			return std::string_view();
+		const std::uint64_t *offsets = this->at<std::uint64_t>(
+				this->header()->stringOffsetsAt);
+		return std::string_view(
+				this->at<char>(this->header()->charsAt) + offsets[id],
+				offsets[id + 1] - offsets[id]);
+	}
+
+private:
+	const unsigned char *base = nullptr;
+	size_t bytes = 0;
+
+	/************************************************
+	 *  HELPER FUNCTIONS
+	 ***********************************************/
+	const StoreHeader* header() const
+	{
+		return reinterpret_cast<const StoreHeader*>(this->base);
+	}
+
+	template<class V>
+	const V* at(std::uint64_t offset) const
+	{
+		return reinterpret_cast<const V*>(this->base + offset);
+	}
+
+	const StoredGraphRecord* record(unsigned int index) const
+	{
+		return this->at<StoredGraphRecord>(this->header()->graphsAt) + index;
+	}
+
+	bool fits(std::uint64_t offset, std::uint64_t length) const
+	{
+		return offset <= this->bytes && length <= this->bytes - offset;
+	}
+
+	//takes over fd, closes it either way
+	bool attach(int fd, const std::string &where)
+	{
+		this->detach();
+		if (fd < 0)
+		{
+			badBehavior(__LINE__, __func__, "Warning: can not open store " + where);
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(StoreHeader))
+		{
+			close(fd);
+			badBehavior(__LINE__, __func__,
+					"Warning: " + where + " is too small to be a store");
+			return false;
+		}
+		void *mapped = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED,
+				fd, 0);
+		close(fd);
+		if (mapped == MAP_FAILED)
+		{
+			badBehavior(__LINE__, __func__, "Warning: can not map store " + where);
+			return false;
+		}
+		this->base = static_cast<const unsigned char*>(mapped);
+		this->bytes = (size_t) info.st_size;
+		if (!this->validate())
+		{
+			this->detach();
+			badBehavior(__LINE__, __func__,
+					"Warning: " + where + " is not a finished store of version "
+							+ std::to_string(storeVersion));
+			return false;
+		}
+		return true;
+	}
+
+	//the mapping is page aligned, so an aligned offset is an aligned address
+	static bool aligned(std::uint64_t offset, std::uint64_t alignment)
+	{
+		return offset % alignment == 0;
+	}
+
+	//offsets[0] is 0, they never go down and the last one is at most bound
+	template<class V>
+	static bool ascending(const V *offsets, std::uint64_t count, std::uint64_t bound)
+	{
+		if (offsets[0] != 0)
+			return false;
+		for (std::uint64_t i = 0; i < count; i++)
+			if (offsets[i + 1] < offsets[i])
+				return false;
+		return offsets[count] <= bound;
+	}
+
+	/* The tables everything hangs off and the string table, each graph is checked
+	 * when it is asked for. Whatever a corrupt or cut off store says, nothing we
+	 * hand out reads outside the mapping.
+	 */
+	bool validate() const
+	{
+		const StoreHeader *head = this->header();
+		if (std::memcmp(head->magic, storeMagic, sizeof(storeMagic)) != 0)
+			return false;
+		//pairs with the writer's fence before the magic
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (head->version != storeVersion || head->totalBytes != this->bytes)
+			return false;
+		if (!aligned(head->graphsAt, 8) || !aligned(head->graphsByNameAt, 4)
+				|| !aligned(head->stringOffsetsAt, 8)
+				|| head->stringCount >= this->bytes / sizeof(std::uint64_t))
+			return false;
+		if (!this->fits(head->graphsAt,
+				head->graphCount * sizeof(StoredGraphRecord))
+				|| !this->fits(head->graphsByNameAt,
+						head->graphCount * sizeof(std::uint32_t))
+				|| !this->fits(head->stringOffsetsAt,
+						(head->stringCount + 1) * sizeof(std::uint64_t))
+				|| !this->fits(head->charsAt, 0))
+			return false;
+		const std::uint64_t *offsets = this->at<std::uint64_t>(
+				head->stringOffsetsAt);
+		if (!ascending(offsets, head->stringCount, this->bytes - head->charsAt))
+			return false;
+		const std::uint32_t *byName = this->at<std::uint32_t>(head->graphsByNameAt);
+		for (std::uint32_t g = 0; g < head->graphCount; g++)
+			if (byName[g] >= head->graphCount
+					|| this->record(g)->name >= head->stringCount)
+				return false;
+		return true;
+	}
+
+	//bounds, alignment and every id in the rows, names and labels
+	template<class E>
+	bool wholeGraph(const StoredGraphRecord *stored) const
+	{
+		const std::uint64_t nodes = stored->nodeCount;
+		const std::uint64_t strings = this->header()->stringCount;
+		if (!aligned(stored->offsetsAt, 4) || !aligned(stored->targetsAt, 4)
+				|| !aligned(stored->edgeIdsAt, 4) || !aligned(stored->nodeNamesAt, 4)
+				|| !aligned(stored->labelOffsetsAt, 4) || !aligned(stored->labelsAt, 4))
+			return false;
+		if (!this->fits(stored->liveAt, nodes)
+				|| !this->fits(stored->offsetsAt, (nodes + 1) * 4)
+				|| !this->fits(stored->targetsAt, stored->entryCount * 4ull)
+				|| !this->fits(stored->edgeIdsAt, stored->entryCount * 4ull)
+				|| !this->fits(stored->nodeNamesAt, nodes * 4)
+				|| !this->fits(stored->labelOffsetsAt, (nodes + 1) * 4)
+				|| !this->fits(stored->labelsAt, stored->labelCount * 4ull))
+			return false;
+		if (!ascending(this->at<unsigned int>(stored->offsetsAt), nodes,
+				stored->entryCount)
+				|| !ascending(this->at<std::uint32_t>(stored->labelOffsetsAt), nodes,
+						stored->labelCount))
+			return false;
+		const unsigned int *targets = this->at<unsigned int>(stored->targetsAt);
+		const unsigned int *edgeIds = this->at<unsigned int>(stored->edgeIdsAt);
+		for (std::uint32_t i = 0; i < stored->entryCount; i++)
+			if (targets[i] >= nodes || edgeIds[i] >= stored->edgeIdBound)
+				return false;
+		const std::uint32_t *names = this->at<std::uint32_t>(stored->nodeNamesAt);
+		for (std::uint64_t v = 0; v < nodes; v++)
+			if (names[v] != noString && names[v] >= strings)
+				return false;
+		const std::uint32_t *labels = this->at<std::uint32_t>(stored->labelsAt);
+		for (std::uint32_t i = 0; i < stored->labelCount; i++)
+			if (labels[i] >= strings)
+				return false;
+		return stored->liveCount <= stored->nodeCount;
+	}
+};
+
+template<class E>
+StoredGraph<E> GraphStore::getGraph(unsigned int index) const
+{
+	StoredGraph<E> graph;
+	if (index >= this->getGraphCount())
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: no stored graph " + std::to_string(index));
+		return graph;
+	}
+	const StoredGraphRecord *stored = this->record(index);
+	if ((stored->directed != 0)
+			!= std::is_same<typename StoredGraph<E>::Direction, Directed>::value)
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: stored graph " + std::string(this->getString(stored->name))
+						+ " was written with another direction");
+		return graph;
+	}
+	if (!this->wholeGraph<E>(stored))
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: stored graph " + std::to_string(index)
+						+ " runs past the end of the store");
+		return graph;
+	}
+	graph.store = this;
+	graph.record = stored;
+	graph.live = this->at<unsigned char>(stored->liveAt);
+	graph.offsets = this->at<unsigned int>(stored->offsetsAt);
+	graph.targets = this->at<unsigned int>(stored->targetsAt);
+	graph.edgeIds = this->at<unsigned int>(stored->edgeIdsAt);
+	graph.nodeNames = this->at<std::uint32_t>(stored->nodeNamesAt);
+	graph.labelOffsets = this->at<std::uint32_t>(stored->labelOffsetsAt);
+	graph.labels = this->at<std::uint32_t>(stored->labelsAt);
+	return graph;
+}
+
+/************************************************
+ *  WRITER
+ ***********************************************/
+class StoreWriter
+{
+public:
+	/************************************************
+	 *  MUTATORS
+	 ***********************************************/
+	//flattened right away, later edits to graph do not show up
+	template<class T, class E>
+	void addGraph(Graph<T, E> &graph);
+
+	size_t getGraphCount() const
+	{
+		return this->graphs.size();
+	}
+
+	/************************************************
+	 *  WRITING
+	 ***********************************************/
+	//written next to path and renamed over it, readers never see half a store
+	bool writeFile(const std::string &path)
+	{
+		std::string temporary = path + ".partial";
+		int fd = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (!this->writeTo(fd, temporary))
+		{
+			unlink(temporary.c_str());
+			return false;
+		}
+		if (rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			unlink(temporary.c_str());
+			badBehavior(__LINE__, __func__, "Warning: can not rename to " + path);
+			return false;
+		}
+		return true;
+	}
+
+	//replaces whatever was under name, workers still attached keep the old one
+	bool writeShared(const std::string &name)
+	{
+		shm_unlink(name.c_str());
+		if (this->writeTo(shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644),
+				name))
+			return true;
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+private:
+	struct Flattened
+	{
+		std::uint32_t name = 0;
+		bool directed = false;
+		unsigned int nodeCount = 0;
+		unsigned int liveCount = 0;
+		unsigned int edgeIdBound = 0;
+		std::vector<unsigned char> live;
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> targets;
+		std::vector<unsigned int> edgeIds;
+		std::vector<std::uint32_t> nodeNames;
+		std::vector<std::uint32_t> labelOffsets;
+		std::vector<std::uint32_t> labels;
+	};
+
+	std::vector<Flattened> graphs;
+	//ids in the order strings were first seen, sorted on the way out
+	std::unordered_map<std::string, std::uint32_t> stringIds;
+	std::vector<std::string> strings;
+
+	/************************************************
+	 *  HELPER FUNCTIONS
+	 ***********************************************/
+	std::uint32_t intern(const std::string &text)
+	{
+		auto found = this->stringIds.emplace(text,
+				(std::uint32_t) this->strings.size());
+		if (found.second)
+			this->strings.push_back(text);
+		return found.first->second;
+	}
+
+	//takes over fd, closes it either way
+	bool writeTo(int fd, const std::string &where);
+};
+
+template<class T, class E>
+void StoreWriter::addGraph(Graph<T, E> &graph)
+{
+	PhaseTimer timer("storeAddGraph");
+	Snapshot<T, E> snapshot(graph);
+	Flattened flat;
+	flat.name = this->intern(graph.getName());
+	flat.directed = std::is_same<typename Snapshot<T, E>::Direction, Directed>::value;
+	flat.nodeCount = snapshot.getNodeCount();
+	flat.liveCount = snapshot.getLiveCount();
+	flat.edgeIdBound = snapshot.getEdgeIdBound();
+	flat.live.resize(flat.nodeCount);
+	flat.offsets.push_back(0);
+	flat.nodeNames.assign(flat.nodeCount, noString);
+	flat.labelOffsets.push_back(0);
+	for (unsigned int v = 0; v < flat.nodeCount; v++)
+	{
+		flat.live[v] = snapshot.isLive(v);
+		flat.targets.insert(flat.targets.end(), snapshot.neighborsBegin(v),
+				snapshot.neighborsEnd(v));
+		flat.edgeIds.insert(flat.edgeIds.end(), snapshot.edgeIdsBegin(v),
+				snapshot.edgeIdsBegin(v) + snapshot.getDegree(v));
+		flat.offsets.push_back((unsigned int) flat.targets.size());
+		if (flat.live[v])
+		{
+			std::shared_ptr<Node<E>> node = graph.getNodeById(v);
+			flat.nodeNames[v] = this->intern(node->getName());
+			for (std::string const &label : node->getLabels())
+				flat.labels.push_back(this->intern(label));
+		}
+		flat.labelOffsets.push_back((std::uint32_t) flat.labels.size());
+	}
+	this->graphs.push_back(std::move(flat));
+}
+
+inline bool StoreWriter::writeTo(int fd, const std::string &where)
+{
+	if (fd < 0)
+	{
+		badBehavior(__LINE__, __func__, "Warning: can not create store " + where);
+		return false;
+	}
+	PhaseTimer timer("storeWrite");
+	//sorted table, old id -> new id
+	std::vector<std::uint32_t> order(this->strings.size());
+	for (std::uint32_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b)
+	{	return this->strings[a] < this->strings[b];});
+	std::vector<std::uint32_t> renamed(order.size());
+	for (std::uint32_t i = 0; i < order.size(); i++)
+		renamed[order[i]] = i;
+	auto sortedId = [&renamed](std::uint32_t id)
+	{	return (id == noString) ? noString : renamed[id];};
+
+	//where everything goes
+	StoreHeader head;
+	std::memset(&head, 0, sizeof(head));
+	head.version = storeVersion;
+	head.graphCount = (std::uint32_t) this->graphs.size();
+	head.stringCount = this->strings.size();
+	std::uint64_t end = storeAlign(sizeof(StoreHeader));
+	head.graphsAt = end;
+	end = storeAlign(end + this->graphs.size() * sizeof(StoredGraphRecord));
+	head.graphsByNameAt = end;
+	end = storeAlign(end + this->graphs.size() * sizeof(std::uint32_t));
+	head.stringOffsetsAt = end;
+	end = storeAlign(end + (this->strings.size() + 1) * sizeof(std::uint64_t));
+	head.charsAt = end;
+	for (std::string const &text : this->strings)
+		end += text.size();
+	std::vector<StoredGraphRecord> records(this->graphs.size());
+	for (size_t g = 0; g < this->graphs.size(); g++)
+	{
+		const Flattened &flat = this->graphs[g];
+		StoredGraphRecord &stored = records[g];
+		std::memset(&stored, 0, sizeof(stored));
+		stored.name = sortedId(flat.name);
+		stored.directed = flat.directed;
+		stored.nodeCount = flat.nodeCount;
+		stored.liveCount = flat.liveCount;
+		stored.edgeIdBound = flat.edgeIdBound;
+		stored.entryCount = (std::uint32_t) flat.targets.size();
+		stored.labelCount = (std::uint32_t) flat.labels.size();
+		auto place = [&end](std::uint64_t &at, size_t bytes)
+		{
+			at = end = storeAlign(end);
+			end += bytes;
+		};
+		place(stored.liveAt, flat.live.size());
+		place(stored.offsetsAt, flat.offsets.size() * 4);
+		place(stored.targetsAt, flat.targets.size() * 4);
+		place(stored.edgeIdsAt, flat.edgeIds.size() * 4);
+		place(stored.nodeNamesAt, flat.nodeNames.size() * 4);
+		place(stored.labelOffsetsAt, flat.labelOffsets.size() * 4);
+		place(stored.labelsAt, flat.labels.size() * 4);
+	}
+	head.totalBytes = storeAlign(end);
+
+	if (ftruncate(fd, (off_t) head.totalBytes) != 0)
+	{
+		close(fd);
+		badBehavior(__LINE__, __func__,
+				"Warning: can not size store " + where + " to "
+						+ std::to_string(head.totalBytes) + " bytes");
+		return false;
+	}
+	void *mapped = mmap(nullptr, head.totalBytes, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		badBehavior(__LINE__, __func__, "Warning: can not map store " + where);
+		return false;
+	}
+	unsigned char *base = static_cast<unsigned char*>(mapped);
+	auto put = [base](std::uint64_t at, const void *from, size_t bytes)
+	{
+		if (bytes)
+			std::memcpy(base + at, from, bytes);
+	};
+
+	put(head.graphsAt, records.data(), records.size() * sizeof(StoredGraphRecord));
+	std::vector<std::uint32_t> byName(records.size());
+	for (std::uint32_t g = 0; g < byName.size(); g++)
+		byName[g] = g;
+	std::stable_sort(byName.begin(), byName.end(),
+			[&records](std::uint32_t a, std::uint32_t b)
+			{	return records[a].name < records[b].name;});
+	put(head.graphsByNameAt, byName.data(), byName.size() * sizeof(std::uint32_t));
+	std::vector<std::uint64_t> stringOffsets(1, 0);
+	for (std::uint32_t id : order)
+	{
+		put(head.charsAt + stringOffsets.back(), this->strings[id].data(),
+				this->strings[id].size());
+		stringOffsets.push_back(stringOffsets.back() + this->strings[id].size());
+	}
+	put(head.stringOffsetsAt, stringOffsets.data(),
+			stringOffsets.size() * sizeof(std::uint64_t));
+
+	for (size_t g = 0; g < this->graphs.size(); g++)
+	{
+		const Flattened &flat = this->graphs[g];
+		const StoredGraphRecord &stored = records[g];
+		put(stored.liveAt, flat.live.data(), flat.live.size());
+		put(stored.offsetsAt, flat.offsets.data(), flat.offsets.size() * 4);
+		put(stored.targetsAt, flat.targets.data(), flat.targets.size() * 4);
+		put(stored.edgeIdsAt, flat.edgeIds.data(), flat.edgeIds.size() * 4);
+		std::uint32_t *names = reinterpret_cast<std::uint32_t*>(base
+				+ stored.nodeNamesAt);
+		for (size_t v = 0; v < flat.nodeNames.size(); v++)
+			names[v] = sortedId(flat.nodeNames[v]);
+		put(stored.labelOffsetsAt, flat.labelOffsets.data(),
+				flat.labelOffsets.size() * 4);
+		//per node ascending so hasLabel() can binary search
+		std::uint32_t *labels = reinterpret_cast<std::uint32_t*>(base
+				+ stored.labelsAt);
+		for (size_t i = 0; i < flat.labels.size(); i++)
+			labels[i] = sortedId(flat.labels[i]);
+		for (size_t v = 0; v + 1 < flat.labelOffsets.size(); v++)
+			std::sort(labels + flat.labelOffsets[v], labels + flat.labelOffsets[v + 1]);
+	}
+
+	//magic goes in last, until then attach() refuses us
+	std::memcpy(head.magic, storeMagic, sizeof(storeMagic));
+	std::memcpy(base + sizeof(head.magic), reinterpret_cast<unsigned char*>(&head)
+			+ sizeof(head.magic), sizeof(head) - sizeof(head.magic));
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(base, head.magic, sizeof(head.magic));
+	munmap(mapped, head.totalBytes);
+	return true;
+}
+
+/************************************************
+ *  STORED GRAPH
+ ***********************************************/
+
+template<class E>
+std::string_view StoredGraph<E>::getName() const
+{
+	return this->record ? this->store->getString(this->record->name) :
+							std::string_view();
+}
+
+template<class E>
+unsigned int StoredGraph<E>::getNodeCount() const
+{
+	return this->record ? this->record->nodeCount : 0;
+}
+
+template<class E>
+unsigned int StoredGraph<E>::getLiveCount() const
+{
+	return this->record ? this->record->liveCount : 0;
+}
+
+template<class E>
+bool StoredGraph<E>::isLive(unsigned int node) const
+{
+	return this->live[node];
+}
+
+template<class E>
+size_t StoredGraph<E>::getEdgeCount() const
+{
+	if (!this->record)
+		return 0;
+	if constexpr (std::is_same<Direction, Directed>::value)
+		return this->record->entryCount;
+	return this->record->entryCount / 2;
+}
+
+template<class E>
+unsigned int StoredGraph<E>::getEdgeIdBound() const
+{
+	return this->record ? this->record->edgeIdBound : 0;
+}
+
+template<class E>
+unsigned int StoredGraph<E>::getDegree(unsigned int node) const
+{
+	return this->offsets[node + 1] - this->offsets[node];
+}
+
+template<class E>
+const unsigned int* StoredGraph<E>::neighborsBegin(unsigned int node) const
+{
+	return this->targets + this->offsets[node];
+}
+
+template<class E>
+const unsigned int* StoredGraph<E>::neighborsEnd(unsigned int node) const
+{
+	return this->targets + this->offsets[node + 1];
+}
+
+template<class E>
+const unsigned int* StoredGraph<E>::edgeIdsBegin(unsigned int node) const
+{
+	return this->edgeIds + this->offsets[node];
+}
+
+template<class E>
+std::string_view StoredGraph<E>::getNodeName(unsigned int node) const
+{
+	return this->store->getString(this->nodeNames[node]);
+}
+
+template<class E>
+const std::uint32_t* StoredGraph<E>::labelsBegin(unsigned int node) const
+{
+	return this->labels + this->labelOffsets[node];
+}
+
+template<class E>
+const std::uint32_t* StoredGraph<E>::labelsEnd(unsigned int node) const
+{
+	return this->labels + this->labelOffsets[node + 1];
+}
+
+template<class E>
+bool StoredGraph<E>::hasLabel(unsigned int node, std::uint32_t label) const
+{
+	return std::binary_search(this->labelsBegin(node), this->labelsEnd(node),
+			label);
+}
+
+template<class E>
+std::uint32_t StoredGraph<E>::findLabel(std::string_view label) const
+{
+	return this->store ? this->store->findString(label) : noString;
+}
+
+template<class E>
+bool StoredGraph<E>::isNeighbor(unsigned int nodeA, unsigned int nodeB) const
+{
+	return std::binary_search(this->neighborsBegin(nodeA),
+			this->neighborsEnd(nodeA), nodeB);
+}
+
+/************************************************
+ *  STORED LABELS
+ ***********************************************/
+/* The label queries of Graph (selectNodesByLabel(), countNodesByLabel(),
+ * getDegreeCounts()) for a stored graph, which has no label index: a label is
+ * looked up once and then each node's sorted label ids are searched. Degree
+ * counts are taken once, the graph never changes.
+ */
+template<class E>
+class StoredLabels
+{
+public:
+	explicit StoredLabels(const StoredGraph<E> &graph) :
+			graph(graph)
+	{
+		for (unsigned int v = 0; v < graph.getNodeCount(); v++)
+		{
+			if (!graph.isLive(v))
+				continue;
+			unsigned int degree = graph.getDegree(v);
+			if (degree >= this->degreeCounts.size())
+				this->degreeCounts.resize(degree + 1, 0);
+			this->degreeCounts[degree]++;
+		}
+	}
+
+	std::vector<grabIndex> selectNodesByLabel(std::string label) const
+	{
+		std::vector<grabIndex> nodes;
+		std::uint32_t id = this->graph.findLabel(label);
+		if (id == noString)
+			return nodes;
+		for (unsigned int v = 0; v < this->graph.getNodeCount(); v++)
+			if (this->graph.isLive(v) && this->graph.hasLabel(v, id))
+				nodes.push_back(v);
+		return nodes;
+	}
+
+	size_t countNodesByLabel(std::string label) const
+	{
+		return this->selectNodesByLabel(label).size();
+	}
+
+	const std::vector<grabIndex>& getDegreeCounts() const
+	{
+		return this->degreeCounts;
+	}
+
+private:
+	StoredGraph<E> graph;
+	std::vector<grabIndex> degreeCounts;
+};
+
+#endif /* INC_STRUCTURE_STORE_H_ */
@@ -0,0 +1,387 @@
+/**
+ * @file view.h
+ * @brief Filtered and induced subgraph views over anything traversable.
+ *
+ *	Looking at one fragment used to mean a second Graph and an addNode() per
+ *	shared node, and the edges were still the whole graph's. A View instead sits
+ *	on top of a traversable (usually a Snapshot, see snapshot.h) and hides nodes
+ *	and/or edges with two bitmaps, nothing is copied and no node is touched. It
+ *	is traversable itself, so bfs and friends run on it unchanged, and views can
+ *	sit on views.
+ *
+ *	Hiding a node hides its edges too, so a node mask is an induced subgraph.
+ *	Edge masks go by the base's edge ids, parallel edges are folded to one id the
+ *	same as in Snapshot. The base has to outlive the view. Many views over one
+ *	labeling (i.e. one per fragment) should share it with keepLabeled() rather
+ *	than each carrying a node bitmap.
+ *
+ *	Queries that need contiguous rows (neighborsBegin(), bitmap rows) stay on
+ *	Snapshot, filtering can not give those without copying.
+ */
+
+#ifndef INC_STRUCTURE_VIEW_H_
+#define INC_STRUCTURE_VIEW_H_
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../lazyPrints.h"
+#include "graph.h"
+#include "direction.h"
+
+template<class G>
+class View
+{
+public:
+	typedef typename TraversalDirection<G>::policy Direction;
+
+	/************************************************
+	 *  CONSTRUCTORS/DESTRUCTORS
+	 ***********************************************/
+	//sees all of base until narrowed
+	explicit View(const G &base);
+
+	/************************************************
+	 *  MASKS
+	 ***********************************************/
+	//each call narrows what is already visible, nothing hidden comes back
+	template<class Predicate>
+	void filterNodes(Predicate keep);
+	template<class Predicate>
+	void filterEdges(Predicate keep);
+
+	//any integer id type, i.e. what Graph::selectNodes() hands back
+	template<class Id>
+	void keepNodes(const std::vector<Id> &nodes);
+	void keepEdges(const std::vector<unsigned int> &edgeIds);
+
+	void hideNode(unsigned int node);
+	void hideEdge(unsigned int edgeId);
+
+	//only nodes with labels[v] == label, labels is not copied and has to outlive us
+	void keepLabeled(const std::vector<unsigned int> &labels, unsigned int label);
+
+	bool hasNode(unsigned int node) const;
+	bool hasEdge(unsigned int edgeId) const;
+
+	/************************************************
+	 *  GETTER/SETTER PAIRS
+	 ***********************************************/
+	const G& getBase() const;
+
+	//ids stay the base's, hidden ones are simply not live
+	unsigned int getNodeCount() const;
+	//counted on first use after the masks change
+	unsigned int getLiveCount() const;
+	bool isLive(unsigned int node) const;
+
+	unsigned int getEdgeIdBound() const;
+	//walks every row, do not call it per node
+	size_t getEdgeCount() const;
+
+	//walks the node's row in the base
+	unsigned int getDegree(unsigned int node) const;
+
+	/************************************************
+	 *  TRAVERSAL
+	 ***********************************************/
+	//same contract as Snapshot::forEachNeighbor(), hidden neighbors and edges are skipped
+	template<class F>
+	void forEachNeighbor(unsigned int node, F func) const
+	{
+		if (!this->isLive(node))
+			return;
+		this->base->forEachNeighbor(node,
+				[&](unsigned int neighbor, unsigned int edgeId)
+				{
+					if (!this->hasNode(neighbor) || !this->hasEdge(edgeId))
+						return true;
+					if constexpr (std::is_same<decltype(func(0u, 0u)), bool>::value)
+						return func(neighbor, edgeId);
+					else
+					{
+						func(neighbor, edgeId);
+						return true;
+					}
+				});
+	}
+
+	bool isNeighbor(unsigned int nodeA, unsigned int nodeB) const;
+
+private:
+	/************************************************
+	 *  STRUCTURE
+	 ***********************************************/
+	const G *base;
+	mutable unsigned int liveCount = 0;
+	mutable bool counted = false;
+	//empty means nothing hidden yet
+	std::vector<std::uint64_t> nodeBits;
+	std::vector<std::uint64_t> edgeBits;
+	//nullptr means no label to match
+	const std::vector<unsigned int> *nodeLabels = nullptr;
+	unsigned int keptLabel = 0;
+
+	/************************************************
+	 *  HELPER FUNCTIONS
+	 ***********************************************/
+	static bool testBit(const std::vector<std::uint64_t> &bits, unsigned int i)
+	{
+		return (bits[i / 64] >> (i % 64)) & 1;
+	}
+
+	static void fillBits(std::vector<std::uint64_t> &bits, unsigned int count)
+	{
+		bits.assign((count + 63) / 64, ~std::uint64_t(0));
+	}
+
+	void recount() const;
+};
+
+/************************************************
+ *  CONSTRUCTORS/DESTRUCTORS
+ ***********************************************/
+
+template<class G>
+View<G>::View(const G &base) :
+		base(&base)
+{
+}
+
+/************************************************
+ *  MASKS
+ ***********************************************/
+
+template<class G>
+template<class Predicate>
+void View<G>::filterNodes(Predicate keep)
+{
+	if (this->nodeBits.empty())
+		fillBits(this->nodeBits, this->getNodeCount());
+	for (unsigned int v = 0; v < this->getNodeCount(); v++)
+		if (testBit(this->nodeBits, v) && !keep(v))
+			this->nodeBits[v / 64] &= ~(std::uint64_t(1) << (v % 64));
+	this->counted = false;
+}
+
+template<class G>
+template<class Predicate>
+void View<G>::filterEdges(Predicate keep)
+{
+	if (this->edgeBits.empty())
+		fillBits(this->edgeBits, this->getEdgeIdBound());
+	for (unsigned int id = 0; id < this->getEdgeIdBound(); id++)
+		if (testBit(this->edgeBits, id) && !keep(id))
+			this->edgeBits[id / 64] &= ~(std::uint64_t(1) << (id % 64));
+}
+
+template<class G>
+template<class Id>
+void View<G>::keepNodes(const std::vector<Id> &nodes)
+{
+	std::vector<std::uint64_t> wanted((this->getNodeCount() + 63) / 64, 0);
+	for (Id v : nodes)
+	{
+		if (v >= this->getNodeCount())
+		{
+			badBehavior(__LINE__, __func__,
+					"Warning: no node with id " + std::to_string(v));
+			continue;
+		}
+		wanted[v / 64] |= std::uint64_t(1) << (v % 64);
+	}
+	if (this->nodeBits.empty())
+		this->nodeBits.swap(wanted);
+	else
+		for (size_t word = 0; word < wanted.size(); word++)
+			this->nodeBits[word] &= wanted[word];
+	this->counted = false;
+}
+
+template<class G>
+void View<G>::keepEdges(const std::vector<unsigned int> &edgeIds)
+{
+	std::vector<std::uint64_t> wanted((this->getEdgeIdBound() + 63) / 64, 0);
+	for (unsigned int id : edgeIds)
+	{
+		if (id >= this->getEdgeIdBound())
+		{
+			badBehavior(__LINE__, __func__,
+					"Warning: no edge with id " + std::to_string(id));
+			continue;
+		}
+		wanted[id / 64] |= std::uint64_t(1) << (id % 64);
+	}
+	if (this->edgeBits.empty())
+		this->edgeBits.swap(wanted);
+	else
+		for (size_t word = 0; word < wanted.size(); word++)
+			this->edgeBits[word] &= wanted[word];
+}
+
+template<class G>
+void View<G>::hideNode(unsigned int node)
+{
+	if (node >= this->getNodeCount())
+		return;
+	if (this->nodeBits.empty())
+		fillBits(this->nodeBits, this->getNodeCount());
+	if (this->counted && this->isLive(node))
+		this->liveCount--;
+	this->nodeBits[node / 64] &= ~(std::uint64_t(1) << (node % 64));
+}
+
+template<class G>
+void View<G>::hideEdge(unsigned int edgeId)
+{
+	if (edgeId >= this->getEdgeIdBound())
+		return;
+	if (this->edgeBits.empty())
+		fillBits(this->edgeBits, this->getEdgeIdBound());
+	this->edgeBits[edgeId / 64] &= ~(std::uint64_t(1) << (edgeId % 64));
+}
+
+template<class G>
+void View<G>::keepLabeled(const std::vector<unsigned int> &labels,
+		unsigned int label)
+{
+	if (labels.size() < this->getNodeCount())
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: " + std::to_string(labels.size())
+						+ " labels do not cover every node");
+		return;
+	}
+	//a second labeling narrows through the bitmap, we only keep one pointer
+	if (this->nodeLabels)
+		this->filterNodes([&labels, label](unsigned int v)
+		{	return labels[v] == label;});
+	else
+	{
+		this->nodeLabels = &labels;
+		this->keptLabel = label;
+		this->counted = false;
+	}
+}
+
+template<class G>
+bool View<G>::hasNode(unsigned int node) const
+{
+	return (this->nodeBits.empty() || testBit(this->nodeBits, node))
+			&& (!this->nodeLabels || (*this->nodeLabels)[node] == this->keptLabel);
+}
+
+template<class G>
+bool View<G>::hasEdge(unsigned int edgeId) const
+{
+	return this->edgeBits.empty() || testBit(this->edgeBits, edgeId);
+}
+
+/************************************************
+ *  GETTER/SETTER PAIRS
+ ***********************************************/
+
+template<class G>
+const G& View<G>::getBase() const
+{
+	return *this->base;
+}
+
+template<class G>
+unsigned int View<G>::getNodeCount() const
+{
+	return this->base->getNodeCount();
+}
+
+template<class G>
+unsigned int View<G>::getLiveCount() const
+{
+	if (!this->counted)
+		this->recount();
+	return this->liveCount;
+}
+
+template<class G>
+bool View<G>::isLive(unsigned int node) const
+{
+	return this->base->isLive(node) && this->hasNode(node);
+}
+
+template<class G>
+unsigned int View<G>::getEdgeIdBound() const
+{
+	return this->base->getEdgeIdBound();
+}
+
+template<class G>
+size_t View<G>::getEdgeCount() const
+{
+	size_t entries = 0;
+	for (unsigned int v = 0; v < this->getNodeCount(); v++)
+		entries += this->getDegree(v);
+	return hasSymmetricRows<View<G>>() ? entries / 2 : entries;
+}
+
+template<class G>
+unsigned int View<G>::getDegree(unsigned int node) const
+{
+	unsigned int degree = 0;
+	this->forEachNeighbor(node, [&degree](unsigned int, unsigned int)
+	{
+		degree++;
+	});
+	return degree;
+}
+
+/************************************************
+ *  TRAVERSAL
+ ***********************************************/
+
+template<class G>
+bool View<G>::isNeighbor(unsigned int nodeA, unsigned int nodeB) const
+{
+	bool found = false;
+	this->forEachNeighbor(nodeA, [&](unsigned int neighbor, unsigned int)
+	{
+		found = (neighbor == nodeB);
+		return !found;
+	});
+	return found;
+}
+
+/************************************************
+ *  HELPER FUNCTIONS
+ ***********************************************/
+
+template<class G>
+void View<G>::recount() const
+{
+	this->liveCount = 0;
+	for (unsigned int v = 0; v < this->getNodeCount(); v++)
+		this->liveCount += this->isLive(v);
+	this->counted = true;
+}
+
+/************************************************
+ *  SHORTHANDS
+ ***********************************************/
+
+//only these nodes and the edges between them
+template<class G, class Id>
+View<G> inducedView(const G &base, const std::vector<Id> &nodes)
+{
+	View<G> view(base);
+	view.keepNodes(nodes);
+	return view;
+}
+
+//nodes of graph carrying label, base has to be built off graph (same ids)
+template<class G, class T, class E>
+View<G> labelView(const G &base, const Graph<T, E> &graph, std::string label)
+{
+	return inducedView(base, graph.selectNodesByLabel(label));
+}
+
+#endif /* INC_STRUCTURE_VIEW_H_ */
@@ -4,11 +4,330 @@
  *
  */
 
+//driver output is data, keep our debug chatter out of it
+#define GRAB_NODE_DEBUG false
+#define GRAB_NODE_VERBOSE false
+#define GRAB_EDGE_DEBUG false
+#define GRAB_GRAPH_DEBUG false
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
-//how do we want to read in our data? This will allow for program <filename> and will take it in. Need to implement
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../inc/structure/node.h"
+#include "../inc/structure/edge.h"
+#include "../inc/structure/graph.h"
+#include "../inc/structure/snapshot.h"
+#include "../inc/algo/match.h"
+#include "../inc/pipeline/pipeline.h"
+
+struct Molecule
+{
+};
+
+//bonds have no direction
+template<>
+struct EdgeDirection<Molecule>
+{
+	typedef Undirected policy;
+};
+
+typedef Node<Molecule> Atom;
+typedef Graph<Molecule, Molecule> MolGraph;
+typedef Snapshot<Molecule, Molecule> MolSnapshot;
+typedef Pattern<Molecule, Molecule> MolPattern;
+
+/* One line of input per molecule, blank lines and # comments are skipped:
+ *		<name> <element,element,...> <atom-atom,atom-atom,...>
+ *		benzene C,C,C,C,C,C 0-1,1-2,2-3,3-4,4-5,5-0
+ * Atoms are numbered from 0 in the order given.
+ */
+struct Job
+{
+	size_t lineNumber = 0;
+	std::string line;
+
+	std::string name;
+	std::vector<std::string> elements;
+	std::vector<std::pair<unsigned int, unsigned int>> bonds;
+
+	std::unique_ptr<MolGraph> graph;
+	std::vector<std::shared_ptr<Atom>> atoms;
+
+	unsigned int rings = 0;
+	//distinct embeddings of --pattern
+	size_t matches = 0;
+};
+
+//reused by each worker for every molecule it handles
+struct Scratch
+{
+	std::string token;
+	std::vector<unsigned char> seen;
+	std::vector<unsigned int> stack;
+};
+
+struct Options
+{
+	std::string inPath;
+	unsigned int threads = 0;
+	unsigned int minRings = 0;
+	size_t queueCapacity = 256;
+	std::string tracePath;
+	std::string pattern;
+};
+
+/************************************************
+ *  STAGES
+ ***********************************************/
+
+bool parseStage(std::unique_ptr<Job> &job, Scratch &scratch)
+{
+	std::istringstream in(job->line);
+	std::string atomField, bondField;
+	if (!(in >> job->name >> atomField))
+	{
+		badBehavior(__LINE__, __func__,
+				"Warning: line " + std::to_string(job->lineNumber)
+						+ " needs a name and atoms");
+		return false;
+	}
+	in >> bondField;
+
+	std::istringstream atomsIn(atomField);
+	while (std::getline(atomsIn, scratch.token, ','))
+		if (!scratch.token.empty())
+			job->elements.push_back(scratch.token);
+
+	std::istringstream bondsIn(bondField);
+	while (std::getline(bondsIn, scratch.token, ','))
+	{
+		size_t dash = scratch.token.find('-');
+		if (dash == std::string::npos)
+			continue;
+		char *end = nullptr;
+		unsigned long from = std::strtoul(scratch.token.c_str(), &end, 10);
+		bool good = (end == scratch.token.c_str() + dash);
+		unsigned long to = std::strtoul(scratch.token.c_str() + dash + 1, &end, 10);
+		good = good && end != scratch.token.c_str() + dash + 1 && *end == '\0';
+		if (!good || from >= job->elements.size() || to >= job->elements.size()
+				|| from == to)
+		{
+			badBehavior(__LINE__, __func__,
+					"Warning: bad bond " + scratch.token + " on line "
+							+ std::to_string(job->lineNumber));
+			return false;
+		}
+		job->bonds.emplace_back(std::min(from, to), std::max(from, to));
+	}
+	//a bond listed twice is still one bond
+	std::sort(job->bonds.begin(), job->bonds.end());
+	job->bonds.erase(std::unique(job->bonds.begin(), job->bonds.end()),
+			job->bonds.end());
+	job->line.clear();
+	return true;
+}
+
+bool buildStage(std::unique_ptr<Job> &job, Scratch&)
+{
+	job->graph.reset(new MolGraph(job->name));
+	job->atoms.reserve(job->elements.size());
+	for (size_t i = 0; i < job->elements.size(); i++)
+	{
+		std::shared_ptr<Atom> atom = std::make_shared<Atom>(
+				job->elements[i] + std::to_string(i));
+		atom->addLabel(job->elements[i]);
+		job->atoms.push_back(atom);
+	}
+	for (size_t b = 0; b < job->bonds.size(); b++)
+		job->atoms[job->bonds[b].first]->addChild("b" + std::to_string(b),
+				job->atoms[job->bonds[b].second]);
+	return job->graph->addNodes(job->atoms);
+}
+
+//the graph's edges keep its atoms alive, so whoever is last to need it breaks them
+void releaseGraph(Job &job)
+{
+	for (std::shared_ptr<Atom> &atom : job.atoms)
+		atom->deleteEdges();
+	job.atoms.clear();
+	job.graph.reset();
+}
+
+/* Molecules without the pattern stop here. A snapshot keeps the graph's ids,
+ * so the graph is its own label source.
+ */
+bool matchStage(std::unique_ptr<Job> &job, const MolPattern &pattern)
+{
+	MolSnapshot snapshot(*job->graph);
+	forEachMatch(pattern, *job->graph, snapshot,
+			[&](const std::vector<unsigned int>&)
+			{
+				job->matches++;
+			}, true);
+	if (job->matches == 0)
+		releaseGraph(*job);
+	return job->matches > 0;
+}
+
+/* Ring count as the circuit rank (bonds - atoms + fragments) of the folded
+ * snapshot. Once this is done nobody needs the graph anymore, so we break its
+ * edges here rather than in the sink thread.
+ */
+bool ringStage(std::unique_ptr<Job> &job, Scratch &scratch)
+{
+	MolSnapshot snapshot(*job->graph);
+	unsigned int fragments = 0;
+	scratch.seen.assign(snapshot.getNodeCount(), 0);
+	for (unsigned int start = 0; start < snapshot.getNodeCount(); start++)
+	{
+		if (scratch.seen[start] || !snapshot.isLive(start))
+			continue;
+		fragments++;
+		scratch.seen[start] = 1;
+		scratch.stack.assign(1, start);
+		while (!scratch.stack.empty())
+		{
+			unsigned int v = scratch.stack.back();
+			scratch.stack.pop_back();
+			snapshot.forEachNeighbor(v, [&](unsigned int w, unsigned int)
+			{
+				if (!scratch.seen[w])
+				{
+					scratch.seen[w] = 1;
+					scratch.stack.push_back(w);
+				}
+			});
+		}
+	}
+	job->rings = (unsigned int) (snapshot.getEdgeCount() + fragments
+			- snapshot.getLiveCount());
+
+	releaseGraph(*job);
+	return true;
+}
+
+/************************************************
+ *  DRIVER
+ ***********************************************/
+
+bool parseArgs(int argc, char *argv[], Options &options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--threads=") == 0)
+			options.threads = std::strtoul(arg.c_str() + 10, nullptr, 10);
+		else if (arg.compare(0, 12, "--min-rings=") == 0)
+			options.minRings = std::strtoul(arg.c_str() + 12, nullptr, 10);
+		else if (arg.compare(0, 8, "--queue=") == 0)
+			options.queueCapacity = std::strtoul(arg.c_str() + 8, nullptr, 10);
+		else if (arg.compare(0, 8, "--trace=") == 0)
+			options.tracePath = arg.substr(8);
+		else if (arg.compare(0, 10, "--pattern=") == 0)
+			options.pattern = arg.substr(10);
+		else if (options.inPath.empty() && arg.compare(0, 2, "--") != 0)
+			options.inPath = arg;
+		else
+			return false;
+	}
+	return !options.inPath.empty();
+}
+
 int main(int argc, char *argv[])
 {
+	Options options;
+	if (!parseArgs(argc, argv, options))
+	{
+		std::cerr << "usage: " << argv[0]
+				<< " <molecule file> [--threads=N] [--min-rings=N] [--queue=N]"
+				<< " [--trace=file] [--pattern=SMILES]"
+				<< std::endl;
+		return 1;
+	}
+	std::ifstream in(options.inPath);
+	if (!in)
+	{
+		std::cerr << "could not open " << options.inPath << std::endl;
+		return 1;
+	}
+
+	//compiled once, every match worker reads the same one
+	std::unique_ptr<MolPattern> pattern;
+	if (!options.pattern.empty())
+	{
+		pattern.reset(new MolPattern(options.pattern));
+		if (!pattern->isValid())
+		{
+			std::cerr << "could not compile pattern " << options.pattern << std::endl;
+			return 1;
+		}
+	}
+
+	//cheap stages get one thread, the graph work gets every core
+	Pipeline<std::unique_ptr<Job>, Scratch> pipeline(options.queueCapacity);
+	pipeline.addStage("parse", 1, parseStage);
+	pipeline.addStage("build", options.threads, buildStage);
+	if (pattern)
+	{
+		const MolPattern &compiled = *pattern;
+		pipeline.addStage("match", options.threads,
+				[&compiled](std::unique_ptr<Job> &job, Scratch&)
+				{
+					return matchStage(job, compiled);
+				});
+	}
+	pipeline.addStage("rings", options.threads, ringStage);
+	unsigned int minRings = options.minRings;
+	pipeline.addStage("screen", 1, [minRings](std::unique_ptr<Job> &job, Scratch&)
+	{
+		return job->rings >= minRings;
+	});
+
+	size_t lineNumber = 0;
+	auto source = [&](std::unique_ptr<Job> &job)
+	{
+		std::string line;
+		while (std::getline(in, line))
+		{
+			lineNumber++;
+			if (line.empty() || line[0] == '#')
+				continue;
+			job.reset(new Job());
+			job->lineNumber = lineNumber;
+			job->line = line;
+			return true;
+		}
+		return false;
+	};
+	//completion order, the line number lets callers sort it back
+	bool matching = (pattern != nullptr);
+	auto sink = [matching](std::unique_ptr<Job> &job)
+	{
+		std::cout << job->lineNumber << '\t' << job->name << '\t'
+				<< job->elements.size() << '\t' << job->bonds.size() << '\t'
+				<< job->rings;
+		if (matching)
+			std::cout << '\t' << job->matches;
+		std::cout << '\n';
+	};
+	size_t emitted = pipeline.run(source, sink);
+	std::cout.flush();
 
-	std::cout<<"End main func" << std::endl;
+	for (const StageStats &stats : pipeline.getStageStats())
+		std::cerr << stats.name << ": " << stats.processed << " in, "
+				<< stats.dropped << " dropped, " << stats.threads << " threads\n";
+	std::cerr << emitted << " molecules written" << std::endl;
+	if (!options.tracePath.empty())
+	{
+		if (!traceOn)
+			std::cerr << "trace requested but built without GRAB_TRACE" << std::endl;
+		TraceRecorder::get().writeChromeTrace(options.tracePath);
+	}
 	return 0;
 }